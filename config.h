@@ -16,6 +16,18 @@
 #endif
 #endif
 
+/* Default output buffer size, flushed when full (0: after every structure) */
+#define DEFAULT_CHUNK_SIZE 16384
+
+/*
+ * SMBIOS 3 tables announcing more than this are read and decoded this many
+ * bytes at a time
+ */
+#define STREAM_CHUNK_SIZE 65536
+
+/* Size of the first block of the per-run arena, see arena_alloc() */
+#define ARENA_BLOCK_SIZE 65536
+
 /* Use mmap or not */
 #ifndef __BEOS__
 #define USE_MMAP
@@ -31,4 +43,42 @@
 #define USE_SLOW_MEMCPY
 #endif
 
+/* Decode dump files in parallel in batch mode */
+#if defined(__linux__) || defined(__FreeBSD__)
+#define USE_PTHREAD
+#endif
+
+/* Poll the table periodically with --watch */
+#if defined(__linux__) || defined(__FreeBSD__)
+#define USE_WATCH
+#endif
+
+/* Fewest entries per thread worth decoding a table in parallel (--jobs) */
+#define PARALLEL_MIN_ENTRIES 32
+
+/* State of the decoder and output layers is kept per thread */
+#ifdef USE_PTHREAD
+#define THREAD_LOCAL __thread
+#else
+#define THREAD_LOCAL
+#endif
+
+/*
+ * Minimal builds, e.g. for pre-boot inventory images. Nothing is left out
+ * unless one of these is defined, usually from the Makefile:
+ * - CONFIG_TYPES: only the SMBIOS types n with CONFIG_TYPE_n defined are
+ *   decoded, the others are dumped as with --dump
+ * - CONFIG_OEM: only the vendors with CONFIG_OEM_ACER, CONFIG_OEM_HP (HP
+ *   and HPE) or CONFIG_OEM_LENOVO (IBM and Lenovo) defined are decoded
+ * - CONFIG_FORMATS: besides text, only the output formats with
+ *   CONFIG_FORMAT_JSON or CONFIG_FORMAT_KEYVALUE defined are available
+ * The helpers of each type are left out along with its decoder, those
+ * shared with other types are marked MAYBE_UNUSED instead.
+ */
+#ifdef __GNUC__
+#define MAYBE_UNUSED __attribute__((unused))
+#else
+#define MAYBE_UNUSED
+#endif
+
 #endif
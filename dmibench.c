@@ -0,0 +1,1015 @@
+/*
+ * Decoder benchmark on synthetic tables
+ * This file is part of the dmidecode project.
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ * A table of the requested size is generated and written as a --dump-bin
+ * file, then decoded in-process through libdmidecode, in each output
+ * format and along the --dump, --string, --type and --handle paths. The
+ * first run of every phase reads the file, the following ones decode the
+ * table kept by the context, so the figures are those of the decoder and
+ * the output layer alone. The last phase reads the table in place instead,
+ * through an entry point in memory such as UEFI applications find in the
+ * configuration table, so that its figures include reading the table.
+ * Built and run by "make bench".
+ *
+ * The generator also writes the synthetic tables of the fuzzing corpus
+ * (see dmifuzz.c and "make seeds"), with the pathological structures
+ * selected by -p. With -c, the tables listed in a baseline file are
+ * decoded instead, and their time per structure compared with the one
+ * the file records, which -r writes: this is "make check".
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+
+#include "types.h"
+#include "util.h"
+#include "libdmidecode.h"
+
+#define OEM_NONE	0
+#define OEM_HPE		1
+#define OEM_LENOVO	2
+
+#define PATH_STRINGS	(1 << 0)
+#define PATH_TYPE34	(1 << 1)
+#define PATH_TYPE42	(1 << 2)
+#define PATH_SHORT	(1 << 3)
+
+#define UNTERMINATED_SIZE	0x100000
+
+#define CHECK_BATCHES		5
+#define CHECK_BATCH_TIME	0.02	/* Seconds, at least */
+#define CHECK_TOLERANCE		100	/* Percent slower than the baseline */
+
+struct table
+{
+	u8 *data;
+	size_t len;
+	size_t size;
+	u16 count;
+	u16 handle;		/* Next free handle */
+	int strings;		/* Current structure has strings */
+};
+
+/*
+ * Allocations are counted by wrapping the allocator at link time
+ * (-Wl,--wrap, see the Makefile), so that no allocation in dmidecode
+ * can be missed.
+ */
+static unsigned long allocs;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+	allocs++;
+	return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size)
+{
+	allocs++;
+	return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+	allocs++;
+	return __real_realloc(ptr, size);
+}
+
+/*
+ * Table generation
+ */
+
+static u8 *table_grow(struct table *t, size_t len)
+{
+	u8 *p;
+
+	if (t->len + len > t->size)
+	{
+		size_t size = t->size ? t->size : 0x10000;
+
+		while (size < t->len + len)
+			size *= 2;
+		if ((p = realloc(t->data, size)) == NULL)
+		{
+			perror("realloc");
+			exit(1);
+		}
+		t->data = p;
+		t->size = size;
+	}
+	p = t->data + t->len;
+	memset(p, 0, len);
+	t->len += len;
+	return p;
+}
+
+/*
+ * Add a structure of the given length (header included), returns its
+ * formatted area to be filled in. Strings must be added with
+ * table_string(), then the structure closed with table_end().
+ */
+static u8 *table_start(struct table *t, u8 type, u8 length)
+{
+	u8 *p = table_grow(t, length);
+
+	p[0] = type;
+	p[1] = length;
+	p[2] = t->handle & 0xFF;
+	p[3] = t->handle >> 8;
+	t->handle++;
+	t->count++;
+	t->strings = 0;
+	return p;
+}
+
+static void table_string(struct table *t, const char *s)
+{
+	size_t len = strlen(s) + 1;
+
+	memcpy(table_grow(t, len), s, len);
+	t->strings = 1;
+}
+
+static void table_end(struct table *t)
+{
+	/* The last string ends with a NUL, a structure without any needs two */
+	table_grow(t, t->strings ? 1 : 2);
+}
+
+static void put16(u8 *p, u16 v)
+{
+	p[0] = v & 0xFF;
+	p[1] = v >> 8;
+}
+
+static void put32(u8 *p, u32 v)
+{
+	put16(p, v & 0xFFFF);
+	put16(p + 2, v >> 16);
+}
+
+static void gen_bios(struct table *t, int oem)
+{
+	u8 *p = table_start(t, 0, 0x18);
+
+	p[0x04] = 1;
+	p[0x05] = 2;
+	put16(p + 0x06, 0xF000);
+	p[0x08] = 3;
+	p[0x09] = 0xFF;
+	put32(p + 0x0A, 0x1FF99A80);
+	p[0x12] = 0x03;
+	p[0x13] = 0x0F;
+	p[0x14] = 2;
+	p[0x15] = 42;
+	p[0x16] = 0xFF;
+	p[0x17] = 0xFF;
+	table_string(t, oem == OEM_LENOVO ? "LENOVO" : "HPE");
+	table_string(t, "U30");
+	table_string(t, "01/01/2026");
+	table_end(t);
+}
+
+static void gen_system(struct table *t, int oem)
+{
+	u8 *p = table_start(t, 1, 0x1B);
+	int i;
+
+	p[0x04] = 1;
+	p[0x05] = 2;
+	p[0x06] = 3;
+	p[0x07] = 4;
+	for (i = 0; i < 16; i++)
+		p[0x08 + i] = 0x11 * i;
+	p[0x18] = 0x06;
+	p[0x19] = 5;
+	p[0x1A] = 6;
+	switch (oem)
+	{
+		case OEM_HPE:
+			table_string(t, "HPE");
+			table_string(t, "ProLiant DL380 Gen10");
+			break;
+		case OEM_LENOVO:
+			table_string(t, "LENOVO");
+			table_string(t, "20XWCTO1WW");
+			break;
+		default:
+			table_string(t, "Synthetic");
+			table_string(t, "Benchmark System");
+	}
+	table_string(t, "1.0");
+	table_string(t, "SN0123456789");
+	table_string(t, "SKU-0001");
+	table_string(t, "Rack Server");
+	table_end(t);
+}
+
+static void gen_memory(struct table *t, unsigned int dimms)
+{
+	char s[32];
+	u16 array = t->handle;
+	unsigned int i;
+	u8 *p;
+
+	p = table_start(t, 16, 0x17);
+	p[0x04] = 0x03;
+	p[0x05] = 0x03;
+	p[0x06] = 0x06;
+	put32(p + 0x07, 0x80000000);
+	put16(p + 0x0B, 0xFFFE);
+	put16(p + 0x0D, dimms > 0xFFFF ? 0xFFFF : dimms);
+	put32(p + 0x0F, 0);
+	put32(p + 0x13, 0x400);
+	table_end(t);
+
+	for (i = 0; i < dimms; i++)
+	{
+		p = table_start(t, 17, 0x28);
+		put16(p + 0x04, array);
+		put16(p + 0x06, 0xFFFE);
+		put16(p + 0x08, 72);
+		put16(p + 0x0A, 64);
+		put16(p + 0x0C, 0x7FFF);
+		p[0x0E] = 0x09;
+		p[0x10] = 1;
+		p[0x11] = 2;
+		p[0x12] = 0x1A;
+		put16(p + 0x13, 0x2080);
+		put16(p + 0x15, 3200);
+		p[0x17] = 3;
+		p[0x18] = 4;
+		p[0x19] = 5;
+		p[0x1A] = 6;
+		p[0x1B] = 0x02;
+		put32(p + 0x1C, 32768);
+		put16(p + 0x20, 3200);
+		put16(p + 0x22, 1200);
+		put16(p + 0x24, 1200);
+		put16(p + 0x26, 1200);
+		sprintf(s, "PROC %u DIMM %u", i / 24 + 1, i % 24 + 1);
+		table_string(t, s);
+		sprintf(s, "BANK %u", i % 24);
+		table_string(t, s);
+		table_string(t, "Samsung");
+		sprintf(s, "%08X", 0x40000000 + i);
+		table_string(t, s);
+		sprintf(s, "Asset%u", i);
+		table_string(t, s);
+		table_string(t, "M393A4K40DB3-CWE");
+		table_end(t);
+	}
+}
+
+static void gen_oem_strings(struct table *t, unsigned int count,
+			    unsigned int strings)
+{
+	char s[64];
+	unsigned int i, j;
+	u8 *p;
+
+	for (i = 0; i < count; i++)
+	{
+		p = table_start(t, 11, 0x05);
+		p[0x04] = strings;
+		for (j = 0; j < strings; j++)
+		{
+			sprintf(s, "OEM configuration option %u.%u = 0x%08X",
+				i, j, i * 0x9E3779B9U + j);
+			table_string(t, s);
+		}
+		table_end(t);
+	}
+}
+
+static void gen_oem_hpe(struct table *t, unsigned int nics)
+{
+	unsigned int i, j;
+	u8 *p;
+
+	p = table_start(t, 204, 0x0B);
+	p[0x04] = 1;
+	p[0x05] = 2;
+	p[0x06] = 3;
+	p[0x07] = 4;
+	p[0x08] = 8;
+	p[0x09] = 1;
+	p[0x0A] = 5;
+	table_string(t, "Rack1");
+	table_string(t, "Encl");
+	table_string(t, "Model");
+	table_string(t, "Bay3");
+	table_string(t, "ESN");
+	table_end(t);
+
+	p = table_start(t, 212, 0x18);
+	memcpy(p + 0x04, "$CRU", 4);
+	put32(p + 0x08, 0x000F0000);
+	put32(p + 0x10, 0x10000);
+	table_end(t);
+
+	p = table_start(t, 219, 0x14);
+	put32(p + 0x04, 0x0000000F);
+	put32(p + 0x08, 0x00000003);
+	put32(p + 0x10, 0x00001401);
+	table_end(t);
+
+	for (i = 0; i < nics; i++)
+	{
+		p = table_start(t, 209, 0x04 + 8 * 4);
+		for (j = 0; j < 4; j++)
+		{
+			u8 *nic = p + 0x04 + 8 * j;
+
+			nic[0x00] = j << 3;
+			nic[0x01] = i + 1;
+			nic[0x02] = 0x98;
+			nic[0x03] = 0xF2;
+			nic[0x04] = 0xB3;
+			nic[0x05] = i;
+			nic[0x06] = j;
+			nic[0x07] = 0x01;
+		}
+		table_end(t);
+	}
+}
+
+static void gen_oem_lenovo(struct table *t)
+{
+	u8 *p;
+
+	p = table_start(t, 131, 0x16);
+	p[0x04] = 0x01;
+	p[0x14] = 0x80;
+	table_string(t, "TVT-Enablement");
+	table_end(t);
+
+	p = table_start(t, 135, 0x0A);
+	p[0x04] = 'T';
+	p[0x05] = 'P';
+	p[0x06] = 0x07;
+	p[0x07] = 0x03;
+	p[0x08] = 0x01;
+	p[0x09] = 0x01;
+	table_end(t);
+
+	p = table_start(t, 140, 0x0F);
+	memcpy(p + 0x04, "LENOVO", 6);
+	p[0x0A] = 0x0B;
+	p[0x0B] = 0x07;
+	p[0x0C] = 0x01;
+	p[0x0D] = 1;
+	p[0x0E] = 2;
+	table_string(t, "N32HT32W");
+	table_string(t, "01/01/2026");
+	table_end(t);
+}
+
+/*
+ * Pathological structures, for the fuzzing corpus
+ */
+
+/*
+ * Management devices, the first one with the common mistake of announcing
+ * 16 bytes when its strings start after 11
+ */
+static void gen_management_devices(struct table *t)
+{
+	u8 *p;
+
+	p = table_start(t, 34, 0x0B);
+	p[0x01] = 0x10;
+	p[0x04] = 1;
+	p[0x05] = 0x04;
+	put32(p + 0x06, 0x00000290);
+	p[0x0A] = 0x03;
+	table_string(t, "LM78-1");
+	table_end(t);
+
+	p = table_start(t, 34, 0x0B);
+	p[0x04] = 1;
+	p[0x05] = 0x0B;
+	put32(p + 0x06, 0x0000004C);
+	p[0x0A] = 0x05;
+	table_string(t, "ADM1021-1");
+	table_end(t);
+}
+
+/*
+ * A Redfish network host interface, with one valid protocol record, one
+ * of which the hostname overruns the record, and one which overruns the
+ * structure
+ */
+static void gen_host_interface(struct table *t)
+{
+	static const char hostname[] = "bmc.example.com";
+	u8 *p, *rec;
+	int i;
+
+	p = table_start(t, 42, 0x10 + 2 + 91 + 15 + 2 + 91 + 2);
+	p[0x04] = 0x40;
+	p[0x05] = 9;
+	p[0x06] = 0x03;
+	put16(p + 0x07, 0x8086);
+	put16(p + 0x09, 0x1533);
+	put16(p + 0x0B, 0x103C);
+	put16(p + 0x0D, 0x0001);
+	p[0x0F] = 3;
+
+	rec = p + 0x10;
+	rec[0x00] = 0x04;
+	rec[0x01] = 91 + sizeof(hostname) - 1;
+	for (i = 0; i < 16; i++)
+		rec[0x02 + i] = 0x10 + i;
+	rec[0x02 + 16] = 0x01;
+	rec[0x02 + 17] = 0x01;
+	memcpy(rec + 0x02 + 18, "\xA9\xFE\x00\x02", 4);
+	memcpy(rec + 0x02 + 34, "\xFF\xFF\x00\x00", 4);
+	rec[0x02 + 50] = 0x01;
+	rec[0x02 + 51] = 0x01;
+	memcpy(rec + 0x02 + 52, "\xA9\xFE\x00\x01", 4);
+	memcpy(rec + 0x02 + 68, "\xFF\xFF\x00\x00", 4);
+	put16(rec + 0x02 + 84, 443);
+	put32(rec + 0x02 + 86, 0);
+	rec[0x02 + 90] = sizeof(hostname) - 1;
+	memcpy(rec + 0x02 + 91, hostname, sizeof(hostname) - 1);
+
+	rec += 2 + rec[0x01];
+	rec[0x00] = 0x04;
+	rec[0x01] = 91;
+	rec[0x02 + 16] = 0x02;
+	rec[0x02 + 17] = 0x02;
+	rec[0x02 + 90] = 0xFF;
+
+	rec += 2 + rec[0x01];
+	rec[0x00] = 0x04;
+	rec[0x01] = 0xFF;
+	table_end(t);
+}
+
+/* Shorter than its own header, decoding stops there */
+static void gen_short(struct table *t)
+{
+	u8 *p = table_start(t, 8, 0x04);
+
+	p[0x01] = 0x02;
+	table_end(t);
+}
+
+/*
+ * A string area which is never terminated: NULs split it into strings,
+ * but no two follow each other, and the table ends within it. Must come
+ * last.
+ */
+static void gen_unterminated_strings(struct table *t)
+{
+	size_t i;
+	u8 *p;
+
+	p = table_start(t, 11, 0x05);
+	p[0x04] = 255;
+	p = table_grow(t, UNTERMINATED_SIZE);
+	memset(p, 'A', UNTERMINATED_SIZE);
+	for (i = 63; i < UNTERMINATED_SIZE - 1; i += 64)
+		p[i] = 0;
+}
+
+static u8 ep_checksum(const u8 *buf, size_t len)
+{
+	u8 sum = 0;
+	size_t a;
+
+	for (a = 0; a < len; a++)
+		sum += buf[a];
+	return -sum;
+}
+
+/*
+ * Build the entry point of the table, at address. SMBIOS 2.x entry points
+ * only have 32 bits for it. Returns 0 on success, -1 on error.
+ */
+static int make_ep(u8 *ep, const struct table *t, int smbios3,
+		   unsigned long long address)
+{
+	memset(ep, 0, 32);
+	if (smbios3)
+	{
+		memcpy(ep, "_SM3_", 5);
+		ep[0x06] = 0x18;
+		ep[0x07] = 3;
+		ep[0x08] = 3;
+		ep[0x0A] = 0x01;
+		put32(ep + 0x0C, t->len);
+		put32(ep + 0x10, address & 0xFFFFFFFF);
+		put32(ep + 0x14, address >> 32);
+		ep[0x05] = ep_checksum(ep, 0x18);
+	}
+	else
+	{
+		if (t->len > 0xFFFF)
+		{
+			fprintf(stderr, "Table too large for an SMBIOS 2.x entry "
+				"point (%lu bytes), drop -2 to use an SMBIOS 3 "
+				"entry point\n", (unsigned long)t->len);
+			return -1;
+		}
+		if (address > 0xFFFFFFFF)
+			return -1;
+		memcpy(ep, "_SM_", 4);
+		ep[0x05] = 0x1F;
+		ep[0x06] = 2;
+		ep[0x07] = 8;
+		put16(ep + 0x08, 0x100);
+		memcpy(ep + 0x10, "_DMI_", 5);
+		put16(ep + 0x16, t->len);
+		put32(ep + 0x18, address);
+		put16(ep + 0x1C, t->count);
+		ep[0x1E] = 0x28;
+		ep[0x15] = ep_checksum(ep + 0x10, 0x0F);
+		ep[0x04] = ep_checksum(ep, 0x1F);
+	}
+	return 0;
+}
+
+/*
+ * Write the table as --dump-bin does: entry point at offset 0, table at
+ * offset 32. Returns 0 on success, -1 on error.
+ */
+static int write_table(const struct table *t, int smbios3,
+		       const char *filename)
+{
+	u8 ep[32];
+
+	if (make_ep(ep, t, smbios3, 32) != 0
+	 || write_dump(0, sizeof(ep), ep, filename, 0) != 0
+	 || write_dump(32, t->len, t->data, filename, 1) != 0)
+		return -1;
+	return 0;
+}
+
+/*
+ * Benchmark
+ */
+
+struct phase
+{
+	const char *name;
+	const char *args[5];
+	const u8 *ep;		/* Read the table in place, not the file */
+};
+
+static void count_output(void *arg, const char *buf, size_t len)
+{
+	(void)buf;
+	*(unsigned long long *)arg += len;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int run_phase(const struct phase *ph, const char *filename,
+		     unsigned int runs, const struct table *t)
+{
+	char *argv[8];
+	struct dmi_context *ctx;
+	unsigned long long out = 0;
+	unsigned long start_allocs;
+	double start, elapsed;
+	int argc = 0, i;
+	unsigned int r;
+
+	argv[argc++] = (char *)"dmibench";
+	if (ph->ep == NULL)
+	{
+		argv[argc++] = (char *)"--from-dump";
+		argv[argc++] = (char *)filename;
+	}
+	for (i = 0; ph->args[i] != NULL; i++)
+		argv[argc++] = (char *)ph->args[i];
+	argv[argc] = NULL;
+
+	if ((ctx = dmi_context_new()) == NULL)
+		return -1;
+	if (dmi_context_set_options(ctx, argc, argv) != 0)
+	{
+		dmi_context_free(ctx);
+		return -1;
+	}
+	dmi_context_set_output(ctx, count_output, &out);
+	dmi_context_set_entry_point(ctx, ph->ep);
+
+	/* The first run reads the table, it isn't measured */
+	if (dmi_context_decode(ctx) != 0)
+	{
+		fprintf(stderr, "%s: decoding failed\n", ph->name);
+		dmi_context_free(ctx);
+		return -1;
+	}
+
+	out = 0;
+	start_allocs = allocs;
+	start = now();
+	for (r = 0; r < runs; r++)
+		dmi_context_decode(ctx);
+	elapsed = now() - start;
+	if (elapsed <= 0)
+		elapsed = 1e-9;
+
+	printf("%-10s %10.3f %14.0f %10.1f %12.1f %14llu\n", ph->name,
+	       elapsed * 1000 / runs, t->count * runs / elapsed,
+	       t->len * runs / elapsed / (1 << 20),
+	       (double)(allocs - start_allocs) / runs, out / runs);
+
+	dmi_context_free(ctx);
+	return 0;
+}
+
+/*
+ * Throughput check
+ */
+
+/* Structures of a --dump-bin file, walked as the decoder would */
+static unsigned long count_structures(const char *filename)
+{
+	size_t len = 0xFFFFFFFF, off = 0;
+	unsigned long count = 0;
+	u8 *data;
+
+	if ((data = read_file(32, &len, filename, NULL)) == NULL)
+		return 0;
+	while (off + 4 <= len && data[off + 1] >= 4)
+	{
+		count++;
+		if (data[off] == 127)
+			break;
+		off += data[off + 1];
+		while (off + 1 < len && (data[off] != 0 || data[off + 1] != 0))
+			off++;
+		off += 2;
+	}
+	free(data);
+	return count;
+}
+
+/*
+ * Decode filename as dmidecode --from-dump would, from a new context, so
+ * that reading the file is included. Returns -1 if the context can't be
+ * set up. The table may well be broken, so the decoding status doesn't
+ * matter.
+ */
+static int decode_once(const char *filename)
+{
+	char *argv[] = { (char *)"dmibench", (char *)"--from-dump",
+			 (char *)filename, NULL };
+	struct dmi_context *ctx;
+	unsigned long long out = 0;
+
+	if ((ctx = dmi_context_new()) == NULL)
+		return -1;
+	if (dmi_context_set_options(ctx, 3, argv) != 0)
+	{
+		dmi_context_free(ctx);
+		return -1;
+	}
+	dmi_context_set_output(ctx, count_output, &out);
+	dmi_context_decode(ctx);
+	dmi_context_free(ctx);
+	return 0;
+}
+
+/*
+ * Time per structure of filename, in ns, or -1 on error. Batches grow
+ * until long enough to be timed, then the best of CHECK_BATCHES is kept,
+ * as the least disturbed by the rest of the system.
+ */
+static double measure(const char *filename)
+{
+	unsigned long count = count_structures(filename);
+	unsigned int runs = 1, r, batch = 0;
+	double start, elapsed, best = -1;
+
+	if (count == 0)
+	{
+		fprintf(stderr, "%s: No structures\n", filename);
+		return -1;
+	}
+	while (batch < CHECK_BATCHES)
+	{
+		start = now();
+		for (r = 0; r < runs; r++)
+			if (decode_once(filename) != 0)
+				return -1;
+		elapsed = now() - start;
+		if (elapsed < CHECK_BATCH_TIME)
+		{
+			runs *= 2;
+			continue;
+		}
+		if (best < 0 || elapsed / runs < best)
+			best = elapsed / runs;
+		batch++;
+	}
+	return best * 1e9 / count;
+}
+
+/* Write the time per structure of each file to baseline */
+static int record_baseline(const char *baseline, int count,
+			   char * const files[])
+{
+	FILE *f;
+	double ns;
+	int i, ret = 0;
+
+	if ((f = fopen(baseline, "w")) == NULL)
+	{
+		perror(baseline);
+		return 1;
+	}
+	fprintf(f, "# Decoding time per structure (ns), see \"make check\"\n");
+	for (i = 0; i < count; i++)
+	{
+		if ((ns = measure(files[i])) < 0)
+		{
+			ret = 1;
+			continue;
+		}
+		fprintf(f, "%.1f %s\n", ns, files[i]);
+		printf("%-32s %10.1f\n", files[i], ns);
+	}
+	if (fclose(f) != 0)
+	{
+		perror(baseline);
+		ret = 1;
+	}
+	return ret;
+}
+
+/*
+ * Time each file listed in baseline, fail if any is slower than recorded
+ * by more than tolerance percent
+ */
+static int check_baseline(const char *baseline, unsigned int tolerance)
+{
+	char line[1024];
+	unsigned int tables = 0, slower = 0;
+	double ref, ns;
+	FILE *f;
+	int pos, ret = 0;
+
+	if ((f = fopen(baseline, "r")) == NULL)
+	{
+		perror(baseline);
+		return 1;
+	}
+	printf("%-32s %10s %10s %8s\n", "Table", "baseline", "ns/struct",
+	       "ratio");
+	while (fgets(line, sizeof(line), f) != NULL)
+	{
+		line[strcspn(line, "\n")] = '\0';
+		if (line[0] == '#' || line[0] == '\0')
+			continue;
+		if (sscanf(line, "%lf %n", &ref, &pos) != 1 || ref <= 0
+		 || line[pos] == '\0')
+		{
+			fprintf(stderr, "%s: Invalid line: %s\n", baseline, line);
+			ret = 1;
+			continue;
+		}
+		if ((ns = measure(line + pos)) < 0)
+		{
+			ret = 1;
+			continue;
+		}
+		tables++;
+		printf("%-32s %10.1f %10.1f %7.2fx%s\n", line + pos, ref, ns,
+		       ns / ref, ns > ref * (100 + tolerance) / 100
+		       ? "  SLOWER" : "");
+		if (ns > ref * (100 + tolerance) / 100)
+			slower++;
+	}
+	fclose(f);
+
+	if (slower)
+	{
+		printf("%u of %u tables slower than %s by more than %u%%\n",
+		       slower, tables, baseline, tolerance);
+		ret = 1;
+	}
+	return ret;
+}
+
+static void print_usage(void)
+{
+	printf("Usage: dmibench [OPTIONS]\n"
+	       "Options are:\n"
+	       " -2             Use an SMBIOS 2.8 entry point (default: 3.3)\n"
+	       " -m N           Number of memory devices (type 17, default: 4096)\n"
+	       " -s N           Number of OEM strings structures (type 11, default: 16)\n"
+	       " -S N           Strings per OEM strings structure (default: 255)\n"
+	       " -o VENDOR      OEM types to add: hpe (default), lenovo or none\n"
+	       " -p KIND        Add pathological structures: strings, type34,\n"
+	       "                type42 or short, may be repeated\n"
+	       " -n N           Number of measured runs per phase (default: 20,\n"
+	       "                0: only write the table given by -w)\n"
+	       " -w FILE        Keep the generated table in FILE\n"
+	       " -c BASELINE    Check the throughput of the tables of BASELINE\n"
+	       "                instead\n"
+	       " -r BASELINE    Record the throughput of the tables given as\n"
+	       "                arguments into BASELINE instead\n"
+	       " -t PERCENT     Slowdown tolerated by -c (default: %u)\n"
+	       " -h             Display this help text and exit\n",
+	       CHECK_TOLERANCE);
+}
+
+int main(int argc, char * const argv[])
+{
+	static const struct phase phase[] = {
+		{ "text",	{ NULL }, NULL },
+		{ "json",	{ "--format", "json", NULL }, NULL },
+		{ "keyvalue",	{ "--format", "keyvalue", NULL }, NULL },
+		{ "dump",	{ "--dump", NULL }, NULL },
+		{ "string",	{ "-s", "system-serial-number",
+				  "-s", "bios-version", NULL }, NULL },
+		{ "type",	{ "--type", "17", NULL }, NULL },
+		{ "handle",	{ "--handle", "0x0003", NULL }, NULL },
+	};
+	struct phase memory = { "efi-table", { NULL }, NULL };
+	struct table t;
+	u8 ep[32];
+	unsigned int dimms = 4096, oem_count = 16, oem_strings = 255;
+	unsigned int runs = 20, tolerance = CHECK_TOLERANCE, i;
+	int smbios3 = 1, oem = OEM_HPE, path = 0;
+	char tmpname[] = "/tmp/dmibench.XXXXXX";
+	const char *filename = NULL, *check = NULL, *record = NULL;
+	int option, fd, ret = 0;
+
+	while ((option = getopt(argc, argv, "2m:s:S:o:p:n:w:c:r:t:h")) != -1)
+		switch (option)
+		{
+			case '2':
+				smbios3 = 0;
+				break;
+			case 'm':
+				dimms = strtoul(optarg, NULL, 0);
+				break;
+			case 's':
+				oem_count = strtoul(optarg, NULL, 0);
+				break;
+			case 'S':
+				oem_strings = strtoul(optarg, NULL, 0);
+				break;
+			case 'o':
+				if (strcmp(optarg, "hpe") == 0)
+					oem = OEM_HPE;
+				else if (strcmp(optarg, "lenovo") == 0)
+					oem = OEM_LENOVO;
+				else if (strcmp(optarg, "none") == 0)
+					oem = OEM_NONE;
+				else
+				{
+					print_usage();
+					return 2;
+				}
+				break;
+			case 'p':
+				if (strcmp(optarg, "strings") == 0)
+					path |= PATH_STRINGS;
+				else if (strcmp(optarg, "type34") == 0)
+					path |= PATH_TYPE34;
+				else if (strcmp(optarg, "type42") == 0)
+					path |= PATH_TYPE42;
+				else if (strcmp(optarg, "short") == 0)
+					path |= PATH_SHORT;
+				else
+				{
+					print_usage();
+					return 2;
+				}
+				break;
+			case 'n':
+				runs = strtoul(optarg, NULL, 0);
+				break;
+			case 'w':
+				filename = optarg;
+				break;
+			case 'c':
+				check = optarg;
+				break;
+			case 'r':
+				record = optarg;
+				break;
+			case 't':
+				tolerance = strtoul(optarg, NULL, 0);
+				break;
+			case 'h':
+				print_usage();
+				return 0;
+			default:
+				print_usage();
+				return 2;
+		}
+	if (check != NULL)
+		return check_baseline(check, tolerance);
+	if (record != NULL)
+		return record_baseline(record, argc - optind, argv + optind);
+
+	if (oem_strings > 255 || (runs == 0 && filename == NULL)
+	 || dimms + oem_count > 0xFF00)
+	{
+		fprintf(stderr, "Invalid table size or run count\n");
+		return 2;
+	}
+
+	memset(&t, 0, sizeof(t));
+	gen_bios(&t, oem);
+	gen_system(&t, oem);
+	gen_memory(&t, dimms);
+	gen_oem_strings(&t, oem_count, oem_strings);
+	if (oem == OEM_HPE)
+		gen_oem_hpe(&t, 8);
+	else if (oem == OEM_LENOVO)
+		gen_oem_lenovo(&t);
+	if (path & PATH_TYPE34)
+		gen_management_devices(&t);
+	if (path & PATH_TYPE42)
+		gen_host_interface(&t);
+	if (path & PATH_SHORT)
+		gen_short(&t);
+	if (path & PATH_STRINGS)
+		gen_unterminated_strings(&t);
+	else
+	{
+		table_start(&t, 127, 0x04);
+		table_end(&t);
+	}
+
+	if (filename == NULL)
+	{
+		if ((fd = mkstemp(tmpname)) == -1)
+		{
+			perror(tmpname);
+			free(t.data);
+			return 1;
+		}
+		close(fd);
+	}
+	if (write_table(&t, smbios3, filename ? filename : tmpname) != 0)
+	{
+		ret = 1;
+		goto out;
+	}
+	if (runs == 0)
+		goto out;
+
+	printf("SMBIOS %s, %u structures, %lu bytes, %u runs per phase\n",
+	       smbios3 ? "3.3" : "2.8", t.count, (unsigned long)t.len, runs);
+	printf("%-10s %10s %14s %10s %12s %14s\n", "Phase", "ms/run",
+	       "structures/s", "MB/s", "allocs/run", "output bytes");
+	for (i = 0; i < sizeof(phase) / sizeof(phase[0]); i++)
+		if (run_phase(&phase[i], filename ? filename : tmpname, runs,
+			      &t) != 0)
+			ret = 1;
+
+	/* Unless the table is out of reach of an SMBIOS 2.x entry point */
+	if (make_ep(ep, &t, smbios3, (uintptr_t)t.data) == 0)
+	{
+		memory.ep = ep;
+		if (run_phase(&memory, NULL, runs, &t) != 0)
+			ret = 1;
+	}
+
+out:
+	if (filename == NULL)
+		unlink(tmpname);
+	free(t.data);
+	return ret;
+}
@@ -64,6 +64,7 @@
 #include <string.h>
 #include <strings.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <unistd.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
@@ -81,6 +82,16 @@
 #include "dmiopt.h"
 #include "dmioem.h"
 #include "dmioutput.h"
+#include "libdmidecode.h"
+
+#ifdef USE_PTHREAD
+#include <pthread.h>
+#endif
+
+#ifdef USE_WATCH
+#include <signal.h>
+#include <time.h>
+#endif
 
 #define out_of_spec u"<OUT OF SPEC>"
 static const char *bad_index = u"<BAD INDEX>";
@@ -89,6 +100,8 @@ static const char *bad_index = u"<BAD INDEX>";
 
 #define FLAG_NO_FILE_OFFSET     (1 << 0)
 #define FLAG_STOP_AT_EOT        (1 << 1)
+#define FLAG_FROM_EFI           (1 << 2)
+#define FLAG_IN_MEMORY          (1 << 3)	/* Table mapped at its address */
 
 #define SYS_FIRMWARE_DIR "/sys/firmware/dmi/tables"
 #define SYS_ENTRY_FILE SYS_FIRMWARE_DIR "/smbios_entry_point"
@@ -110,6 +123,22 @@ int is_printable(const u8 *data, int len)
 	return 1;
 }
 
+/*
+ * Enumerated fields are decoded with dense tables of names, the first
+ * of which is for code first. Codes which are out of the table, or have
+ * no name (gaps in designated initializers), are out of spec.
+ */
+static const char *dmi_enum_name(const char * const *name, size_t count,
+				 unsigned int first, unsigned int code)
+{
+	if (code - first >= count || name[code - first] == NULL)
+		return out_of_spec;
+	return name[code - first];
+}
+
+#define DMI_ENUM(name, first, code) \
+	dmi_enum_name(name, ARRAY_SIZE(name), first, code)
+
 /* Replace non-ASCII characters with dots */
 static void ascii_filter(char *bp, size_t len)
 {
@@ -120,23 +149,59 @@ static void ascii_filter(char *bp, size_t len)
 			bp[i] = '.';
 }
 
+static void dmi_index_strings(const struct dmi_header *dm)
+{
+	struct dmi_strings *si = dm->strings;
+	const char *bp = (const char *)dm->data + dm->length;
+
+	si->count = 0;
+	memset(si->filtered, 0, sizeof(si->filtered));
+	while (*bp && si->count < (int)ARRAY_SIZE(si->offset))
+	{
+		si->offset[si->count++] = (const u8 *)bp - dm->data;
+		bp += strlen(bp) + 1;
+	}
+}
+
 static char *_dmi_string(const struct dmi_header *dm, u8 s, int filter)
 {
+	struct dmi_strings *si = dm->strings;
 	char *bp = (char *)dm->data;
 
-	bp += dm->length;
-	while (s > 1 && *bp)
+	if (si == NULL)
 	{
-		bp += strlen(bp);
-		bp++;
-		s--;
+		bp += dm->length;
+		while (s > 1 && *bp)
+		{
+			bp += strlen(bp);
+			bp++;
+			s--;
+		}
+
+		if (!*bp)
+			return NULL;
+
+		if (filter)
+			ascii_filter(bp, strlen(bp));
+
+		return bp;
 	}
 
-	if (!*bp)
+	if (si->count < 0)
+		dmi_index_strings(dm);
+
+	/* Index 0 resolves to the first string, as above */
+	if (s == 0)
+		s = 1;
+	if (s > si->count)
 		return NULL;
 
-	if (filter)
+	bp += si->offset[s - 1];
+	if (filter && !(si->filtered[s >> 3] & (1 << (s & 7))))
+	{
 		ascii_filter(bp, strlen(bp));
+		si->filtered[s >> 3] |= 1 << (s & 7);
+	}
 
 	return bp;
 }
@@ -155,9 +220,9 @@ const char *dmi_string(const struct dmi_header *dm, u8 s)
 	return bp;
 }
 
-static const char *dmi_smbios_structure_type(u8 code)
+static MAYBE_UNUSED const char *dmi_smbios_structure_type(u8 code)
 {
-	static const char *type[] = {
+	static const char * const type[] = {
 		u"BIOS", /* 0 */
 		u"System",
 		u"Base Board",
@@ -206,12 +271,10 @@ static const char *dmi_smbios_structure_type(u8 code)
 
 	if (code >= 128)
 		return u"OEM-specific";
-	if (code <= 43)
-		return type[code];
-	return out_of_spec;
+	return DMI_ENUM(type, 0x00, code);
 }
 
-static int dmi_bcd_range(u8 value, u8 low, u8 high)
+static MAYBE_UNUSED int dmi_bcd_range(u8 value, u8 low, u8 high)
 {
 	if (value > 0x99 || (value & 0x0F) > 0x09)
 		return 0;
@@ -220,43 +283,27 @@ static int dmi_bcd_range(u8 value, u8 low, u8 high)
 	return 1;
 }
 
-static void dmi_dump(const struct dmi_header *h)
+static void dmi_dump(struct dmi_context *ctx, const struct dmi_header *h)
 {
-	static char raw_data[48];
-	int row, i;
-	unsigned int off;
+	int i;
 	char *s;
 
 	pr_list_start(u"Header and Data", NULL);
-	for (row = 0; row < ((h->length - 1) >> 4) + 1; row++)
-	{
-		off = 0;
-		for (i = 0; i < 16 && i < h->length - (row << 4); i++)
-			off += sprintf(raw_data + off, i ? u" %02X" : u"%02X",
-			       (h->data)[(row << 4) + i]);
-		pr_list_item(raw_data);
-	}
+	pr_list_hex(h->data, h->length);
 	pr_list_end();
 
 	if ((h->data)[h->length] || (h->data)[h->length + 1])
 	{
 		pr_list_start(u"Strings", NULL);
 		i = 1;
-		while ((s = _dmi_string(h, i++, !(opt.flags & FLAG_DUMP))))
+		while (i <= 255
+		    && (s = _dmi_string(h, i++, !(ctx->opt.flags & FLAG_DUMP))))
 		{
-			if (opt.flags & FLAG_DUMP)
+			if (ctx->opt.flags & FLAG_DUMP)
 			{
-				int j, l = strlen(s) + 1;
+				int l = strlen(s) + 1;
 
-				for (row = 0; row < ((l - 1) >> 4) + 1; row++)
-				{
-					off = 0;
-					for (j = 0; j < 16 && j < l - (row << 4); j++)
-						off += sprintf(raw_data + off,
-						       j ? u" %02X" : u"%02X",
-						       (unsigned char)s[(row << 4) + j]);
-					pr_list_item(raw_data);
-				}
+				pr_list_hex((u8 *)s, l);
 				/* String isn't filtered yet so do it now */
 				ascii_filter(s, l - 1);
 			}
@@ -266,12 +313,25 @@ static void dmi_dump(const struct dmi_header *h)
 	}
 }
 
+/*
+ * --compact: the whole structure, string area included, on a single line.
+ * The structure must fit in the table.
+ */
+static void dmi_dump_compact(const struct dmi_header *h)
+{
+	const u8 *p = h->data + h->length;
+
+	while (p[0] || p[1])
+		p++;
+	pr_compact(h, h->data, p + 2 - h->data);
+}
+
 /* shift is 0 if the value is in bytes, 1 if it is in kilobytes */
 void dmi_print_memory_size(const char *attr, u64 code, int shift)
 {
 	unsigned long capacity;
 	u16 split[7];
-	static const char *unit[8] = {
+	static const char * const unit[8] = {
 		u"bytes", u"kB", u"MB", u"GB", u"TB", u"PB", u"EB", u"ZB"
 	};
 	int i;
@@ -310,6 +370,7 @@ void dmi_print_memory_size(const char *attr, u64 code, int shift)
 	pr_attr(attr, u"%lu %s", capacity, unit[i + shift]);
 }
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_0
 /*
  * 7.1 BIOS Information (Type 0)
  */
@@ -333,7 +394,7 @@ static void dmi_bios_runtime_size(u32 code)
 
 static void dmi_bios_rom_size(u8 code1, u16 code2)
 {
-	static const char *unit[4] = {
+	static const char * const unit[4] = {
 		u"MB", u"GB", out_of_spec, out_of_spec
 	};
 
@@ -349,7 +410,7 @@ static void dmi_bios_rom_size(u8 code1, u16 code2)
 static void dmi_bios_characteristics(u64 code)
 {
 	/* 7.1.1 */
-	static const char *characteristics[] = {
+	static const char * const characteristics[] = {
 		u"BIOS characteristics not supported", /* 3 */
 		u"ISA is supported",
 		u"MCA is supported",
@@ -399,7 +460,7 @@ static void dmi_bios_characteristics(u64 code)
 static void dmi_bios_characteristics_x1(u8 code)
 {
 	/* 7.1.2.1 */
-	static const char *characteristics[] = {
+	static const char * const characteristics[] = {
 		u"ACPI is supported", /* 0 */
 		u"USB legacy is supported",
 		u"AGP is supported",
@@ -419,7 +480,7 @@ static void dmi_bios_characteristics_x1(u8 code)
 static void dmi_bios_characteristics_x2(u8 code)
 {
 	/* 37.1.2.2 */
-	static const char *characteristics[] = {
+	static const char * const characteristics[] = {
 		u"BIOS boot specification is supported", /* 0 */
 		u"Function key-initiated network boot is supported",
 		u"Targeted content distribution is supported",
@@ -432,6 +493,7 @@ static void dmi_bios_characteristics_x2(u8 code)
 		if (code & (1 << i))
 			pr_list_item(u"%s", characteristics[i]);
 }
+#endif
 
 /*
  * 7.2 System Information (Type 1)
@@ -454,7 +516,7 @@ static void dmi_system_uuid(void (*print_cb)(const char *name, const char *forma
 		if (print_cb)
 			print_cb(attr, u"Not Present");
 		else
-			printf(u"Not Present\n");
+			pr_info(u"Not Present");
 		return;
 	}
 	if (only0x00)
@@ -462,7 +524,7 @@ static void dmi_system_uuid(void (*print_cb)(const char *name, const char *forma
 		if (print_cb)
 			print_cb(attr, u"Not Settable");
 		else
-			printf(u"Not Settable\n");
+			pr_info(u"Not Settable");
 		return;
 	}
 
@@ -482,7 +544,7 @@ static void dmi_system_uuid(void (*print_cb)(const char *name, const char *forma
 				p[3], p[2], p[1], p[0], p[5], p[4], p[7], p[6],
 				p[8], p[9], p[10], p[11], p[12], p[13], p[14], p[15]);
 		else
-			printf(u"%02x%02x%02x%02x-%02x%02x-%02x%02x-%02x%02x-%02x%02x%02x%02x%02x%02x\n",
+			pr_info(u"%02x%02x%02x%02x-%02x%02x-%02x%02x-%02x%02x-%02x%02x%02x%02x%02x%02x",
 				p[3], p[2], p[1], p[0], p[5], p[4], p[7], p[6],
 				p[8], p[9], p[10], p[11], p[12], p[13], p[14], p[15]);
 	}
@@ -494,16 +556,17 @@ static void dmi_system_uuid(void (*print_cb)(const char *name, const char *forma
 				p[0], p[1], p[2], p[3], p[4], p[5], p[6], p[7],
 				p[8], p[9], p[10], p[11], p[12], p[13], p[14], p[15]);
 		else
-			printf(u"%02x%02x%02x%02x-%02x%02x-%02x%02x-%02x%02x-%02x%02x%02x%02x%02x%02x\n",
+			pr_info(u"%02x%02x%02x%02x-%02x%02x-%02x%02x-%02x%02x-%02x%02x%02x%02x%02x%02x",
 				p[0], p[1], p[2], p[3], p[4], p[5], p[6], p[7],
 				p[8], p[9], p[10], p[11], p[12], p[13], p[14], p[15]);
 	}
 }
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_1
 static const char *dmi_system_wake_up_type(u8 code)
 {
 	/* 7.2.2 */
-	static const char *type[] = {
+	static const char * const type[] = {
 		u"Reserved", /* 0x00 */
 		u"Other",
 		u"Unknown",
@@ -515,11 +578,11 @@ static const char *dmi_system_wake_up_type(u8 code)
 		u"AC Power Restored" /* 0x08 */
 	};
 
-	if (code <= 0x08)
-		return type[code];
-	return out_of_spec;
+	return DMI_ENUM(type, 0x00, code);
 }
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_2
 /*
  * 7.3 Base Board Information (Type 2)
  */
@@ -527,7 +590,7 @@ static const char *dmi_system_wake_up_type(u8 code)
 static void dmi_base_board_features(u8 code)
 {
 	/* 7.3.1 */
-	static const char *features[] = {
+	static const char * const features[] = {
 		u"Board is a hosting board", /* 0 */
 		u"Board requires at least one daughter board",
 		u"Board is removable",
@@ -548,11 +611,12 @@ static void dmi_base_board_features(u8 code)
 	}
 	pr_list_end();
 }
+#endif
 
-static const char *dmi_base_board_type(u8 code)
+static MAYBE_UNUSED const char *dmi_base_board_type(u8 code)
 {
 	/* 7.3.2 */
-	static const char *type[] = {
+	static const char * const type[] = {
 		u"Unknown", /* 0x01 */
 		u"Other",
 		u"Server Blade",
@@ -568,11 +632,10 @@ static const char *dmi_base_board_type(u8 code)
 		u"Interconnect Board" /* 0x0D */
 	};
 
-	if (code >= 0x01 && code <= 0x0D)
-		return type[code - 0x01];
-	return out_of_spec;
+	return DMI_ENUM(type, 0x01, code);
 }
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_2
 static void dmi_base_board_handles(u8 count, const u8 *p)
 {
 	int i;
@@ -582,6 +645,7 @@ static void dmi_base_board_handles(u8 count, const u8 *p)
 		pr_list_item(u"0x%04X", WORD(p + sizeof(u16) * i));
 	pr_list_end();
 }
+#endif
 
 /*
  * 7.4 Chassis Information (Type 3)
@@ -590,7 +654,7 @@ static void dmi_base_board_handles(u8 count, const u8 *p)
 static const char *dmi_chassis_type(u8 code)
 {
 	/* 7.4.1 */
-	static const char *type[] = {
+	static const char * const type[] = {
 		u"Other", /* 0x01 */
 		u"Unknown",
 		u"Desktop",
@@ -631,14 +695,13 @@ static const char *dmi_chassis_type(u8 code)
 
 	code &= 0x7F; /* bits 6:0 are chassis type, 7th bit is the lock bit */
 
-	if (code >= 0x01 && code <= 0x24)
-		return type[code - 0x01];
-	return out_of_spec;
+	return DMI_ENUM(type, 0x01, code);
 }
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_3
 static const char *dmi_chassis_lock(u8 code)
 {
-	static const char *lock[] = {
+	static const char * const lock[] = {
 		u"Not Present", /* 0x00 */
 		u"Present" /* 0x01 */
 	};
@@ -649,7 +712,7 @@ static const char *dmi_chassis_lock(u8 code)
 static const char *dmi_chassis_state(u8 code)
 {
 	/* 7.4.2 */
-	static const char *state[] = {
+	static const char * const state[] = {
 		u"Other", /* 0x01 */
 		u"Unknown",
 		u"Safe",
@@ -658,15 +721,13 @@ static const char *dmi_chassis_state(u8 code)
 		u"Non-recoverable" /* 0x06 */
 	};
 
-	if (code >= 0x01 && code <= 0x06)
-		return state[code - 0x01];
-	return out_of_spec;
+	return DMI_ENUM(state, 0x01, code);
 }
 
 static const char *dmi_chassis_security_status(u8 code)
 {
 	/* 7.4.3 */
-	static const char *status[] = {
+	static const char * const status[] = {
 		u"Other", /* 0x01 */
 		u"Unknown",
 		u"None",
@@ -674,9 +735,7 @@ static const char *dmi_chassis_security_status(u8 code)
 		u"External Interface Enabled" /* 0x05 */
 	};
 
-	if (code >= 0x01 && code <= 0x05)
-		return status[code - 0x01];
-	return out_of_spec;
+	return DMI_ENUM(status, 0x01, code);
 }
 
 static void dmi_chassis_height(u8 code)
@@ -719,7 +778,9 @@ static void dmi_chassis_elements(u8 count, u8 len, const u8 *p)
 	}
 	pr_list_end();
 }
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_4
 /*
  * 7.5 Processor Information (Type 4)
  */
@@ -727,7 +788,7 @@ static void dmi_chassis_elements(u8 count, u8 len, const u8 *p)
 static const char *dmi_processor_type(u8 code)
 {
 	/* 7.5.1 */
-	static const char *type[] = {
+	static const char * const type[] = {
 		u"Other", /* 0x01 */
 		u"Unknown",
 		u"Central Processor",
@@ -736,250 +797,245 @@ static const char *dmi_processor_type(u8 code)
 		u"Video Processor" /* 0x06 */
 	};
 
-	if (code >= 0x01 && code <= 0x06)
-		return type[code - 0x01];
-	return out_of_spec;
+	return DMI_ENUM(type, 0x01, code);
 }
+#endif
 
 static const char *dmi_processor_family(const struct dmi_header *h, u16 ver)
 {
 	const u8 *data = h->data;
-	unsigned int i, low, high;
 	u16 code;
 
-	/* 7.5.2 */
-	static struct {
-		int value;
-		const char *name;
-	} family2[] = {
-		{ 0x01, u"Other" },
-		{ 0x02, u"Unknown" },
-		{ 0x03, u"8086" },
-		{ 0x04, u"80286" },
-		{ 0x05, u"80386" },
-		{ 0x06, u"80486" },
-		{ 0x07, u"8087" },
-		{ 0x08, u"80287" },
-		{ 0x09, u"80387" },
-		{ 0x0A, u"80487" },
-		{ 0x0B, u"Pentium" },
-		{ 0x0C, u"Pentium Pro" },
-		{ 0x0D, u"Pentium II" },
-		{ 0x0E, u"Pentium MMX" },
-		{ 0x0F, u"Celeron" },
-		{ 0x10, u"Pentium II Xeon" },
-		{ 0x11, u"Pentium III" },
-		{ 0x12, u"M1" },
-		{ 0x13, u"M2" },
-		{ 0x14, u"Celeron M" },
-		{ 0x15, u"Pentium 4 HT" },
-
-		{ 0x18, u"Duron" },
-		{ 0x19, u"K5" },
-		{ 0x1A, u"K6" },
-		{ 0x1B, u"K6-2" },
-		{ 0x1C, u"K6-3" },
-		{ 0x1D, u"Athlon" },
-		{ 0x1E, u"AMD29000" },
-		{ 0x1F, u"K6-2+" },
-		{ 0x20, u"Power PC" },
-		{ 0x21, u"Power PC 601" },
-		{ 0x22, u"Power PC 603" },
-		{ 0x23, u"Power PC 603+" },
-		{ 0x24, u"Power PC 604" },
-		{ 0x25, u"Power PC 620" },
-		{ 0x26, u"Power PC x704" },
-		{ 0x27, u"Power PC 750" },
-		{ 0x28, u"Core Duo" },
-		{ 0x29, u"Core Duo Mobile" },
-		{ 0x2A, u"Core Solo Mobile" },
-		{ 0x2B, u"Atom" },
-		{ 0x2C, u"Core M" },
-		{ 0x2D, u"Core m3" },
-		{ 0x2E, u"Core m5" },
-		{ 0x2F, u"Core m7" },
-		{ 0x30, u"Alpha" },
-		{ 0x31, u"Alpha 21064" },
-		{ 0x32, u"Alpha 21066" },
-		{ 0x33, u"Alpha 21164" },
-		{ 0x34, u"Alpha 21164PC" },
-		{ 0x35, u"Alpha 21164a" },
-		{ 0x36, u"Alpha 21264" },
-		{ 0x37, u"Alpha 21364" },
-		{ 0x38, u"Turion II Ultra Dual-Core Mobile M" },
-		{ 0x39, u"Turion II Dual-Core Mobile M" },
-		{ 0x3A, u"Athlon II Dual-Core M" },
-		{ 0x3B, u"Opteron 6100" },
-		{ 0x3C, u"Opteron 4100" },
-		{ 0x3D, u"Opteron 6200" },
-		{ 0x3E, u"Opteron 4200" },
-		{ 0x3F, u"FX" },
-		{ 0x40, u"MIPS" },
-		{ 0x41, u"MIPS R4000" },
-		{ 0x42, u"MIPS R4200" },
-		{ 0x43, u"MIPS R4400" },
-		{ 0x44, u"MIPS R4600" },
-		{ 0x45, u"MIPS R10000" },
-		{ 0x46, u"C-Series" },
-		{ 0x47, u"E-Series" },
-		{ 0x48, u"A-Series" },
-		{ 0x49, u"G-Series" },
-		{ 0x4A, u"Z-Series" },
-		{ 0x4B, u"R-Series" },
-		{ 0x4C, u"Opteron 4300" },
-		{ 0x4D, u"Opteron 6300" },
-		{ 0x4E, u"Opteron 3300" },
-		{ 0x4F, u"FirePro" },
-		{ 0x50, u"SPARC" },
-		{ 0x51, u"SuperSPARC" },
-		{ 0x52, u"MicroSPARC II" },
-		{ 0x53, u"MicroSPARC IIep" },
-		{ 0x54, u"UltraSPARC" },
-		{ 0x55, u"UltraSPARC II" },
-		{ 0x56, u"UltraSPARC IIi" },
-		{ 0x57, u"UltraSPARC III" },
-		{ 0x58, u"UltraSPARC IIIi" },
-
-		{ 0x60, u"68040" },
-		{ 0x61, u"68xxx" },
-		{ 0x62, u"68000" },
-		{ 0x63, u"68010" },
-		{ 0x64, u"68020" },
-		{ 0x65, u"68030" },
-		{ 0x66, u"Athlon X4" },
-		{ 0x67, u"Opteron X1000" },
-		{ 0x68, u"Opteron X2000" },
-		{ 0x69, u"Opteron A-Series" },
-		{ 0x6A, u"Opteron X3000" },
-		{ 0x6B, u"Zen" },
-
-		{ 0x70, u"Hobbit" },
-
-		{ 0x78, u"Crusoe TM5000" },
-		{ 0x79, u"Crusoe TM3000" },
-		{ 0x7A, u"Efficeon TM8000" },
-
-		{ 0x80, u"Weitek" },
-
-		{ 0x82, u"Itanium" },
-		{ 0x83, u"Athlon 64" },
-		{ 0x84, u"Opteron" },
-		{ 0x85, u"Sempron" },
-		{ 0x86, u"Turion 64" },
-		{ 0x87, u"Dual-Core Opteron" },
-		{ 0x88, u"Athlon 64 X2" },
-		{ 0x89, u"Turion 64 X2" },
-		{ 0x8A, u"Quad-Core Opteron" },
-		{ 0x8B, u"Third-Generation Opteron" },
-		{ 0x8C, u"Phenom FX" },
-		{ 0x8D, u"Phenom X4" },
-		{ 0x8E, u"Phenom X2" },
-		{ 0x8F, u"Athlon X2" },
-		{ 0x90, u"PA-RISC" },
-		{ 0x91, u"PA-RISC 8500" },
-		{ 0x92, u"PA-RISC 8000" },
-		{ 0x93, u"PA-RISC 7300LC" },
-		{ 0x94, u"PA-RISC 7200" },
-		{ 0x95, u"PA-RISC 7100LC" },
-		{ 0x96, u"PA-RISC 7100" },
-
-		{ 0xA0, u"V30" },
-		{ 0xA1, u"Quad-Core Xeon 3200" },
-		{ 0xA2, u"Dual-Core Xeon 3000" },
-		{ 0xA3, u"Quad-Core Xeon 5300" },
-		{ 0xA4, u"Dual-Core Xeon 5100" },
-		{ 0xA5, u"Dual-Core Xeon 5000" },
-		{ 0xA6, u"Dual-Core Xeon LV" },
-		{ 0xA7, u"Dual-Core Xeon ULV" },
-		{ 0xA8, u"Dual-Core Xeon 7100" },
-		{ 0xA9, u"Quad-Core Xeon 5400" },
-		{ 0xAA, u"Quad-Core Xeon" },
-		{ 0xAB, u"Dual-Core Xeon 5200" },
-		{ 0xAC, u"Dual-Core Xeon 7200" },
-		{ 0xAD, u"Quad-Core Xeon 7300" },
-		{ 0xAE, u"Quad-Core Xeon 7400" },
-		{ 0xAF, u"Multi-Core Xeon 7400" },
-		{ 0xB0, u"Pentium III Xeon" },
-		{ 0xB1, u"Pentium III Speedstep" },
-		{ 0xB2, u"Pentium 4" },
-		{ 0xB3, u"Xeon" },
-		{ 0xB4, u"AS400" },
-		{ 0xB5, u"Xeon MP" },
-		{ 0xB6, u"Athlon XP" },
-		{ 0xB7, u"Athlon MP" },
-		{ 0xB8, u"Itanium 2" },
-		{ 0xB9, u"Pentium M" },
-		{ 0xBA, u"Celeron D" },
-		{ 0xBB, u"Pentium D" },
-		{ 0xBC, u"Pentium EE" },
-		{ 0xBD, u"Core Solo" },
+	/* 7.5.2, indexed by family code */
+	static const char * const family2[] = {
+		[0x01] = u"Other",
+		[0x02] = u"Unknown",
+		[0x03] = u"8086",
+		[0x04] = u"80286",
+		[0x05] = u"80386",
+		[0x06] = u"80486",
+		[0x07] = u"8087",
+		[0x08] = u"80287",
+		[0x09] = u"80387",
+		[0x0A] = u"80487",
+		[0x0B] = u"Pentium",
+		[0x0C] = u"Pentium Pro",
+		[0x0D] = u"Pentium II",
+		[0x0E] = u"Pentium MMX",
+		[0x0F] = u"Celeron",
+		[0x10] = u"Pentium II Xeon",
+		[0x11] = u"Pentium III",
+		[0x12] = u"M1",
+		[0x13] = u"M2",
+		[0x14] = u"Celeron M",
+		[0x15] = u"Pentium 4 HT",
+
+		[0x18] = u"Duron",
+		[0x19] = u"K5",
+		[0x1A] = u"K6",
+		[0x1B] = u"K6-2",
+		[0x1C] = u"K6-3",
+		[0x1D] = u"Athlon",
+		[0x1E] = u"AMD29000",
+		[0x1F] = u"K6-2+",
+		[0x20] = u"Power PC",
+		[0x21] = u"Power PC 601",
+		[0x22] = u"Power PC 603",
+		[0x23] = u"Power PC 603+",
+		[0x24] = u"Power PC 604",
+		[0x25] = u"Power PC 620",
+		[0x26] = u"Power PC x704",
+		[0x27] = u"Power PC 750",
+		[0x28] = u"Core Duo",
+		[0x29] = u"Core Duo Mobile",
+		[0x2A] = u"Core Solo Mobile",
+		[0x2B] = u"Atom",
+		[0x2C] = u"Core M",
+		[0x2D] = u"Core m3",
+		[0x2E] = u"Core m5",
+		[0x2F] = u"Core m7",
+		[0x30] = u"Alpha",
+		[0x31] = u"Alpha 21064",
+		[0x32] = u"Alpha 21066",
+		[0x33] = u"Alpha 21164",
+		[0x34] = u"Alpha 21164PC",
+		[0x35] = u"Alpha 21164a",
+		[0x36] = u"Alpha 21264",
+		[0x37] = u"Alpha 21364",
+		[0x38] = u"Turion II Ultra Dual-Core Mobile M",
+		[0x39] = u"Turion II Dual-Core Mobile M",
+		[0x3A] = u"Athlon II Dual-Core M",
+		[0x3B] = u"Opteron 6100",
+		[0x3C] = u"Opteron 4100",
+		[0x3D] = u"Opteron 6200",
+		[0x3E] = u"Opteron 4200",
+		[0x3F] = u"FX",
+		[0x40] = u"MIPS",
+		[0x41] = u"MIPS R4000",
+		[0x42] = u"MIPS R4200",
+		[0x43] = u"MIPS R4400",
+		[0x44] = u"MIPS R4600",
+		[0x45] = u"MIPS R10000",
+		[0x46] = u"C-Series",
+		[0x47] = u"E-Series",
+		[0x48] = u"A-Series",
+		[0x49] = u"G-Series",
+		[0x4A] = u"Z-Series",
+		[0x4B] = u"R-Series",
+		[0x4C] = u"Opteron 4300",
+		[0x4D] = u"Opteron 6300",
+		[0x4E] = u"Opteron 3300",
+		[0x4F] = u"FirePro",
+		[0x50] = u"SPARC",
+		[0x51] = u"SuperSPARC",
+		[0x52] = u"MicroSPARC II",
+		[0x53] = u"MicroSPARC IIep",
+		[0x54] = u"UltraSPARC",
+		[0x55] = u"UltraSPARC II",
+		[0x56] = u"UltraSPARC IIi",
+		[0x57] = u"UltraSPARC III",
+		[0x58] = u"UltraSPARC IIIi",
+
+		[0x60] = u"68040",
+		[0x61] = u"68xxx",
+		[0x62] = u"68000",
+		[0x63] = u"68010",
+		[0x64] = u"68020",
+		[0x65] = u"68030",
+		[0x66] = u"Athlon X4",
+		[0x67] = u"Opteron X1000",
+		[0x68] = u"Opteron X2000",
+		[0x69] = u"Opteron A-Series",
+		[0x6A] = u"Opteron X3000",
+		[0x6B] = u"Zen",
+
+		[0x70] = u"Hobbit",
+
+		[0x78] = u"Crusoe TM5000",
+		[0x79] = u"Crusoe TM3000",
+		[0x7A] = u"Efficeon TM8000",
+
+		[0x80] = u"Weitek",
+
+		[0x82] = u"Itanium",
+		[0x83] = u"Athlon 64",
+		[0x84] = u"Opteron",
+		[0x85] = u"Sempron",
+		[0x86] = u"Turion 64",
+		[0x87] = u"Dual-Core Opteron",
+		[0x88] = u"Athlon 64 X2",
+		[0x89] = u"Turion 64 X2",
+		[0x8A] = u"Quad-Core Opteron",
+		[0x8B] = u"Third-Generation Opteron",
+		[0x8C] = u"Phenom FX",
+		[0x8D] = u"Phenom X4",
+		[0x8E] = u"Phenom X2",
+		[0x8F] = u"Athlon X2",
+		[0x90] = u"PA-RISC",
+		[0x91] = u"PA-RISC 8500",
+		[0x92] = u"PA-RISC 8000",
+		[0x93] = u"PA-RISC 7300LC",
+		[0x94] = u"PA-RISC 7200",
+		[0x95] = u"PA-RISC 7100LC",
+		[0x96] = u"PA-RISC 7100",
+
+		[0xA0] = u"V30",
+		[0xA1] = u"Quad-Core Xeon 3200",
+		[0xA2] = u"Dual-Core Xeon 3000",
+		[0xA3] = u"Quad-Core Xeon 5300",
+		[0xA4] = u"Dual-Core Xeon 5100",
+		[0xA5] = u"Dual-Core Xeon 5000",
+		[0xA6] = u"Dual-Core Xeon LV",
+		[0xA7] = u"Dual-Core Xeon ULV",
+		[0xA8] = u"Dual-Core Xeon 7100",
+		[0xA9] = u"Quad-Core Xeon 5400",
+		[0xAA] = u"Quad-Core Xeon",
+		[0xAB] = u"Dual-Core Xeon 5200",
+		[0xAC] = u"Dual-Core Xeon 7200",
+		[0xAD] = u"Quad-Core Xeon 7300",
+		[0xAE] = u"Quad-Core Xeon 7400",
+		[0xAF] = u"Multi-Core Xeon 7400",
+		[0xB0] = u"Pentium III Xeon",
+		[0xB1] = u"Pentium III Speedstep",
+		[0xB2] = u"Pentium 4",
+		[0xB3] = u"Xeon",
+		[0xB4] = u"AS400",
+		[0xB5] = u"Xeon MP",
+		[0xB6] = u"Athlon XP",
+		[0xB7] = u"Athlon MP",
+		[0xB8] = u"Itanium 2",
+		[0xB9] = u"Pentium M",
+		[0xBA] = u"Celeron D",
+		[0xBB] = u"Pentium D",
+		[0xBC] = u"Pentium EE",
+		[0xBD] = u"Core Solo",
 		/* 0xBE handled as a special case */
-		{ 0xBF, u"Core 2 Duo" },
-		{ 0xC0, u"Core 2 Solo" },
-		{ 0xC1, u"Core 2 Extreme" },
-		{ 0xC2, u"Core 2 Quad" },
-		{ 0xC3, u"Core 2 Extreme Mobile" },
-		{ 0xC4, u"Core 2 Duo Mobile" },
-		{ 0xC5, u"Core 2 Solo Mobile" },
-		{ 0xC6, u"Core i7" },
-		{ 0xC7, u"Dual-Core Celeron" },
-		{ 0xC8, u"IBM390" },
-		{ 0xC9, u"G4" },
-		{ 0xCA, u"G5" },
-		{ 0xCB, u"ESA/390 G6" },
-		{ 0xCC, u"z/Architecture" },
-		{ 0xCD, u"Core i5" },
-		{ 0xCE, u"Core i3" },
-		{ 0xCF, u"Core i9" },
-
-		{ 0xD2, u"C7-M" },
-		{ 0xD3, u"C7-D" },
-		{ 0xD4, u"C7" },
-		{ 0xD5, u"Eden" },
-		{ 0xD6, u"Multi-Core Xeon" },
-		{ 0xD7, u"Dual-Core Xeon 3xxx" },
-		{ 0xD8, u"Quad-Core Xeon 3xxx" },
-		{ 0xD9, u"Nano" },
-		{ 0xDA, u"Dual-Core Xeon 5xxx" },
-		{ 0xDB, u"Quad-Core Xeon 5xxx" },
-
-		{ 0xDD, u"Dual-Core Xeon 7xxx" },
-		{ 0xDE, u"Quad-Core Xeon 7xxx" },
-		{ 0xDF, u"Multi-Core Xeon 7xxx" },
-		{ 0xE0, u"Multi-Core Xeon 3400" },
-
-		{ 0xE4, u"Opteron 3000" },
-		{ 0xE5, u"Sempron II" },
-		{ 0xE6, u"Embedded Opteron Quad-Core" },
-		{ 0xE7, u"Phenom Triple-Core" },
-		{ 0xE8, u"Turion Ultra Dual-Core Mobile" },
-		{ 0xE9, u"Turion Dual-Core Mobile" },
-		{ 0xEA, u"Athlon Dual-Core" },
-		{ 0xEB, u"Sempron SI" },
-		{ 0xEC, u"Phenom II" },
-		{ 0xED, u"Athlon II" },
-		{ 0xEE, u"Six-Core Opteron" },
-		{ 0xEF, u"Sempron M" },
-
-		{ 0xFA, u"i860" },
-		{ 0xFB, u"i960" },
-
-		{ 0x100, u"ARMv7" },
-		{ 0x101, u"ARMv8" },
-		{ 0x104, u"SH-3" },
-		{ 0x105, u"SH-4" },
-		{ 0x118, u"ARM" },
-		{ 0x119, u"StrongARM" },
-		{ 0x12C, u"6x86" },
-		{ 0x12D, u"MediaGX" },
-		{ 0x12E, u"MII" },
-		{ 0x140, u"WinChip" },
-		{ 0x15E, u"DSP" },
-		{ 0x1F4, u"Video Processor" },
-
-		{ 0x200, u"RV32" },
-		{ 0x201, u"RV64" },
-		{ 0x202, u"RV128" },
+		[0xBF] = u"Core 2 Duo",
+		[0xC0] = u"Core 2 Solo",
+		[0xC1] = u"Core 2 Extreme",
+		[0xC2] = u"Core 2 Quad",
+		[0xC3] = u"Core 2 Extreme Mobile",
+		[0xC4] = u"Core 2 Duo Mobile",
+		[0xC5] = u"Core 2 Solo Mobile",
+		[0xC6] = u"Core i7",
+		[0xC7] = u"Dual-Core Celeron",
+		[0xC8] = u"IBM390",
+		[0xC9] = u"G4",
+		[0xCA] = u"G5",
+		[0xCB] = u"ESA/390 G6",
+		[0xCC] = u"z/Architecture",
+		[0xCD] = u"Core i5",
+		[0xCE] = u"Core i3",
+		[0xCF] = u"Core i9",
+
+		[0xD2] = u"C7-M",
+		[0xD3] = u"C7-D",
+		[0xD4] = u"C7",
+		[0xD5] = u"Eden",
+		[0xD6] = u"Multi-Core Xeon",
+		[0xD7] = u"Dual-Core Xeon 3xxx",
+		[0xD8] = u"Quad-Core Xeon 3xxx",
+		[0xD9] = u"Nano",
+		[0xDA] = u"Dual-Core Xeon 5xxx",
+		[0xDB] = u"Quad-Core Xeon 5xxx",
+
+		[0xDD] = u"Dual-Core Xeon 7xxx",
+		[0xDE] = u"Quad-Core Xeon 7xxx",
+		[0xDF] = u"Multi-Core Xeon 7xxx",
+		[0xE0] = u"Multi-Core Xeon 3400",
+
+		[0xE4] = u"Opteron 3000",
+		[0xE5] = u"Sempron II",
+		[0xE6] = u"Embedded Opteron Quad-Core",
+		[0xE7] = u"Phenom Triple-Core",
+		[0xE8] = u"Turion Ultra Dual-Core Mobile",
+		[0xE9] = u"Turion Dual-Core Mobile",
+		[0xEA] = u"Athlon Dual-Core",
+		[0xEB] = u"Sempron SI",
+		[0xEC] = u"Phenom II",
+		[0xED] = u"Athlon II",
+		[0xEE] = u"Six-Core Opteron",
+		[0xEF] = u"Sempron M",
+
+		[0xFA] = u"i860",
+		[0xFB] = u"i960",
+
+		[0x100] = u"ARMv7",
+		[0x101] = u"ARMv8",
+		[0x104] = u"SH-3",
+		[0x105] = u"SH-4",
+		[0x118] = u"ARM",
+		[0x119] = u"StrongARM",
+		[0x12C] = u"6x86",
+		[0x12D] = u"MediaGX",
+		[0x12E] = u"MII",
+		[0x140] = u"WinChip",
+		[0x15E] = u"DSP",
+		[0x1F4] = u"Video Processor",
+
+		[0x200] = u"RV32",
+		[0x201] = u"RV64",
+		[0x202] = u"RV128",
 	};
 	/*
 	 * Note to developers: when adding entries to this list, check if
@@ -1018,29 +1074,14 @@ static const char *dmi_processor_family(const struct dmi_header *h, u16 ver)
 		return u"Core 2 or K7";
 	}
 
-	/* Perform a binary search */
-	low = 0;
-	high = ARRAY_SIZE(family2) - 1;
-
-	while (1)
-	{
-		i = (low + high) / 2;
-		if (family2[i].value == code)
-			return family2[i].name;
-		if (low == high) /* Not found */
-			return out_of_spec;
-
-		if (code < family2[i].value)
-			high = i;
-		else
-			low = i + 1;
-	}
+	return DMI_ENUM(family2, 0x00, code);
 }
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_4
 static void dmi_processor_id(const struct dmi_header *h)
 {
 	/* Intel AP-485 revision 36, table 2-4 */
-	static const char *flags[32] = {
+	static const char * const flags[32] = {
 		u"FPU (Floating-point unit on-chip)", /* 0 */
 		u"VME (Virtual mode extension)",
 		u"DE (Debugging extension)",
@@ -1206,6 +1247,9 @@ static void dmi_processor_id(const struct dmi_header *h)
 			break;
 	}
 
+	if (!pr_field_wanted(u"Flags"))
+		return;
+
 	edx = DWORD(p + 4);
 	if ((edx & 0xBFEFFBFF) == 0)
 		pr_list_start(u"Flags", u"None");
@@ -1220,11 +1264,12 @@ static void dmi_processor_id(const struct dmi_header *h)
 	}
 	pr_list_end();
 }
+#endif
 
-static void dmi_processor_voltage(const char *attr, u8 code)
+static MAYBE_UNUSED void dmi_processor_voltage(const char *attr, u8 code)
 {
 	/* 7.5.4 */
-	static const char *voltage[] = {
+	static const char * const voltage[] = {
 		u"5.0 V", /* 0 */
 		u"3.3 V",
 		u"2.9 V" /* 2 */
@@ -1255,30 +1300,22 @@ static void dmi_processor_voltage(const char *attr, u8 code)
 	}
 }
 
-static void dmi_processor_frequency(const char *attr, const u8 *p)
+static void dmi_processor_frequency(void (*print_cb)(const char *name, const char *format, ...),
+				    const char *attr, const u8 *p)
 {
 	u16 code = WORD(p);
 
 	if (code)
-	{
-		if (attr)
-			pr_attr(attr, u"%u MHz", code);
-		else
-			printf(u"%u MHz\n", code);
-	}
+		print_cb(attr, u"%u MHz", code);
 	else
-	{
-		if (attr)
-			pr_attr(attr, u"Unknown");
-		else
-			printf(u"Unknown\n");
-	}
+		print_cb(attr, u"Unknown");
 }
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_4
 /* code is assumed to be a 3-bit value */
 static const char *dmi_processor_status(u8 code)
 {
-	static const char *status[] = {
+	static const char * const status[] = {
 		u"Unknown", /* 0x00 */
 		u"Enabled",
 		u"Disabled By User",
@@ -1295,7 +1332,7 @@ static const char *dmi_processor_status(u8 code)
 static const char *dmi_processor_upgrade(u8 code)
 {
 	/* 7.5.5 */
-	static const char *upgrade[] = {
+	static const char * const upgrade[] = {
 		u"Other", /* 0x01 */
 		u"Unknown",
 		u"Daughter Board",
@@ -1360,9 +1397,7 @@ static const char *dmi_processor_upgrade(u8 code)
 		u"Socket LGA1200" /* 0x3E */
 	};
 
-	if (code >= 0x01 && code <= 0x3E)
-		return upgrade[code - 0x01];
-	return out_of_spec;
+	return DMI_ENUM(upgrade, 0x01, code);
 }
 
 static void dmi_processor_cache(const char *attr, u16 code, const char *level,
@@ -1382,7 +1417,7 @@ static void dmi_processor_cache(const char *attr, u16 code, const char *level,
 static void dmi_processor_characteristics(const char *attr, u16 code)
 {
 	/* 7.5.9 */
-	static const char *characteristics[] = {
+	static const char * const characteristics[] = {
 		u"64-bit capable", /* 2 */
 		u"Multi-Core",
 		u"Hardware Thread",
@@ -1406,7 +1441,9 @@ static void dmi_processor_characteristics(const char *attr, u16 code)
 		pr_list_end();
 	}
 }
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_5
 /*
  * 7.6 Memory Controller Information (Type 5)
  */
@@ -1414,7 +1451,7 @@ static void dmi_processor_characteristics(const char *attr, u16 code)
 static const char *dmi_memory_controller_ed_method(u8 code)
 {
 	/* 7.6.1 */
-	static const char *method[] = {
+	static const char * const method[] = {
 		u"Other", /* 0x01 */
 		u"Unknown",
 		u"None",
@@ -1425,15 +1462,13 @@ static const char *dmi_memory_controller_ed_method(u8 code)
 		u"CRC" /* 0x08 */
 	};
 
-	if (code >= 0x01 && code <= 0x08)
-		return method[code - 0x01];
-	return out_of_spec;
+	return DMI_ENUM(method, 0x01, code);
 }
 
 static void dmi_memory_controller_ec_capabilities(const char *attr, u8 code)
 {
 	/* 7.6.2 */
-	static const char *capabilities[] = {
+	static const char * const capabilities[] = {
 		u"Other", /* 0 */
 		u"Unknown",
 		u"None",
@@ -1459,7 +1494,7 @@ static void dmi_memory_controller_ec_capabilities(const char *attr, u8 code)
 static const char *dmi_memory_controller_interleave(u8 code)
 {
 	/* 7.6.3 */
-	static const char *interleave[] = {
+	static const char * const interleave[] = {
 		u"Other", /* 0x01 */
 		u"Unknown",
 		u"One-way Interleave",
@@ -1469,9 +1504,7 @@ static const char *dmi_memory_controller_interleave(u8 code)
 		u"Sixteen-way Interleave" /* 0x07 */
 	};
 
-	if (code >= 0x01 && code <= 0x07)
-		return interleave[code - 0x01];
-	return out_of_spec;
+	return DMI_ENUM(interleave, 0x01, code);
 }
 
 static void dmi_memory_controller_speeds(const char *attr, u16 code)
@@ -1508,15 +1541,17 @@ static void dmi_memory_controller_slots(u8 count, const u8 *p)
 		pr_list_item(u"0x%04X", WORD(p + sizeof(u16) * i));
 	pr_list_end();
 }
+#endif
 
 /*
  * 7.7 Memory Module Information (Type 6)
  */
 
-static void dmi_memory_module_types(const char *attr, u16 code, int flat)
+static MAYBE_UNUSED void dmi_memory_module_types(const char *attr, u16 code,
+						    int flat)
 {
 	/* 7.7.1 */
-	static const char *types[] = {
+	static const char * const types[] = {
 		u"Other", /* 0 */
 		u"Unknown",
 		u"Standard",
@@ -1562,6 +1597,7 @@ static void dmi_memory_module_types(const char *attr, u16 code, int flat)
 	}
 }
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_6
 static void dmi_memory_module_connections(u8 code)
 {
 	if (code == 0xFF)
@@ -1573,8 +1609,9 @@ static void dmi_memory_module_connections(u8 code)
 	else
 		pr_attr(u"Bank Connections", u"%u %u", code >> 4, code & 0x0F);
 }
+#endif
 
-static void dmi_memory_module_speed(const char *attr, u8 code)
+static MAYBE_UNUSED void dmi_memory_module_speed(const char *attr, u8 code)
 {
 	if (code == 0)
 		pr_attr(attr, u"Unknown");
@@ -1582,6 +1619,7 @@ static void dmi_memory_module_speed(const char *attr, u8 code)
 		pr_attr(attr, u"%u ns", code);
 }
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_6
 static void dmi_memory_module_size(const char *attr, u8 code)
 {
 	const char *connection;
@@ -1611,7 +1649,7 @@ static void dmi_memory_module_size(const char *attr, u8 code)
 
 static void dmi_memory_module_error(u8 code)
 {
-	static const char *status[] = {
+	static const char * const status[] = {
 		u"OK", /* 0x00 */
 		u"Uncorrectable Errors",
 		u"Correctable Errors",
@@ -1623,14 +1661,16 @@ static void dmi_memory_module_error(u8 code)
 	else
 		pr_attr(u"Error Status", u"%s", status[code & 0x03]);
 }
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_7
 /*
  * 7.8 Cache Information (Type 7)
  */
 
 static const char *dmi_cache_mode(u8 code)
 {
-	static const char *mode[] = {
+	static const char * const mode[] = {
 		u"Write Through", /* 0x00 */
 		u"Write Back",
 		u"Varies With Memory Address",
@@ -1643,7 +1683,7 @@ static const char *dmi_cache_mode(u8 code)
 /* code is assumed to be a 2-bit value */
 static const char *dmi_cache_location(u8 code)
 {
-	static const char *location[4] = {
+	static const char * const location[4] = {
 		u"Internal", /* 0x00 */
 		u"External",
 		out_of_spec, /* 0x02 */
@@ -1682,7 +1722,7 @@ static void dmi_cache_size(const char *attr, u16 code)
 static void dmi_cache_types(const char *attr, u16 code, int flat)
 {
 	/* 7.8.2 */
-	static const char *types[] = {
+	static const char * const types[] = {
 		u"Other", /* 0 */
 		u"Unknown",
 		u"Non-burst",
@@ -1727,7 +1767,7 @@ static void dmi_cache_types(const char *attr, u16 code, int flat)
 static const char *dmi_cache_ec_type(u8 code)
 {
 	/* 7.8.3 */
-	static const char *type[] = {
+	static const char * const type[] = {
 		u"Other", /* 0x01 */
 		u"Unknown",
 		u"None",
@@ -1736,15 +1776,13 @@ static const char *dmi_cache_ec_type(u8 code)
 		u"Multi-bit ECC" /* 0x06 */
 	};
 
-	if (code >= 0x01 && code <= 0x06)
-		return type[code - 0x01];
-	return out_of_spec;
+	return DMI_ENUM(type, 0x01, code);
 }
 
 static const char *dmi_cache_type(u8 code)
 {
 	/* 7.8.4 */
-	static const char *type[] = {
+	static const char * const type[] = {
 		u"Other", /* 0x01 */
 		u"Unknown",
 		u"Instruction",
@@ -1752,15 +1790,13 @@ static const char *dmi_cache_type(u8 code)
 		u"Unified" /* 0x05 */
 	};
 
-	if (code >= 0x01 && code <= 0x05)
-		return type[code - 0x01];
-	return out_of_spec;
+	return DMI_ENUM(type, 0x01, code);
 }
 
 static const char *dmi_cache_associativity(u8 code)
 {
 	/* 7.8.5 */
-	static const char *type[] = {
+	static const char * const type[] = {
 		u"Other", /* 0x01 */
 		u"Unknown",
 		u"Direct Mapped",
@@ -1777,11 +1813,11 @@ static const char *dmi_cache_associativity(u8 code)
 		u"20-way Set-associative" /* 0x0E */
 	};
 
-	if (code >= 0x01 && code <= 0x0E)
-		return type[code - 0x01];
-	return out_of_spec;
+	return DMI_ENUM(type, 0x01, code);
 }
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_8
 /*
  * 7.9 Port Connector Information (Type 8)
  */
@@ -1789,7 +1825,7 @@ static const char *dmi_cache_associativity(u8 code)
 static const char *dmi_port_connector_type(u8 code)
 {
 	/* 7.9.2 */
-	static const char *type[] = {
+	static const char * const type[] = {
 		u"None", /* 0x00 */
 		u"Centronics",
 		u"Mini Centronics",
@@ -1825,29 +1861,22 @@ static const char *dmi_port_connector_type(u8 code)
 		u"BNC",
 		u"IEEE 1394",
 		u"SAS/SATA Plug Receptacle",
-		u"USB Type-C Receptacle" /* 0x23 */
-	};
-	static const char *type_0xA0[] = {
-		u"PC-98", /* 0xA0 */
+		u"USB Type-C Receptacle", /* 0x23 */
+		[0xA0] = u"PC-98", /* 0xA0 */
 		u"PC-98 Hireso",
 		u"PC-H98",
 		u"PC-98 Note",
-		u"PC-98 Full" /* 0xA4 */
+		u"PC-98 Full", /* 0xA4 */
+		[0xFF] = u"Other"
 	};
 
-	if (code <= 0x23)
-		return type[code];
-	if (code >= 0xA0 && code <= 0xA4)
-		return type_0xA0[code - 0xA0];
-	if (code == 0xFF)
-		return u"Other";
-	return out_of_spec;
+	return DMI_ENUM(type, 0x00, code);
 }
 
 static const char *dmi_port_type(u8 code)
 {
 	/* 7.9.3 */
-	static const char *type[] = {
+	static const char * const type[] = {
 		u"None", /* 0x00 */
 		u"Parallel Port XT/AT Compatible",
 		u"Parallel Port PS/2",
@@ -1881,22 +1910,17 @@ static const char *dmi_port_type(u8 code)
 		u"Modem Port",
 		u"Network Port",
 		u"SATA",
-		u"SAS" /* 0x21 */
-	};
-	static const char *type_0xA0[] = {
-		u"8251 Compatible", /* 0xA0 */
-		u"8251 FIFO Compatible" /* 0xA1 */
+		u"SAS", /* 0x21 */
+		[0xA0] = u"8251 Compatible", /* 0xA0 */
+		u"8251 FIFO Compatible", /* 0xA1 */
+		[0xFF] = u"Other"
 	};
 
-	if (code <= 0x21)
-		return type[code];
-	if (code >= 0xA0 && code <= 0xA1)
-		return type_0xA0[code - 0xA0];
-	if (code == 0xFF)
-		return u"Other";
-	return out_of_spec;
+	return DMI_ENUM(type, 0x00, code);
 }
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_9
 /*
  * 7.10 System Slots (Type 9)
  */
@@ -1904,7 +1928,7 @@ static const char *dmi_port_type(u8 code)
 static const char *dmi_slot_type(u8 code)
 {
 	/* 7.10.1 */
-	static const char *type[] = {
+	static const char * const type[] = {
 		u"Other", /* 0x01 */
 		u"Unknown",
 		u"ISA",
@@ -1944,13 +1968,9 @@ static const char *dmi_slot_type(u8 code)
 		u"PCI Express 5 SFF-8639 (U.2)",
 		u"OCP NIC 3.0 Small Form Factor (SFF)",
 		u"OCP NIC 3.0 Large Form Factor (LFF)",
-		u"OCP NIC Prior to 3.0" /* 0x28 */
-	};
-	static const char *type_0x30[] = {
-		u"CXL FLexbus 1.0" /* 0x30 */
-	};
-	static const char *type_0xA0[] = {
-		u"PC-98/C20", /* 0xA0 */
+		u"OCP NIC Prior to 3.0", /* 0x28 */
+		[0x30 - 0x01] = u"CXL FLexbus 1.0", /* 0x30 */
+		[0xA0 - 0x01] = u"PC-98/C20", /* 0xA0 */
 		u"PC-98/C24",
 		u"PC-98/E",
 		u"PC-98/Local Bus",
@@ -1995,19 +2015,13 @@ static const char *dmi_slot_type(u8 code)
 	 * function dmi_slot_id below needs updating too.
 	 */
 
-	if (code >= 0x01 && code <= 0x28)
-		return type[code - 0x01];
-	if (code == 0x30)
-		return type_0x30[code - 0x30];
-	if (code >= 0xA0 && code <= 0xC6)
-		return type_0xA0[code - 0xA0];
-	return out_of_spec;
+	return DMI_ENUM(type, 0x01, code);
 }
 
 static const char *dmi_slot_bus_width(u8 code)
 {
 	/* 7.10.2 */
-	static const char *width[] = {
+	static const char * const width[] = {
 		u"", /* 0x01, u"Other" */
 		u"", /* u"Unknown" */
 		u"8-bit ",
@@ -2024,15 +2038,13 @@ static const char *dmi_slot_bus_width(u8 code)
 		u"x32 " /* 0x0E */
 	};
 
-	if (code >= 0x01 && code <= 0x0E)
-		return width[code - 0x01];
-	return out_of_spec;
+	return DMI_ENUM(width, 0x01, code);
 }
 
 static const char *dmi_slot_current_usage(u8 code)
 {
 	/* 7.10.3 */
-	static const char *usage[] = {
+	static const char * const usage[] = {
 		u"Other", /* 0x01 */
 		u"Unknown",
 		u"Available",
@@ -2040,15 +2052,13 @@ static const char *dmi_slot_current_usage(u8 code)
 		u"Unavailable" /* 0x05 */
 	};
 
-	if (code >= 0x01 && code <= 0x05)
-		return usage[code - 0x01];
-	return out_of_spec;
+	return DMI_ENUM(usage, 0x01, code);
 }
 
 static const char *dmi_slot_length(u8 code)
 {
 	/* 7.10.4 */
-	static const char *length[] = {
+	static const char * const length[] = {
 		u"Other", /* 0x01 */
 		u"Unknown",
 		u"Short",
@@ -2057,9 +2067,7 @@ static const char *dmi_slot_length(u8 code)
 		u"3.5\" drive form factor" /* 0x06 */
 	};
 
-	if (code >= 0x01 && code <= 0x06)
-		return length[code - 0x01];
-	return out_of_spec;
+	return DMI_ENUM(length, 0x01, code);
 }
 
 static void dmi_slot_id(u8 code1, u8 code2, u8 type)
@@ -2120,7 +2128,7 @@ static void dmi_slot_id(u8 code1, u8 code2, u8 type)
 static void dmi_slot_characteristics(const char *attr, u8 code1, u8 code2)
 {
 	/* 7.10.6 */
-	static const char *characteristics1[] = {
+	static const char * const characteristics1[] = {
 		u"5.0 V is provided", /* 1 */
 		u"3.3 V is provided",
 		u"Opening is shared",
@@ -2130,7 +2138,7 @@ static void dmi_slot_characteristics(const char *attr, u8 code1, u8 code2)
 		u"Modem ring resume is supported" /* 7 */
 	};
 	/* 7.10.7 */
-	static const char *characteristics2[] = {
+	static const char * const characteristics2[] = {
 		u"PME signal is supported", /* 0 */
 		u"Hot-plug devices are supported",
 		u"SMBus signal is supported",
@@ -2158,8 +2166,10 @@ static void dmi_slot_characteristics(const char *attr, u8 code1, u8 code2)
 		pr_list_end();
 	}
 }
+#endif
 
-static void dmi_slot_segment_bus_func(u16 code1, u8 code2, u8 code3)
+static MAYBE_UNUSED void dmi_slot_segment_bus_func(u16 code1, u8 code2,
+						      u8 code3)
 {
 	/* 7.10.8 */
 	if (!(code1 == 0xFFFF && code2 == 0xFF && code3 == 0xFF))
@@ -2167,6 +2177,7 @@ static void dmi_slot_segment_bus_func(u16 code1, u8 code2, u8 code3)
 			code1, code2, code3 >> 3, code3 & 0x7);
 }
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_9
 static void dmi_slot_peers(u8 n, const u8 *data)
 {
 	char attr[16];
@@ -2180,15 +2191,16 @@ static void dmi_slot_peers(u8 n, const u8 *data)
 			data[4]);
 	}
 }
+#endif
 
 /*
  * 7.11 On Board Devices Information (Type 10)
  */
 
-static const char *dmi_on_board_devices_type(u8 code)
+static MAYBE_UNUSED const char *dmi_on_board_devices_type(u8 code)
 {
 	/* 7.11.1 and 7.42.2 */
-	static const char *type[] = {
+	static const char * const type[] = {
 		u"Other", /* 0x01 */
 		u"Unknown",
 		u"Video",
@@ -2201,11 +2213,10 @@ static const char *dmi_on_board_devices_type(u8 code)
 		u"SAS Controller" /* 0x0A */
 	};
 
-	if (code >= 0x01 && code <= 0x0A)
-		return type[code - 0x01];
-	return out_of_spec;
+	return DMI_ENUM(type, 0x01, code);
 }
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_10
 static void dmi_on_board_devices(const struct dmi_header *h)
 {
 	u8 *p = h->data + 4;
@@ -2226,7 +2237,9 @@ static void dmi_on_board_devices(const struct dmi_header *h)
 		pr_attr(u"Description", u"%s", dmi_string(h, p[2 * i + 1]));
 	}
 }
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_11
 /*
  * 7.12 OEM Strings (Type 11)
  */
@@ -2244,7 +2257,9 @@ static void dmi_oem_strings(const struct dmi_header *h)
 		pr_attr(attr, u"%s",dmi_string(h, i));
 	}
 }
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_12
 /*
  * 7.13 System Configuration Options (Type 12)
  */
@@ -2262,7 +2277,9 @@ static void dmi_system_configuration_options(const struct dmi_header *h)
 		pr_attr(attr, u"%s",dmi_string(h, i));
 	}
 }
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_13
 /*
  * 7.14 BIOS Language Information (Type 13)
  */
@@ -2284,7 +2301,9 @@ static const char *dmi_bios_language_format(u8 code)
 	else
 		return u"Long";
 }
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_14
 /*
  * 7.15 Group Associations (Type 14)
  */
@@ -2300,14 +2319,16 @@ static void dmi_group_associations_items(u8 count, const u8 *p)
 			dmi_smbios_structure_type(p[3 * i]));
 	}
 }
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_15
 /*
  * 7.16 System Event Log (Type 15)
  */
 
 static const char *dmi_event_log_method(u8 code)
 {
-	static const char *method[] = {
+	static const char * const method[] = {
 		u"Indexed I/O, one 8-bit index port, one 8-bit data port", /* 0x00 */
 		u"Indexed I/O, two 8-bit index ports, one 8-bit data port",
 		u"Indexed I/O, one 16-bit index port, one 8-bit data port",
@@ -2324,11 +2345,11 @@ static const char *dmi_event_log_method(u8 code)
 
 static void dmi_event_log_status(u8 code)
 {
-	static const char *valid[] = {
+	static const char * const valid[] = {
 		u"Invalid", /* 0 */
 		u"Valid" /* 1 */
 	};
-	static const char *full[] = {
+	static const char * const full[] = {
 		u"Not Full", /* 0 */
 		u"Full" /* 1 */
 	};
@@ -2361,7 +2382,7 @@ static void dmi_event_log_address(u8 method, const u8 *p)
 
 static const char *dmi_event_log_header_type(u8 code)
 {
-	static const char *type[] = {
+	static const char * const type[] = {
 		u"No Header", /* 0x00 */
 		u"Type 1" /* 0x01 */
 	};
@@ -2376,7 +2397,7 @@ static const char *dmi_event_log_header_type(u8 code)
 static const char *dmi_event_log_descriptor_type(u8 code)
 {
 	/* 7.16.6.1 */
-	static const char *type[] = {
+	static const char * const type[] = {
 		NULL, /* 0x00 */
 		u"Single-bit ECC memory error",
 		u"Multi-bit ECC memory error",
@@ -2415,7 +2436,7 @@ static const char *dmi_event_log_descriptor_type(u8 code)
 static const char *dmi_event_log_descriptor_format(u8 code)
 {
 	/* 7.16.6.2 */
-	static const char *format[] = {
+	static const char * const format[] = {
 		u"None", /* 0x00 */
 		u"Handle",
 		u"Multiple-event",
@@ -2451,7 +2472,9 @@ static void dmi_event_log_descriptors(u8 count, u8 len, const u8 *p)
 		}
 	}
 }
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_16
 /*
  * 7.17 Physical Memory Array (Type 16)
  */
@@ -2459,7 +2482,7 @@ static void dmi_event_log_descriptors(u8 count, u8 len, const u8 *p)
 static const char *dmi_memory_array_location(u8 code)
 {
 	/* 7.17.1 */
-	static const char *location[] = {
+	static const char * const location[] = {
 		u"Other", /* 0x01 */
 		u"Unknown",
 		u"System Board Or Motherboard",
@@ -2469,27 +2492,21 @@ static const char *dmi_memory_array_location(u8 code)
 		u"MCA Add-on Card",
 		u"PCMCIA Add-on Card",
 		u"Proprietary Add-on Card",
-		u"NuBus" /* 0x0A */
-	};
-	static const char *location_0xA0[] = {
-		u"PC-98/C20 Add-on Card", /* 0xA0 */
+		u"NuBus", /* 0x0A */
+		[0xA0 - 0x01] = u"PC-98/C20 Add-on Card", /* 0xA0 */
 		u"PC-98/C24 Add-on Card",
 		u"PC-98/E Add-on Card",
 		u"PC-98/Local Bus Add-on Card",
 		u"CXL Flexbus 1.0" /* 0xA4 */
 	};
 
-	if (code >= 0x01 && code <= 0x0A)
-		return location[code - 0x01];
-	if (code >= 0xA0 && code <= 0xA4)
-		return location_0xA0[code - 0xA0];
-	return out_of_spec;
+	return DMI_ENUM(location, 0x01, code);
 }
 
 static const char *dmi_memory_array_use(u8 code)
 {
 	/* 7.17.2 */
-	static const char *use[] = {
+	static const char * const use[] = {
 		u"Other", /* 0x01 */
 		u"Unknown",
 		u"System Memory",
@@ -2499,15 +2516,13 @@ static const char *dmi_memory_array_use(u8 code)
 		u"Cache Memory" /* 0x07 */
 	};
 
-	if (code >= 0x01 && code <= 0x07)
-		return use[code - 0x01];
-	return out_of_spec;
+	return DMI_ENUM(use, 0x01, code);
 }
 
 static const char *dmi_memory_array_ec_type(u8 code)
 {
 	/* 7.17.3 */
-	static const char *type[] = {
+	static const char * const type[] = {
 		u"Other", /* 0x01 */
 		u"Unknown",
 		u"None",
@@ -2517,12 +2532,11 @@ static const char *dmi_memory_array_ec_type(u8 code)
 		u"CRC" /* 0x07 */
 	};
 
-	if (code >= 0x01 && code <= 0x07)
-		return type[code - 0x01];
-	return out_of_spec;
+	return DMI_ENUM(type, 0x01, code);
 }
+#endif
 
-static void dmi_memory_array_error_handle(u16 code)
+static MAYBE_UNUSED void dmi_memory_array_error_handle(u16 code)
 {
 	if (code == 0xFFFE)
 		pr_attr(u"Error Information Handle", u"Not Provided");
@@ -2532,6 +2546,7 @@ static void dmi_memory_array_error_handle(u16 code)
 		pr_attr(u"Error Information Handle", u"0x%04X", code);
 }
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_17
 /*
  * 7.18 Memory Device (Type 17)
  */
@@ -2590,7 +2605,7 @@ static void dmi_memory_voltage_value(const char *attr, u16 code)
 static const char *dmi_memory_device_form_factor(u8 code)
 {
 	/* 7.18.1 */
-	static const char *form_factor[] = {
+	static const char * const form_factor[] = {
 		u"Other", /* 0x01 */
 		u"Unknown",
 		u"SIMM",
@@ -2609,9 +2624,7 @@ static const char *dmi_memory_device_form_factor(u8 code)
 		u"Die" /* 0x10 */
 	};
 
-	if (code >= 0x01 && code <= 0x10)
-		return form_factor[code - 0x01];
-	return out_of_spec;
+	return DMI_ENUM(form_factor, 0x01, code);
 }
 
 static void dmi_memory_device_set(u8 code)
@@ -2627,7 +2640,7 @@ static void dmi_memory_device_set(u8 code)
 static const char *dmi_memory_device_type(u8 code)
 {
 	/* 7.18.2 */
-	static const char *type[] = {
+	static const char * const type[] = {
 		u"Other", /* 0x01 */
 		u"Unknown",
 		u"DRAM",
@@ -2665,15 +2678,13 @@ static const char *dmi_memory_device_type(u8 code)
 		u"LPDDR5" /* 0x23 */
 	};
 
-	if (code >= 0x01 && code <= 0x23)
-		return type[code - 0x01];
-	return out_of_spec;
+	return DMI_ENUM(type, 0x01, code);
 }
 
 static void dmi_memory_device_type_detail(u16 code)
 {
 	/* 7.18.3 */
-	static const char *detail[] = {
+	static const char * const detail[] = {
 		u"Other", /* 1 */
 		u"Unknown",
 		u"Fast-paged",
@@ -2692,6 +2703,9 @@ static void dmi_memory_device_type_detail(u16 code)
 	};
 	char list[172];		/* Update length if you touch the array above */
 
+	if (!pr_field_wanted(u"Type Detail"))
+		return;
+
 	if ((code & 0xFFFE) == 0)
 		pr_attr(u"Type Detail", u"None");
 	else
@@ -2802,15 +2816,16 @@ static void dmi_memory_size(const char *attr, u64 code)
 	else
 		dmi_print_memory_size(attr, code, 0);
 }
+#endif
 
 /*
  * 7.19 32-bit Memory Error Information (Type 18)
  */
 
-static const char *dmi_memory_error_type(u8 code)
+static MAYBE_UNUSED const char *dmi_memory_error_type(u8 code)
 {
 	/* 7.19.1 */
-	static const char *type[] = {
+	static const char * const type[] = {
 		u"Other", /* 0x01 */
 		u"Unknown",
 		u"OK",
@@ -2827,30 +2842,26 @@ static const char *dmi_memory_error_type(u8 code)
 		u"Uncorrectable Error" /* 0x0E */
 	};
 
-	if (code >= 0x01 && code <= 0x0E)
-		return type[code - 0x01];
-	return out_of_spec;
+	return DMI_ENUM(type, 0x01, code);
 }
 
-static const char *dmi_memory_error_granularity(u8 code)
+static MAYBE_UNUSED const char *dmi_memory_error_granularity(u8 code)
 {
 	/* 7.19.2 */
-	static const char *granularity[] = {
+	static const char * const granularity[] = {
 		u"Other", /* 0x01 */
 		u"Unknown",
 		u"Device Level",
 		u"Memory Partition Level" /* 0x04 */
 	};
 
-	if (code >= 0x01 && code <= 0x04)
-		return granularity[code - 0x01];
-	return out_of_spec;
+	return DMI_ENUM(granularity, 0x01, code);
 }
 
-static const char *dmi_memory_error_operation(u8 code)
+static MAYBE_UNUSED const char *dmi_memory_error_operation(u8 code)
 {
 	/* 7.19.3 */
-	static const char *operation[] = {
+	static const char * const operation[] = {
 		u"Other", /* 0x01 */
 		u"Unknown",
 		u"Read",
@@ -2858,12 +2869,10 @@ static const char *dmi_memory_error_operation(u8 code)
 		u"Partial Write" /* 0x05 */
 	};
 
-	if (code >= 0x01 && code <= 0x05)
-		return operation[code - 0x01];
-	return out_of_spec;
+	return DMI_ENUM(operation, 0x01, code);
 }
 
-static void dmi_memory_error_syndrome(u32 code)
+static MAYBE_UNUSED void dmi_memory_error_syndrome(u32 code)
 {
 	if (code == 0x00000000)
 		pr_attr(u"Vendor Syndrome", u"Unknown");
@@ -2871,7 +2880,8 @@ static void dmi_memory_error_syndrome(u32 code)
 		pr_attr(u"Vendor Syndrome", u"0x%08X", code);
 }
 
-static void dmi_32bit_memory_error_address(const char *attr, u32 code)
+static MAYBE_UNUSED void dmi_32bit_memory_error_address(const char *attr,
+						       u32 code)
 {
 	if (code == 0x80000000)
 		pr_attr(attr, u"Unknown");
@@ -2883,7 +2893,7 @@ static void dmi_32bit_memory_error_address(const char *attr, u32 code)
  * 7.20 Memory Array Mapped Address (Type 19)
  */
 
-static void dmi_mapped_address_size(u32 code)
+static MAYBE_UNUSED void dmi_mapped_address_size(u32 code)
 {
 	if (code == 0)
 		pr_attr(u"Range Size", u"Invalid");
@@ -2897,7 +2907,7 @@ static void dmi_mapped_address_size(u32 code)
 	}
 }
 
-static void dmi_mapped_address_extended_size(u64 start, u64 end)
+static MAYBE_UNUSED void dmi_mapped_address_extended_size(u64 start, u64 end)
 {
 	if (start.h == end.h && start.l == end.l)
 		pr_attr(u"Range Size", u"Invalid");
@@ -2905,6 +2915,7 @@ static void dmi_mapped_address_extended_size(u64 start, u64 end)
 		dmi_print_memory_size(u"Range Size", u64_range(start, end), 0);
 }
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_20
 /*
  * 7.21 Memory Device Mapped Address (Type 20)
  */
@@ -2940,7 +2951,9 @@ static void dmi_mapped_address_interleaved_data_depth(u8 code)
 			pr_attr(u"Interleaved Data Depth", u"%u", code);
 	}
 }
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_21
 /*
  * 7.22 Built-in Pointing Device (Type 21)
  */
@@ -2948,7 +2961,7 @@ static void dmi_mapped_address_interleaved_data_depth(u8 code)
 static const char *dmi_pointing_device_type(u8 code)
 {
 	/* 7.22.1 */
-	static const char *type[] = {
+	static const char * const type[] = {
 		u"Other", /* 0x01 */
 		u"Unknown",
 		u"Mouse",
@@ -2960,15 +2973,13 @@ static const char *dmi_pointing_device_type(u8 code)
 		u"Optical Sensor" /* 0x09 */
 	};
 
-	if (code >= 0x01 && code <= 0x09)
-		return type[code - 0x01];
-	return out_of_spec;
+	return DMI_ENUM(type, 0x01, code);
 }
 
 static const char *dmi_pointing_device_interface(u8 code)
 {
 	/* 7.22.2 */
-	static const char *interface[] = {
+	static const char * const interface[] = {
 		u"Other", /* 0x01 */
 		u"Unknown",
 		u"Serial",
@@ -2976,21 +2987,17 @@ static const char *dmi_pointing_device_interface(u8 code)
 		u"Infrared",
 		u"HIP-HIL",
 		u"Bus Mouse",
-		u"ADB (Apple Desktop Bus)" /* 0x08 */
-	};
-	static const char *interface_0xA0[] = {
-		u"Bus Mouse DB-9", /* 0xA0 */
+		u"ADB (Apple Desktop Bus)", /* 0x08 */
+		[0xA0 - 0x01] = u"Bus Mouse DB-9", /* 0xA0 */
 		u"Bus Mouse Micro DIN",
 		u"USB" /* 0xA2 */
 	};
 
-	if (code >= 0x01 && code <= 0x08)
-		return interface[code - 0x01];
-	if (code >= 0xA0 && code <= 0xA2)
-		return interface_0xA0[code - 0xA0];
-	return out_of_spec;
+	return DMI_ENUM(interface, 0x01, code);
 }
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_22
 /*
  * 7.23 Portable Battery (Type 22)
  */
@@ -2998,7 +3005,7 @@ static const char *dmi_pointing_device_interface(u8 code)
 static const char *dmi_battery_chemistry(u8 code)
 {
 	/* 7.23.1 */
-	static const char *chemistry[] = {
+	static const char * const chemistry[] = {
 		u"Other", /* 0x01 */
 		u"Unknown",
 		u"Lead Acid",
@@ -3009,9 +3016,7 @@ static const char *dmi_battery_chemistry(u8 code)
 		u"Lithium Polymer" /* 0x08 */
 	};
 
-	if (code >= 0x01 && code <= 0x08)
-		return chemistry[code - 0x01];
-	return out_of_spec;
+	return DMI_ENUM(chemistry, 0x01, code);
 }
 
 static void dmi_battery_capacity(u16 code, u8 multiplier)
@@ -3037,7 +3042,9 @@ static void dmi_battery_maximum_error(u8 code)
 	else
 		pr_attr(u"Maximum Error", u"%u%%", code);
 }
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_23
 /*
  * 7.24 System Reset (Type 23)
  */
@@ -3045,7 +3052,7 @@ static void dmi_battery_maximum_error(u8 code)
 /* code is assumed to be a 2-bit value */
 static const char *dmi_system_reset_boot_option(u8 code)
 {
-	static const char *option[] = {
+	static const char * const option[] = {
 		out_of_spec, /* 0x0 */
 		u"Operating System", /* 0x1 */
 		u"System Utilities",
@@ -3070,14 +3077,16 @@ static void dmi_system_reset_timer(const char *attr, u16 code)
 	else
 		pr_attr(attr, u"%u min", code);
 }
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_24
 /*
  * 7.25 Hardware Security (Type 24)
  */
 
 static const char *dmi_hardware_security_status(u8 code)
 {
-	static const char *status[] = {
+	static const char * const status[] = {
 		u"Disabled", /* 0x00 */
 		u"Enabled",
 		u"Not Implemented",
@@ -3086,7 +3095,9 @@ static const char *dmi_hardware_security_status(u8 code)
 
 	return status[code];
 }
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_25
 /*
  * 7.26 System Power Controls (Type 25)
  */
@@ -3120,15 +3131,16 @@ static void dmi_power_controls_power_on(const u8 *p)
 
 	pr_attr(u"Next Scheduled Power-on", time);
 }
+#endif
 
 /*
  * 7.27 Voltage Probe (Type 26)
  */
 
-static const char *dmi_voltage_probe_location(u8 code)
+static MAYBE_UNUSED const char *dmi_voltage_probe_location(u8 code)
 {
 	/* 7.27.1 */
-	static const char *location[] = {
+	static const char * const location[] = {
 		u"Other", /* 0x01 */
 		u"Unknown",
 		u"Processor",
@@ -3142,15 +3154,13 @@ static const char *dmi_voltage_probe_location(u8 code)
 		u"Add-in Card" /* 0x0B */
 	};
 
-	if (code >= 0x01 && code <= 0x0B)
-		return location[code - 0x01];
-	return out_of_spec;
+	return DMI_ENUM(location, 0x01, code);
 }
 
-static const char *dmi_probe_status(u8 code)
+static MAYBE_UNUSED const char *dmi_probe_status(u8 code)
 {
 	/* 7.27.1 */
-	static const char *status[] = {
+	static const char * const status[] = {
 		u"Other", /* 0x01 */
 		u"Unknown",
 		u"OK",
@@ -3159,11 +3169,10 @@ static const char *dmi_probe_status(u8 code)
 		u"Non-recoverable" /* 0x06 */
 	};
 
-	if (code >= 0x01 && code <= 0x06)
-		return status[code - 0x01];
-	return out_of_spec;
+	return DMI_ENUM(status, 0x01, code);
 }
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_26
 static void dmi_voltage_probe_value(const char *attr, u16 code)
 {
 	if (code == 0x8000)
@@ -3179,8 +3188,9 @@ static void dmi_voltage_probe_resolution(u16 code)
 	else
 		pr_attr(u"Resolution", u"%.1f mV", (float)code / 10);
 }
+#endif
 
-static void dmi_probe_accuracy(u16 code)
+static MAYBE_UNUSED void dmi_probe_accuracy(u16 code)
 {
 	if (code == 0x8000)
 		pr_attr(u"Accuracy", u"Unknown");
@@ -3188,6 +3198,7 @@ static void dmi_probe_accuracy(u16 code)
 		pr_attr(u"Accuracy", u"%.2f%%", (float)code / 100);
 }
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_27
 /*
  * 7.28 Cooling Device (Type 27)
  */
@@ -3195,7 +3206,7 @@ static void dmi_probe_accuracy(u16 code)
 static const char *dmi_cooling_device_type(u8 code)
 {
 	/* 7.28.1 */
-	static const char *type[] = {
+	static const char * const type[] = {
 		u"Other", /* 0x01 */
 		u"Unknown",
 		u"Fan",
@@ -3204,18 +3215,12 @@ static const char *dmi_cooling_device_type(u8 code)
 		u"Cabinet Fan",
 		u"Power Supply Fan",
 		u"Heat Pipe",
-		u"Integrated Refrigeration" /* 0x09 */
-	};
-	static const char *type_0x10[] = {
-		u"Active Cooling", /* 0x10 */
+		u"Integrated Refrigeration", /* 0x09 */
+		[0x10 - 0x01] = u"Active Cooling", /* 0x10 */
 		u"Passive Cooling" /* 0x11 */
 	};
 
-	if (code >= 0x01 && code <= 0x09)
-		return type[code - 0x01];
-	if (code >= 0x10 && code <= 0x11)
-		return type_0x10[code - 0x10];
-	return out_of_spec;
+	return DMI_ENUM(type, 0x01, code);
 }
 
 static void dmi_cooling_device_speed(u16 code)
@@ -3225,7 +3230,9 @@ static void dmi_cooling_device_speed(u16 code)
 	else
 		pr_attr(u"Nominal Speed", u"%u rpm", code);
 }
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_28
 /*
  * 7.29 Temperature Probe (Type 28)
  */
@@ -3233,7 +3240,7 @@ static void dmi_cooling_device_speed(u16 code)
 static const char *dmi_temperature_probe_location(u8 code)
 {
 	/* 7.29.1 */
-	static const char *location[] = {
+	static const char * const location[] = {
 		u"Other", /* 0x01 */
 		u"Unknown",
 		u"Processor",
@@ -3251,9 +3258,7 @@ static const char *dmi_temperature_probe_location(u8 code)
 		u"Drive Back Plane" /* 0x0F */
 	};
 
-	if (code >= 0x01 && code <= 0x0F)
-		return location[code - 0x01];
-	return out_of_spec;
+	return DMI_ENUM(location, 0x01, code);
 }
 
 static void dmi_temperature_probe_value(const char *attr, u16 code)
@@ -3271,7 +3276,9 @@ static void dmi_temperature_probe_resolution(u16 code)
 	else
 		pr_attr(u"Resolution", u"%.3f deg C", (float)code / 1000);
 }
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_29
 /*
  * 7.30 Electrical Current Probe (Type 29)
  */
@@ -3291,14 +3298,16 @@ static void dmi_current_probe_resolution(u16 code)
 	else
 		pr_attr(u"Resolution", u"%.1f mA", (float)code / 10);
 }
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_32
 /*
  * 7.33 System Boot Information (Type 32)
  */
 
 static const char *dmi_system_boot_status(u8 code)
 {
-	static const char *status[] = {
+	static const char * const status[] = {
 		u"No errors detected", /* 0 */
 		u"No bootable media",
 		u"Operating system failed to load",
@@ -3318,7 +3327,9 @@ static const char *dmi_system_boot_status(u8 code)
 		return u"Product-specific";
 	return out_of_spec;
 }
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_33
 /*
  * 7.34 64-bit Memory Error Information (Type 33)
  */
@@ -3330,6 +3341,7 @@ static void dmi_64bit_memory_error_address(const char *attr, u64 code)
 	else
 		pr_attr(attr, u"0x%08X%08X", code.h, code.l);
 }
+#endif
 
 /*
  * 7.35 Management Device (Type 34)
@@ -3341,7 +3353,8 @@ static void dmi_64bit_memory_error_address(const char *attr, u64 code)
  * first 5 characters of the device name to be trimmed. It's easy to
  * check and fix, so do it, but warn.
  */
-static void dmi_fixup_type_34(struct dmi_header *h, int display)
+static void dmi_fixup_type_34(struct dmi_context *ctx, struct dmi_header *h,
+			      int display)
 {
 	u8 *p = h->data;
 
@@ -3349,17 +3362,18 @@ static void dmi_fixup_type_34(struct dmi_header *h, int display)
 	if (h->length == 0x10
 	 && is_printable(p + 0x0B, 0x10 - 0x0B))
 	{
-		if (!(opt.flags & FLAG_QUIET) && display)
-			printf(u"Invalid entry length (%u). Fixed up to %u.\n",
+		if (!(ctx->opt.flags & FLAG_QUIET) && display)
+			pr_info(u"Invalid entry length (%u). Fixed up to %u.",
 				0x10, 0x0B);
 		h->length = 0x0B;
 	}
 }
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_34
 static const char *dmi_management_device_type(u8 code)
 {
 	/* 7.35.1 */
-	static const char *type[] = {
+	static const char * const type[] = {
 		u"Other", /* 0x01 */
 		u"Unknown",
 		u"LM75",
@@ -3375,15 +3389,13 @@ static const char *dmi_management_device_type(u8 code)
 		u"HT82H791" /* 0x0D */
 	};
 
-	if (code >= 0x01 && code <= 0x0D)
-		return type[code - 0x01];
-	return out_of_spec;
+	return DMI_ENUM(type, 0x01, code);
 }
 
 static const char *dmi_management_device_address_type(u8 code)
 {
 	/* 7.35.2 */
-	static const char *type[] = {
+	static const char * const type[] = {
 		u"Other", /* 0x01 */
 		u"Unknown",
 		u"I/O Port",
@@ -3391,11 +3403,11 @@ static const char *dmi_management_device_address_type(u8 code)
 		u"SMBus" /* 0x05 */
 	};
 
-	if (code >= 0x01 && code <= 0x05)
-		return type[code - 0x01];
-	return out_of_spec;
+	return DMI_ENUM(type, 0x01, code);
 }
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_37
 /*
  * 7.38 Memory Channel (Type 37)
  */
@@ -3403,19 +3415,18 @@ static const char *dmi_management_device_address_type(u8 code)
 static const char *dmi_memory_channel_type(u8 code)
 {
 	/* 7.38.1 */
-	static const char *type[] = {
+	static const char * const type[] = {
 		u"Other", /* 0x01 */
 		u"Unknown",
 		u"RamBus",
 		u"SyncLink" /* 0x04 */
 	};
 
-	if (code >= 0x01 && code <= 0x04)
-		return type[code - 0x01];
-	return out_of_spec;
+	return DMI_ENUM(type, 0x01, code);
 }
 
-static void dmi_memory_channel_devices(u8 count, const u8 *p)
+static void dmi_memory_channel_devices(struct dmi_context *ctx, u8 count,
+				       const u8 *p)
 {
 	char attr[18];
 	int i;
@@ -3424,14 +3435,16 @@ static void dmi_memory_channel_devices(u8 count, const u8 *p)
 	{
 		sprintf(attr, u"Device %hhu Load", (u8)i);
 		pr_attr(attr, u"%u", p[3 * i]);
-		if (!(opt.flags & FLAG_QUIET))
+		if (!(ctx->opt.flags & FLAG_QUIET))
 		{
 			sprintf(attr, u"Device %hhu Handle", (u8)i);
 			pr_attr(attr, u"0x%04X", WORD(p + 3 * i + 1));
 		}
 	}
 }
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_38
 /*
  * 7.39 IPMI Device Information (Type 38)
  */
@@ -3439,7 +3452,7 @@ static void dmi_memory_channel_devices(u8 count, const u8 *p)
 static const char *dmi_ipmi_interface_type(u8 code)
 {
 	/* 7.39.1 and IPMI 2.0, appendix C1, table C1-2 */
-	static const char *type[] = {
+	static const char * const type[] = {
 		u"Unknown", /* 0x00 */
 		u"KCS (Keyboard Control Style)",
 		u"SMIC (Server Management Interface Chip)",
@@ -3447,9 +3460,7 @@ static const char *dmi_ipmi_interface_type(u8 code)
 		u"SSIF (SMBus System Interface)" /* 0x04 */
 	};
 
-	if (code <= 0x04)
-		return type[code];
-	return out_of_spec;
+	return DMI_ENUM(type, 0x00, code);
 }
 
 static void dmi_ipmi_base_address(u8 type, const u8 *p, u8 lsb)
@@ -3471,7 +3482,7 @@ static void dmi_ipmi_base_address(u8 type, const u8 *p, u8 lsb)
 static const char *dmi_ipmi_register_spacing(u8 code)
 {
 	/* IPMI 2.0, appendix C1, table C1-1 */
-	static const char *spacing[] = {
+	static const char * const spacing[] = {
 		u"Successive Byte Boundaries", /* 0x00 */
 		u"32-bit Boundaries",
 		u"16-byte Boundaries", /* 0x02 */
@@ -3480,7 +3491,9 @@ static const char *dmi_ipmi_register_spacing(u8 code)
 
 	return spacing[code];
 }
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_39
 /*
  * 7.40 System Power Supply (Type 39)
  */
@@ -3496,7 +3509,7 @@ static void dmi_power_supply_power(u16 code)
 static const char *dmi_power_supply_type(u8 code)
 {
 	/* 7.40.1 */
-	static const char *type[] = {
+	static const char * const type[] = {
 		u"Other", /* 0x01 */
 		u"Unknown",
 		u"Linear",
@@ -3507,15 +3520,13 @@ static const char *dmi_power_supply_type(u8 code)
 		u"Regulator" /* 0x08 */
 	};
 
-	if (code >= 0x01 && code <= 0x08)
-		return type[code - 0x01];
-	return out_of_spec;
+	return DMI_ENUM(type, 0x01, code);
 }
 
 static const char *dmi_power_supply_status(u8 code)
 {
 	/* 7.40.1 */
-	static const char *status[] = {
+	static const char * const status[] = {
 		u"Other", /* 0x01 */
 		u"Unknown",
 		u"OK",
@@ -3523,15 +3534,13 @@ static const char *dmi_power_supply_status(u8 code)
 		u"Critical" /* 0x05 */
 	};
 
-	if (code >= 0x01 && code <= 0x05)
-		return status[code - 0x01];
-	return out_of_spec;
+	return DMI_ENUM(status, 0x01, code);
 }
 
 static const char *dmi_power_supply_range_switching(u8 code)
 {
 	/* 7.40.1 */
-	static const char *switching[] = {
+	static const char * const switching[] = {
 		u"Other", /* 0x01 */
 		u"Unknown",
 		u"Manual",
@@ -3540,11 +3549,11 @@ static const char *dmi_power_supply_range_switching(u8 code)
 		u"N/A" /* 0x06 */
 	};
 
-	if (code >= 0x01 && code <= 0x06)
-		return switching[code - 0x01];
-	return out_of_spec;
+	return DMI_ENUM(switching, 0x01, code);
 }
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_40
 /*
  * 7.41 Additional Information (Type 40)
  *
@@ -3596,7 +3605,9 @@ static void dmi_additional_info(const struct dmi_header *h)
 		offset += length;
 	}
 }
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_42
 /*
  * 7.43 Management Controller Host Interface (Type 42)
  */
@@ -3604,7 +3615,7 @@ static void dmi_additional_info(const struct dmi_header *h)
 static const char *dmi_management_controller_host_type(u8 code)
 {
 	/* DMTF DSP0239 (MCTP) version 1.1.0 */
-	static const char *type[] = {
+	static const char * const type[] = {
 		u"KCS: Keyboard Controller Style", /* 0x02 */
 		u"8250 UART Register Compatible",
 		u"16450 UART Register Compatible",
@@ -3950,7 +3961,7 @@ static void dmi_parse_controller_structure(const struct dmi_header *h)
 	total_read++;
 	if (total_read > h->length)
 	{
-		printf(u"Total read length %d exceeds total structure length %d (handle 0x%04hx)\n",
+		pr_info(u"Total read length %d exceeds total structure length %d (handle 0x%04hx)",
 			total_read, h->length, h->handle);
 		return;
 	}
@@ -3966,12 +3977,15 @@ static void dmi_parse_controller_structure(const struct dmi_header *h)
 			 * Need to ensure that this record doesn't overrun
 			 * the total length of the type 42 struct.  Note the +2
 			 * is added for the two leading bytes of a protocol
-			 * record representing the type and length bytes.
+			 * record representing the type and length bytes,
+			 * which must fit before rec[1] can be trusted.
 			 */
-			total_read += rec[1] + 2;
+			if (total_read + 2 <= h->length)
+				total_read += rec[1];
+			total_read += 2;
 			if (total_read > h->length)
 			{
-				printf(u"Total read length %d exceeds total structure length %d (handle 0x%04hx, record %d)\n",
+				pr_info(u"Total read length %d exceeds total structure length %d (handle 0x%04hx, record %d)",
 					total_read, h->length, h->handle, i + 1);
 				return;
 			}
@@ -3990,7 +4004,9 @@ static void dmi_parse_controller_structure(const struct dmi_header *h)
 		}
 	}
 }
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_43
 /*
  * 7.44 TPM Device (Type 43)
  */
@@ -4018,7 +4034,7 @@ static void dmi_tpm_vendor_id(const u8 *p)
 static void dmi_tpm_characteristics(u64 code)
 {
 	/* 7.1.1 */
-	static const char *characteristics[] = {
+	static const char * const characteristics[] = {
 		u"TPM Device characteristics not supported", /* 2 */
 		u"Family configurable via firmware update",
 		u"Family configurable via platform software support",
@@ -4039,20 +4055,23 @@ static void dmi_tpm_characteristics(u64 code)
 		if (code.l & (1 << i))
 			pr_list_item(u"%s", characteristics[i - 2]);
 }
+#endif
 
 /*
  * Main
  */
 
-static void dmi_decode(const struct dmi_header *h, u16 ver)
+static void dmi_decode(struct dmi_context *ctx, const struct dmi_header *h,
+		       MAYBE_UNUSED u16 ver)
 {
-	const u8 *data = h->data;
+	MAYBE_UNUSED const u8 *data = h->data;
 
 	/*
 	 * Note: DMI types 37 and 42 are untested
 	 */
 	switch (h->type)
 	{
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_0
 		case 0: /* 7.1 BIOS Information */
 			pr_handle_name(u"BIOS Information");
 			if (h->length < 0x12) break;
@@ -4089,7 +4108,9 @@ static void dmi_decode(const struct dmi_header *h, u16 ver)
 				pr_attr(u"Firmware Revision", u"%u.%u",
 					data[0x16], data[0x17]);
 			break;
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_1
 		case 1: /* 7.2 System Information */
 			pr_handle_name(u"System Information");
 			if (h->length < 0x08) break;
@@ -4111,7 +4132,9 @@ static void dmi_decode(const struct dmi_header *h, u16 ver)
 			pr_attr(u"Family", u"%s",
 				dmi_string(h, data[0x1A]));
 			break;
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_2
 		case 2: /* 7.3 Base Board Information */
 			pr_handle_name(u"Base Board Information");
 			if (h->length < 0x08) break;
@@ -4131,17 +4154,19 @@ static void dmi_decode(const struct dmi_header *h, u16 ver)
 			if (h->length < 0x0E) break;
 			pr_attr(u"Location In Chassis", u"%s",
 				dmi_string(h, data[0x0A]));
-			if (!(opt.flags & FLAG_QUIET))
+			if (!(ctx->opt.flags & FLAG_QUIET))
 				pr_attr(u"Chassis Handle", u"0x%04X",
 					WORD(data + 0x0B));
 			pr_attr(u"Type", u"%s",
 				dmi_base_board_type(data[0x0D]));
 			if (h->length < 0x0F) break;
 			if (h->length < 0x0F + data[0x0E] * sizeof(u16)) break;
-			if (!(opt.flags & FLAG_QUIET))
+			if (!(ctx->opt.flags & FLAG_QUIET))
 				dmi_base_board_handles(data[0x0E], data + 0x0F);
 			break;
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_3
 		case 3: /* 7.4 Chassis Information */
 			pr_handle_name(u"Chassis Information");
 			if (h->length < 0x09) break;
@@ -4179,7 +4204,9 @@ static void dmi_decode(const struct dmi_header *h, u16 ver)
 			pr_attr(u"SKU Number", u"%s",
 				dmi_string(h, data[0x15 + data[0x13] * data[0x14]]));
 			break;
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_4
 		case 4: /* 7.5 Processor Information */
 			pr_handle_name(u"Processor Information");
 			if (h->length < 0x1A) break;
@@ -4195,9 +4222,9 @@ static void dmi_decode(const struct dmi_header *h, u16 ver)
 			pr_attr(u"Version", u"%s",
 				dmi_string(h, data[0x10]));
 			dmi_processor_voltage(u"Voltage", data[0x11]);
-			dmi_processor_frequency(u"External Clock", data + 0x12);
-			dmi_processor_frequency(u"Max Speed", data + 0x14);
-			dmi_processor_frequency(u"Current Speed", data + 0x16);
+			dmi_processor_frequency(pr_attr, u"External Clock", data + 0x12);
+			dmi_processor_frequency(pr_attr, u"Max Speed", data + 0x14);
+			dmi_processor_frequency(pr_attr, u"Current Speed", data + 0x16);
 			if (data[0x18] & (1 << 6))
 				pr_attr(u"Status", u"Populated, %s",
 					dmi_processor_status(data[0x18] & 0x07));
@@ -4206,7 +4233,7 @@ static void dmi_decode(const struct dmi_header *h, u16 ver)
 			pr_attr(u"Upgrade", u"%s",
 				dmi_processor_upgrade(data[0x19]));
 			if (h->length < 0x20) break;
-			if (!(opt.flags & FLAG_QUIET))
+			if (!(ctx->opt.flags & FLAG_QUIET))
 			{
 				dmi_processor_cache(u"L1 Cache Handle",
 						    WORD(data + 0x1A), u"L1", ver);
@@ -4238,7 +4265,9 @@ static void dmi_decode(const struct dmi_header *h, u16 ver)
 			dmi_processor_characteristics(u"Characteristics",
 						      WORD(data + 0x26));
 			break;
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_5
 		case 5: /* 7.6 Memory Controller Information */
 			pr_handle_name(u"Memory Controller Information");
 			if (h->length < 0x0F) break;
@@ -4265,7 +4294,9 @@ static void dmi_decode(const struct dmi_header *h, u16 ver)
 			dmi_memory_controller_ec_capabilities(u"Enabled Error Correcting Capabilities",
 							      data[0x0F + data[0x0E] * sizeof(u16)]);
 			break;
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_6
 		case 6: /* 7.7 Memory Module Information */
 			pr_handle_name(u"Memory Module Information");
 			if (h->length < 0x0C) break;
@@ -4278,7 +4309,9 @@ static void dmi_decode(const struct dmi_header *h, u16 ver)
 			dmi_memory_module_size(u"Enabled Size", data[0x0A]);
 			dmi_memory_module_error(data[0x0B]);
 			break;
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_7
 		case 7: /* 7.8 Cache Information */
 			pr_handle_name(u"Cache Information");
 			if (h->length < 0x0F) break;
@@ -4311,7 +4344,9 @@ static void dmi_decode(const struct dmi_header *h, u16 ver)
 			pr_attr(u"Associativity", u"%s",
 				dmi_cache_associativity(data[0x12]));
 			break;
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_8
 		case 8: /* 7.9 Port Connector Information */
 			pr_handle_name(u"Port Connector Information");
 			if (h->length < 0x09) break;
@@ -4326,7 +4361,9 @@ static void dmi_decode(const struct dmi_header *h, u16 ver)
 			pr_attr(u"Port Type", u"%s",
 				dmi_port_type(data[0x08]));
 			break;
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_9
 		case 9: /* 7.10 System Slots */
 			pr_handle_name(u"System Slot Information");
 			if (h->length < 0x0C) break;
@@ -4352,23 +4389,31 @@ static void dmi_decode(const struct dmi_header *h, u16 ver)
 			if (h->length - 0x13 >= data[0x12] * 5)
 				dmi_slot_peers(data[0x12], data + 0x13);
 			break;
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_10
 		case 10: /* 7.11 On Board Devices Information */
 			dmi_on_board_devices(h);
 			break;
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_11
 		case 11: /* 7.12 OEM Strings */
 			pr_handle_name(u"OEM Strings");
 			if (h->length < 0x05) break;
 			dmi_oem_strings(h);
 			break;
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_12
 		case 12: /* 7.13 System Configuration Options */
 			pr_handle_name(u"System Configuration Options");
 			if (h->length < 0x05) break;
 			dmi_system_configuration_options(h);
 			break;
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_13
 		case 13: /* 7.14 BIOS Language Information */
 			pr_handle_name(u"BIOS Language Information");
 			if (h->length < 0x16) break;
@@ -4383,7 +4428,9 @@ static void dmi_decode(const struct dmi_header *h, u16 ver)
 			pr_attr(u"Currently Installed Language", u"%s",
 				dmi_string(h, data[0x15]));
 			break;
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_14
 		case 14: /* 7.15 Group Associations */
 			pr_handle_name(u"Group Associations");
 			if (h->length < 0x05) break;
@@ -4394,7 +4441,9 @@ static void dmi_decode(const struct dmi_header *h, u16 ver)
 			dmi_group_associations_items((h->length - 0x05) / 3, data + 0x05);
 			pr_list_end();
 			break;
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_15
 		case 15: /* 7.16 System Event Log */
 			pr_handle_name(u"System Event Log");
 			if (h->length < 0x14) break;
@@ -4422,7 +4471,9 @@ static void dmi_decode(const struct dmi_header *h, u16 ver)
 			if (h->length < 0x17 + data[0x15] * data[0x16]) break;
 			dmi_event_log_descriptors(data[0x15], data[0x16], data + 0x17);
 			break;
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_16
 		case 16: /* 7.17 Physical Memory Array */
 			pr_handle_name(u"Physical Memory Array");
 			if (h->length < 0x0F) break;
@@ -4449,16 +4500,18 @@ static void dmi_decode(const struct dmi_header *h, u16 ver)
 				dmi_print_memory_size(u"Maximum Capacity",
 						      capacity, 1);
 			}
-			if (!(opt.flags & FLAG_QUIET))
+			if (!(ctx->opt.flags & FLAG_QUIET))
 				dmi_memory_array_error_handle(WORD(data + 0x0B));
 			pr_attr(u"Number Of Devices", u"%u",
 				WORD(data + 0x0D));
 			break;
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_17
 		case 17: /* 7.18 Memory Device */
 			pr_handle_name(u"Memory Device");
 			if (h->length < 0x15) break;
-			if (!(opt.flags & FLAG_QUIET))
+			if (!(ctx->opt.flags & FLAG_QUIET))
 			{
 				pr_attr(u"Array Handle", u"0x%04X",
 					WORD(data + 0x04));
@@ -4535,7 +4588,9 @@ static void dmi_decode(const struct dmi_header *h, u16 ver)
 			if (h->length < 0x54) break;
 			dmi_memory_size(u"Logical Size", QWORD(data + 0x4C));
 			break;
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_18
 		case 18: /* 7.19 32-bit Memory Error Information */
 			pr_handle_name(u"32-bit Memory Error Information");
 			if (h->length < 0x17) break;
@@ -4553,7 +4608,9 @@ static void dmi_decode(const struct dmi_header *h, u16 ver)
 			dmi_32bit_memory_error_address(u"Resolution",
 						       DWORD(data + 0x13));
 			break;
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_19
 		case 19: /* 7.20 Memory Array Mapped Address */
 			pr_handle_name(u"Memory Array Mapped Address");
 			if (h->length < 0x0F) break;
@@ -4580,13 +4637,15 @@ static void dmi_decode(const struct dmi_header *h, u16 ver)
 					((DWORD(data + 0x08) & 0x3) << 10) + 0x3FF);
 				dmi_mapped_address_size(DWORD(data + 0x08) - DWORD(data + 0x04) + 1);
 			}
-			if (!(opt.flags & FLAG_QUIET))
+			if (!(ctx->opt.flags & FLAG_QUIET))
 				pr_attr(u"Physical Array Handle", u"0x%04X",
 					WORD(data + 0x0C));
 			pr_attr(u"Partition Width", u"%u",
 				data[0x0E]);
 			break;
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_20
 		case 20: /* 7.21 Memory Device Mapped Address */
 			pr_handle_name(u"Memory Device Mapped Address");
 			if (h->length < 0x13) break;
@@ -4613,7 +4672,7 @@ static void dmi_decode(const struct dmi_header *h, u16 ver)
 					((DWORD(data + 0x08) & 0x3) << 10) + 0x3FF);
 				dmi_mapped_address_size(DWORD(data + 0x08) - DWORD(data + 0x04) + 1);
 			}
-			if (!(opt.flags & FLAG_QUIET))
+			if (!(ctx->opt.flags & FLAG_QUIET))
 			{
 				pr_attr(u"Physical Device Handle", u"0x%04X",
 					WORD(data + 0x0C));
@@ -4624,7 +4683,9 @@ static void dmi_decode(const struct dmi_header *h, u16 ver)
 			dmi_mapped_address_interleave_position(data[0x11]);
 			dmi_mapped_address_interleaved_data_depth(data[0x12]);
 			break;
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_21
 		case 21: /* 7.22 Built-in Pointing Device */
 			pr_handle_name(u"Built-in Pointing Device");
 			if (h->length < 0x07) break;
@@ -4635,7 +4696,9 @@ static void dmi_decode(const struct dmi_header *h, u16 ver)
 			pr_attr(u"Buttons", u"%u",
 				data[0x06]);
 			break;
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_22
 		case 22: /* 7.23 Portable Battery */
 			pr_handle_name(u"Portable Battery");
 			if (h->length < 0x10) break;
@@ -4677,7 +4740,9 @@ static void dmi_decode(const struct dmi_header *h, u16 ver)
 			pr_attr(u"OEM-specific Information", u"0x%08X",
 				DWORD(data + 0x16));
 			break;
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_23
 		case 23: /* 7.24 System Reset */
 			pr_handle_name(u"System Reset");
 			if (h->length < 0x0D) break;
@@ -4696,7 +4761,9 @@ static void dmi_decode(const struct dmi_header *h, u16 ver)
 			dmi_system_reset_timer(u"Timer Interval", WORD(data + 0x09));
 			dmi_system_reset_timer(u"Timeout", WORD(data + 0x0B));
 			break;
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_24
 		case 24: /* 7.25 Hardware Security */
 			pr_handle_name(u"Hardware Security");
 			if (h->length < 0x05) break;
@@ -4709,13 +4776,17 @@ static void dmi_decode(const struct dmi_header *h, u16 ver)
 			pr_attr(u"Front Panel Reset Status", u"%s",
 				dmi_hardware_security_status(data[0x04] & 0x3));
 			break;
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_25
 		case 25: /* 7.26 System Power Controls */
 			pr_handle_name(u"System Power Controls");
 			if (h->length < 0x09) break;
 			dmi_power_controls_power_on(data + 0x04);
 			break;
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_26
 		case 26: /* 7.27 Voltage Probe */
 			pr_handle_name(u"Voltage Probe");
 			if (h->length < 0x14) break;
@@ -4735,11 +4806,13 @@ static void dmi_decode(const struct dmi_header *h, u16 ver)
 			if (h->length < 0x16) break;
 			dmi_voltage_probe_value(u"Nominal Value", WORD(data + 0x14));
 			break;
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_27
 		case 27: /* 7.28 Cooling Device */
 			pr_handle_name(u"Cooling Device");
 			if (h->length < 0x0C) break;
-			if (!(opt.flags & FLAG_QUIET) && WORD(data + 0x04) != 0xFFFF)
+			if (!(ctx->opt.flags & FLAG_QUIET) && WORD(data + 0x04) != 0xFFFF)
 				pr_attr(u"Temperature Probe Handle", u"0x%04X",
 					WORD(data + 0x04));
 			pr_attr(u"Type", u"%s",
@@ -4756,7 +4829,9 @@ static void dmi_decode(const struct dmi_header *h, u16 ver)
 			if (h->length < 0x0F) break;
 			pr_attr(u"Description", u"%s", dmi_string(h, data[0x0E]));
 			break;
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_28
 		case 28: /* 7.29 Temperature Probe */
 			pr_handle_name(u"Temperature Probe");
 			if (h->length < 0x14) break;
@@ -4780,7 +4855,9 @@ static void dmi_decode(const struct dmi_header *h, u16 ver)
 			dmi_temperature_probe_value(u"Nominal Value",
 						    WORD(data + 0x14));
 			break;
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_29
 		case 29: /* 7.30 Electrical Current Probe */
 			pr_handle_name(u"Electrical Current Probe");
 			if (h->length < 0x14) break;
@@ -4804,7 +4881,9 @@ static void dmi_decode(const struct dmi_header *h, u16 ver)
 			dmi_current_probe_value(u"Nominal Value",
 						WORD(data + 0x14));
 			break;
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_30
 		case 30: /* 7.31 Out-of-band Remote Access */
 			pr_handle_name(u"Out-of-band Remote Access");
 			if (h->length < 0x06) break;
@@ -4815,7 +4894,9 @@ static void dmi_decode(const struct dmi_header *h, u16 ver)
 			pr_attr(u"Outbound Connection", u"%s",
 				data[0x05] & (1 << 1) ? u"Enabled" : u"Disabled");
 			break;
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_31
 		case 31: /* 7.32 Boot Integrity Services Entry Point */
 			pr_handle_name(u"Boot Integrity Services Entry Point");
 			if (h->length < 0x1C) break;
@@ -4827,14 +4908,18 @@ static void dmi_decode(const struct dmi_header *h, u16 ver)
 			pr_attr(u"32-bit Entry Point Address", u"0x%08X",
 				DWORD(data + 0x0C));
 			break;
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_32
 		case 32: /* 7.33 System Boot Information */
 			pr_handle_name(u"System Boot Information");
 			if (h->length < 0x0B) break;
 			pr_attr(u"Status", u"%s",
 				dmi_system_boot_status(data[0x0A]));
 			break;
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_33
 		case 33: /* 7.34 64-bit Memory Error Information */
 			pr_handle_name(u"64-bit Memory Error Information");
 			if (h->length < 0x1F) break;
@@ -4852,7 +4937,9 @@ static void dmi_decode(const struct dmi_header *h, u16 ver)
 			dmi_32bit_memory_error_address(u"Resolution",
 						       DWORD(data + 0x1B));
 			break;
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_34
 		case 34: /* 7.35 Management Device */
 			pr_handle_name(u"Management Device");
 			if (h->length < 0x0B) break;
@@ -4865,13 +4952,15 @@ static void dmi_decode(const struct dmi_header *h, u16 ver)
 			pr_attr(u"Address Type", u"%s",
 				dmi_management_device_address_type(data[0x0A]));
 			break;
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_35
 		case 35: /* 7.36 Management Device Component */
 			pr_handle_name(u"Management Device Component");
 			if (h->length < 0x0B) break;
 			pr_attr(u"Description", u"%s",
 				dmi_string(h, data[0x04]));
-			if (!(opt.flags & FLAG_QUIET))
+			if (!(ctx->opt.flags & FLAG_QUIET))
 			{
 				pr_attr(u"Management Device Handle", u"0x%04X",
 					WORD(data + 0x05));
@@ -4882,7 +4971,9 @@ static void dmi_decode(const struct dmi_header *h, u16 ver)
 						WORD(data + 0x09));
 			}
 			break;
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_36
 		case 36: /* 7.37 Management Device Threshold Data */
 			pr_handle_name(u"Management Device Threshold Data");
 			if (h->length < 0x10) break;
@@ -4905,7 +4996,9 @@ static void dmi_decode(const struct dmi_header *h, u16 ver)
 				pr_attr(u"Upper Non-recoverable Threshold", u"%d",
 					(i16)WORD(data + 0x0E));
 			break;
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_37
 		case 37: /* 7.38 Memory Channel */
 			pr_handle_name(u"Memory Channel");
 			if (h->length < 0x07) break;
@@ -4916,9 +5009,11 @@ static void dmi_decode(const struct dmi_header *h, u16 ver)
 			pr_attr(u"Devices", u"%u",
 				data[0x06]);
 			if (h->length < 0x07 + 3 * data[0x06]) break;
-			dmi_memory_channel_devices(data[0x06], data + 0x07);
+			dmi_memory_channel_devices(ctx, data[0x06], data + 0x07);
 			break;
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_38
 		case 38: /* 7.39 IPMI Device Information */
 			/*
 			 * We use the word u"Version" instead of u"Revision", conforming to
@@ -4958,7 +5053,9 @@ static void dmi_decode(const struct dmi_header *h, u16 ver)
 					data[0x11]);
 			}
 			break;
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_39
 		case 39: /* 7.40 System Power Supply */
 			pr_handle_name(u"System Power Supply");
 			if (h->length < 0x10) break;
@@ -4994,7 +5091,7 @@ static void dmi_decode(const struct dmi_header *h, u16 ver)
 			pr_attr(u"Hot Replaceable", u"%s",
 				WORD(data + 0x0E) & (1 << 0) ? u"Yes" : u"No");
 			if (h->length < 0x16) break;
-			if (!(opt.flags & FLAG_QUIET))
+			if (!(ctx->opt.flags & FLAG_QUIET))
 			{
 				if (WORD(data + 0x10) != 0xFFFF)
 					pr_attr(u"Input Voltage Probe Handle", u"0x%04X",
@@ -5007,14 +5104,18 @@ static void dmi_decode(const struct dmi_header *h, u16 ver)
 						WORD(data + 0x14));
 			}
 			break;
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_40
 		case 40: /* 7.41 Additional Information */
 			if (h->length < 0x0B) break;
-			if (opt.flags & FLAG_QUIET)
+			if (ctx->opt.flags & FLAG_QUIET)
 				return;
 			dmi_additional_info(h);
 			break;
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_41
 		case 41: /* 7.42 Onboard Device Extended Information */
 			pr_handle_name(u"Onboard Device");
 			if (h->length < 0x0B) break;
@@ -5026,7 +5127,9 @@ static void dmi_decode(const struct dmi_header *h, u16 ver)
 			pr_attr(u"Type Instance", u"%u", data[0x06]);
 			dmi_slot_segment_bus_func(WORD(data + 0x07), data[0x09], data[0x0A]);
 			break;
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_42
 		case 42: /* 7.43 Management Controller Host Interface */
 			pr_handle_name(u"Management Controller Host Interface");
 			if (ver < 0x0302)
@@ -5051,7 +5154,9 @@ static void dmi_decode(const struct dmi_header *h, u16 ver)
 			else
 				dmi_parse_controller_structure(h);
 			break;
+#endif
 
+#if !defined CONFIG_TYPES || defined CONFIG_TYPE_43
 		case 43: /* 7.44 TPM Device */
 			pr_handle_name(u"TPM Device");
 			if (h->length < 0x1B) break;
@@ -5088,6 +5193,7 @@ static void dmi_decode(const struct dmi_header *h, u16 ver)
 				DWORD(data + 0x1B));
 			break;
 
+#endif
 		case 126: /* 7.44 Inactive */
 			pr_handle_name(u"Inactive");
 			break;
@@ -5097,727 +5203,3704 @@ static void dmi_decode(const struct dmi_header *h, u16 ver)
 			break;
 
 		default:
-			if (dmi_decode_oem(h))
+			if (dmi_decode_oem(ctx, h))
 				break;
-			if (opt.flags & FLAG_QUIET)
+			if (ctx->opt.flags & FLAG_QUIET)
 				return;
+#ifdef CONFIG_TYPES
+			/* Decoder left out of this build, see config.h */
+			if (h->type <= 43)
+			{
+				pr_handle_name(u"Undecoded Type");
+				dmi_dump(ctx, h);
+				break;
+			}
+#endif
 			pr_handle_name(u"%s Type",
 				h->type >= 128 ? u"OEM-specific" : u"Unknown");
-			dmi_dump(h);
+			dmi_dump(ctx, h);
 	}
 	pr_sep();
 }
 
-static void to_dmi_header(struct dmi_header *h, u8 *data)
+/*
+ * Boundaries of a structure, as found by the table walker. Offsets are
+ * relative to the start of the table.
+ */
+struct dmi_entry
+{
+	u32 offset;	/* Start of the structure */
+	u32 next;	/* End of the string area, start of the next structure */
+	u16 handle;
+	u8 type;
+	u8 length;
+};
+
+#define DMI_SCAN_OK		0
+#define DMI_SCAN_SHORT		1	/* Stopped at an entry shorter than 4 bytes */
+#define DMI_SCAN_TRUNCATED	2	/* Last entry goes beyond the table */
+#define DMI_SCAN_PARTIAL	3	/* Stopped once the query was answered */
+
+struct dmi_table_index
+{
+	struct dmi_entry *entry;
+	u32 count;
+	u32 size;
+	int status;
+
+	/*
+	 * Entries of type n are by_type[type_start[n]] to
+	 * by_type[type_start[n + 1] - 1], in table order.
+	 */
+	u32 type_start[257];
+	u32 *by_type;
+
+	/* Open addressing hash of handles, slots hold entry index + 1 */
+	u32 *by_handle;
+	u32 hash_mask;
+
+	int mapped;		/* Arrays belong to a snapshot file or cache */
+	struct arena *arena;	/* Arrays were allocated there, may be NULL */
+};
+
+static void to_dmi_header(struct dmi_header *h, u8 *data,
+			  struct dmi_strings *strings)
 {
 	h->type = data[0];
 	h->length = data[1];
 	h->handle = WORD(data + 2);
 	h->data = data;
+	h->strings = strings;
+	if (strings)
+		strings->count = -1;
 }
 
-static void dmi_table_string(const struct dmi_header *h, const u8 *data, u16 ver)
+static void dmi_table_string(const struct dmi_header *h, const u8 *data, u16 ver,
+			     const struct string_keyword *ks, const char *name)
 {
 	int key;
-	u8 offset = opt.string->offset;
+	u8 offset = ks->offset;
 
-	if (opt.string->type == 11) /* OEM strings */
+	if (ks->type == 11) /* OEM strings */
 	{
 		if (h->length < 5 || offset > data[4])
 		{
-			printf(u"No OEM string number %u\n", offset);
+			pr_value(name, u"No OEM string number %u", offset);
 			return;
 		}
 
 		if (offset)
-			printf(u"%s\n", dmi_string(h, offset));
+			pr_value(name, u"%s", dmi_string(h, offset));
 		else
-			printf(u"%u\n", data[4]);	/* count */
+			pr_value(name, u"%u", data[4]);	/* count */
 		return;
 	}
 
 	if (offset >= h->length)
 		return;
 
-	key = (opt.string->type << 8) | offset;
+	key = (ks->type << 8) | offset;
 	switch (key)
 	{
 		case 0x015: /* -s bios-revision */
 			if (data[key - 1] != 0xFF && data[key] != 0xFF)
-				printf(u"%u.%u\n", data[key - 1], data[key]);
+				pr_value(name, u"%u.%u", data[key - 1], data[key]);
 			break;
 		case 0x017: /* -s firmware-revision */
 			if (data[key - 1] != 0xFF && data[key] != 0xFF)
-				printf(u"%u.%u\n", data[key - 1], data[key]);
+				pr_value(name, u"%u.%u", data[key - 1], data[key]);
 			break;
 		case 0x108:
-			dmi_system_uuid(NULL, NULL, data + offset, ver);
+			dmi_system_uuid(pr_value, name, data + offset, ver);
 			break;
 		case 0x305:
-			printf(u"%s\n", dmi_chassis_type(data[offset]));
+			pr_value(name, u"%s", dmi_chassis_type(data[offset]));
 			break;
 		case 0x406:
-			printf(u"%s\n", dmi_processor_family(h, ver));
+			pr_value(name, u"%s", dmi_processor_family(h, ver));
 			break;
 		case 0x416:
-			dmi_processor_frequency(NULL, data + offset);
+			dmi_processor_frequency(pr_value, name, data + offset);
 			break;
 		default:
-			printf(u"%s\n", dmi_string(h, data[offset]));
+			pr_value(name, u"%s", dmi_string(h, data[offset]));
 	}
 }
 
-static void dmi_table_dump(const u8 *buf, u32 len)
-{
-	if (!(opt.flags & FLAG_QUIET))
-		pr_comment(u"Writing %d bytes to %s.", len, opt.dumpfile);
-	write_dump(32, len, buf, opt.dumpfile, 0);
-}
-
-static void dmi_table_decode(u8 *buf, u32 len, u16 num, u16 ver, u32 flags)
+/*
+ * Answer all --string and --oem-string queries from the indexed table.
+ * Queries are answered in command line order. When there is more than
+ * one, each value is prefixed with its keyword, so the output can be
+ * parsed reliably.
+ */
+static void dmi_table_strings(struct dmi_context *ctx,
+			      const struct dmi_table_index *t, u8 *buf,
+			      u32 len, u16 ver)
 {
-	u8 *data;
-	int i = 0;
+	struct dmi_strings strings;
+	unsigned int k;
+	u32 i;
 
-	/* First pass: Save the vendor so that so that we can decode OEM types */
-	data = buf;
-	while ((i < num || !num)
-	    && data + 4 <= buf + len) /* 4 is the length of an SMBIOS structure header */
+	for (k = 0; k < ctx->opt.string_count; k++)
 	{
-		u8 *next;
-		struct dmi_header h;
+		const struct string_keyword *ks = &ctx->opt.string[k];
+		const char *name = NULL;
+		char oem_name[24];
 
-		to_dmi_header(&h, data);
-
-		/*
-		 * If a short entry is found (less than 4 bytes), not only it
-		 * is invalid, but we cannot reliably locate the next entry.
-		 * Also stop at end-of-table marker if so instructed.
-		 */
-		if (h.length < 4 ||
-		    (h.type == 127 &&
-		     (opt.flags & (FLAG_QUIET | FLAG_STOP_AT_EOT))))
-			break;
-		i++;
+		if (ctx->opt.string_count > 1)
+		{
+			if (ks->keyword)
+				name = ks->keyword;
+			else
+			{
+				if (ks->offset)
+					sprintf(oem_name, u"oem-string-%u", ks->offset);
+				else
+					sprintf(oem_name, u"oem-string-count");
+				name = oem_name;
+			}
+		}
 
-		/* Look for the next handle */
-		next = data + h.length;
-		while ((unsigned long)(next - buf + 1) < len
-		    && (next[0] != 0 || next[1] != 0))
-			next++;
-		next += 2;
+		for (i = t->type_start[ks->type]; i < t->type_start[ks->type + 1]; i++)
+		{
+			const struct dmi_entry *e = &t->entry[t->by_type[i]];
+			struct dmi_header h;
 
-		/* Make sure the whole structure fits in the table */
-		if ((unsigned long)(next - buf) > len)
-			break;
+			if (e->next > len)
+				continue;
 
-		/* Assign vendor for vendor-specific decodes later */
-		if (h.type == 1 && h.length >= 6)
-		{
-			dmi_set_vendor(_dmi_string(&h, data[0x04], 0),
-				       _dmi_string(&h, data[0x05], 0));
-			break;
+			to_dmi_header(&h, buf + e->offset, &strings);
+			dmi_table_string(&h, h.data, ver, ks, name);
 		}
-
-		data = next;
 	}
 
-	/* Second pass: Actually decode the data */
-	i = 0;
-	data = buf;
-	while ((i < num || !num)
-	    && data + 4 <= buf + len) /* 4 is the length of an SMBIOS structure header */
-	{
-		u8 *next;
-		struct dmi_header h;
-		int display;
+	/* Keep the separator of a truncated table */
+	if (t->status == DMI_SCAN_TRUNCATED)
+		pr_sep();
+}
 
-		to_dmi_header(&h, data);
-		display = ((opt.type == NULL || opt.type[h.type])
-			&& (opt.handle == ~0U || opt.handle == h.handle)
-			&& !((opt.flags & FLAG_QUIET) && (h.type == 126 || h.type == 127))
-			&& !opt.string);
+static void dmi_table_dump(struct dmi_context *ctx, const u8 *buf, u32 len)
+{
+	if (!(ctx->opt.flags & FLAG_QUIET))
+		pr_comment(u"Writing %d bytes to %s.", len, ctx->opt.dumpfile);
+	write_dump(32, len, buf, ctx->opt.dumpfile, 0);
+}
 
-		/*
-		 * If a short entry is found (less than 4 bytes), not only it
-		 * is invalid, but we cannot reliably locate the next entry.
-		 * Better stop at this point, and let the user know his/her
-		 * table is broken.
-		 */
-		if (h.length < 4)
-		{
-			if (!(opt.flags & FLAG_QUIET))
-			{
-				printf(u"Invalid entry length (%u). DMI table "
-					u"is broken! Stop.\n\n",
-					(unsigned int)h.length);
-				opt.flags |= FLAG_QUIET;
-			}
+/*
+ * Look for the next handle, after the double NUL which ends the strings
+ * of the structure at off. Returns more than len if there is none. The
+ * search starts at from if that is past the formatted area, so a caller
+ * growing the buffer does not rescan what it already searched.
+ */
+static u32 dmi_entry_next(const u8 *buf, u32 off, u32 from, u32 len)
+{
+	u32 next = off + buf[off + 1];
+
+	if (from > next)
+		next = from;
+
+	while (next + 1 < len)
+	{
+		const u8 *p = memchr(buf + next, 0, len - 1 - next);
+
+		if (p == NULL)
+		{
+			next = len - 1;
 			break;
 		}
-		i++;
-
-		/* In quiet mode, stop decoding at end of table marker */
-		if ((opt.flags & FLAG_QUIET) && h.type == 127)
+		next = p - buf;
+		if (p[1] == 0)
 			break;
+		next++;
+	}
+	return next + 2;
+}
+
+/*
+ * Early exit: some queries are fully answered by the first structures of
+ * the table, so the walk can stop there. This is the case of --string and
+ * --type queries which only involve types SMBIOS defines as singular.
+ * --handle isn't one of them: handles should be unique, but duplicates
+ * are all displayed, so the whole table is walked.
+ */
+struct dmi_query
+{
+	int active;
+	u8 wanted[256];			/* Types not seen yet */
+	unsigned int pending;		/* Number of wanted types */
+};
+
+static int dmi_type_singular(u8 type)
+{
+	return type == 0 || type == 1;
+}
 
-		if (display
-		 && (!(opt.flags & FLAG_QUIET) || (opt.flags & FLAG_DUMP)))
-			pr_handle(&h);
+static void dmi_query_init(struct dmi_query *q, const struct dmi_context *ctx)
+{
+	unsigned int i;
 
-		/* Look for the next handle */
-		next = data + h.length;
-		while ((unsigned long)(next - buf + 1) < len
-		    && (next[0] != 0 || next[1] != 0))
-			next++;
-		next += 2;
+	memset(q, 0, sizeof(*q));
 
-		/* Make sure the whole structure fits in the table */
-		if ((unsigned long)(next - buf) > len)
+	/* The whole table is needed to tell what disappeared */
+	if (ctx->baseline != NULL)
+		return;
+
+	/* Duplicate handles are all displayed, see above */
+	if (ctx->opt.handle != ~0U)
+		return;
+
+	if (ctx->opt.string != NULL)
+	{
+		for (i = 0; i < ctx->opt.string_count; i++)
 		{
-			if (display && !(opt.flags & FLAG_QUIET))
-				pr_struct_err(u"<TRUNCATED>");
-			pr_sep();
-			data = next;
+			u8 type = ctx->opt.string[i].type;
+
+			if (!dmi_type_singular(type))
+				return;
+			q->pending += !q->wanted[type];
+			q->wanted[type] = 1;
+		}
+	}
+	else if (ctx->opt.type != NULL)
+	{
+		for (i = 0; i < 256; i++)
+		{
+			if (!ctx->opt.type[i])
+				continue;
+			if (!dmi_type_singular(i))
+				return;
+			q->wanted[i] = 1;
+			q->pending++;
+		}
+	}
+	else
+		return;
+
+	q->active = 1;
+}
+
+/* Returns 1 if the query is answered once this structure is seen */
+static int dmi_query_seen(struct dmi_query *q, u8 type)
+{
+	if (!q->active)
+		return 0;
+
+	if (q->wanted[type])
+	{
+		q->wanted[type] = 0;
+		q->pending--;
+	}
+	return q->pending == 0;
+}
+
+/*
+ * Walk the table once and record the boundaries of every structure, so
+ * that later passes don't have to look for the end of the string areas
+ * again. The walk stops at the first invalid or truncated entry, and at
+ * the end-of-table marker if stop_at_eot is set. It also stops as soon
+ * as query q, if not NULL, is answered, with status DMI_SCAN_PARTIAL.
+ * Returns 0 on success, -1 on memory allocation failure.
+ */
+static int dmi_table_scan(struct dmi_table_index *t, const u8 *buf, u32 len,
+			  u16 num, int stop_at_eot, struct dmi_query *q,
+			  struct arena *a)
+{
+	u32 off = 0;
+
+	t->count = 0;
+	t->status = DMI_SCAN_OK;
+	t->mapped = 0;
+	t->arena = a;
+	t->size = num ? num : len / 32 + 1;
+	t->entry = arena_alloc(a, t->size * sizeof(struct dmi_entry));
+	if (t->entry == NULL)
+	{
+		perror(u"malloc");
+		return -1;
+	}
+
+	while ((t->count < num || !num)
+	    && off + 4 <= len) /* 4 is the length of an SMBIOS structure header */
+	{
+		const u8 *data = buf + off;
+		struct dmi_entry *e;
+		u32 next;
+
+		/*
+		 * If a short entry is found (less than 4 bytes), not only it
+		 * is invalid, but we cannot reliably locate the next entry.
+		 */
+		if (data[1] < 4)
+		{
+			t->status = DMI_SCAN_SHORT;
 			break;
 		}
 
-		/* Fixup a common mistake */
-		if (h.type == 34)
-			dmi_fixup_type_34(&h, display);
+		next = dmi_entry_next(buf, off, off, len);
 
-		if (display)
+		if (t->count == t->size)
 		{
-			if (opt.flags & FLAG_DUMP)
+			struct dmi_entry *p;
+
+			p = arena_realloc(a, t->entry,
+					  t->size * sizeof(struct dmi_entry),
+					  2 * t->size * sizeof(struct dmi_entry));
+			if (p == NULL)
 			{
-				dmi_dump(&h);
-				pr_sep();
+				perror(u"realloc");
+				arena_free(a, t->entry);
+				t->entry = NULL;
+				return -1;
 			}
-			else
-				dmi_decode(&h, ver);
+			t->entry = p;
+			t->size *= 2;
+		}
+
+		e = &t->entry[t->count++];
+		e->offset = off;
+		e->next = next;
+		e->handle = WORD(data + 2);
+		e->type = data[0];
+		e->length = data[1];
+
+		/* Make sure the whole structure fits in the table */
+		if (next > len)
+		{
+			t->status = DMI_SCAN_TRUNCATED;
+			break;
 		}
-		else if (opt.string != NULL
-		      && opt.string->type == h.type)
-			dmi_table_string(&h, data, ver);
 
-		data = next;
+		off = next;
+
+		/* Stop at end-of-table marker if so instructed */
+		if (e->type == 127 && stop_at_eot)
+			break;
 
-		/* SMBIOS v3 requires stopping at this marker */
-		if (h.type == 127 && (flags & FLAG_STOP_AT_EOT))
+		if (q != NULL && dmi_query_seen(q, e->type))
+		{
+			t->status = DMI_SCAN_PARTIAL;
 			break;
+		}
 	}
 
-	/*
-	 * SMBIOS v3 64-bit entry points do not announce a structures count,
-	 * and only indicate a maximum size for the table.
-	 */
-	if (!(opt.flags & FLAG_QUIET))
+	return 0;
+}
+
+static u32 dmi_handle_hash(const struct dmi_table_index *t, u16 handle)
+{
+	return (handle * 0x9E37U) & t->hash_mask;
+}
+
+/*
+ * Build the by-type and by-handle lookup tables of a scanned table.
+ * Returns 0 on success, -1 on memory allocation failure.
+ */
+static int dmi_table_index_build(struct dmi_table_index *t)
+{
+	u32 fill[256];
+	u32 size, i;
+
+	t->by_type = arena_alloc(t->arena,
+				 (t->count ? t->count : 1) * sizeof(u32));
+	for (size = 16; size < 2 * t->count; size <<= 1)
+		;
+	t->by_handle = arena_calloc(t->arena, size, sizeof(u32));
+	if (t->by_type == NULL || t->by_handle == NULL)
+	{
+		perror(u"malloc");
+		arena_free(t->arena, t->by_handle);
+		arena_free(t->arena, t->by_type);
+		return -1;
+	}
+	t->hash_mask = size - 1;
+
+	/* Counting sort by type, preserves table order within each type */
+	memset(fill, 0, sizeof(fill));
+	for (i = 0; i < t->count; i++)
+		fill[t->entry[i].type]++;
+	t->type_start[0] = 0;
+	for (i = 0; i < 256; i++)
+	{
+		t->type_start[i + 1] = t->type_start[i] + fill[i];
+		fill[i] = t->type_start[i];
+	}
+	for (i = 0; i < t->count; i++)
+		t->by_type[fill[t->entry[i].type]++] = i;
+
+	/* Duplicate handles are kept, in table order along the probe chain */
+	for (i = 0; i < t->count; i++)
 	{
-		if (num && i != num)
-			printf(u"Wrong DMI structures count: %d announced, "
-				u"only %d decoded.\n", num, i);
-		if ((unsigned long)(data - buf) > len
-		 || (num && (unsigned long)(data - buf) < len))
-			printf(u"Wrong DMI structures length: %u bytes "
-				u"announced, structures occupy %lu bytes.\n",
-				len, (unsigned long)(data - buf));
+		u32 slot = dmi_handle_hash(t, t->entry[i].handle);
+
+		while (t->by_handle[slot])
+			slot = (slot + 1) & t->hash_mask;
+		t->by_handle[slot] = i + 1;
 	}
+
+	return 0;
 }
 
-static void dmi_table(off_t base, u32 len, u16 num, u32 ver, const char *devmem,
-		      u32 flags)
+static void dmi_table_index_free(struct dmi_table_index *t)
 {
-	u8 *buf;
+	if (t->mapped)
+		return;
+	arena_free(t->arena, t->by_handle);
+	arena_free(t->arena, t->by_type);
+	arena_free(t->arena, t->entry);
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/*
+ * Fill visit with the index of the entries which the current options
+ * select, in table order, and return how many there are. visit must be
+ * large enough to hold all entries.
+ */
+static u32 dmi_table_select(struct dmi_context *ctx,
+			    const struct dmi_table_index *t, u32 *visit)
+{
+	u32 n = 0, i, j;
 
-	if (ver > SUPPORTED_SMBIOS_VER && !(opt.flags & FLAG_QUIET))
+	if (ctx->opt.handle != ~0U)
 	{
-		pr_comment(u"SMBIOS implementations newer than version %u.%u.%u are not",
-			   SUPPORTED_SMBIOS_VER >> 16,
-			   (SUPPORTED_SMBIOS_VER >> 8) & 0xFF,
-			   SUPPORTED_SMBIOS_VER & 0xFF);
-		pr_comment(u"fully supported by this version of dmidecode.");
-	}
+		u32 slot = dmi_handle_hash(t, ctx->opt.handle);
 
-	if (!(opt.flags & FLAG_QUIET))
+		while (t->by_handle[slot])
+		{
+			if (t->entry[t->by_handle[slot] - 1].handle == ctx->opt.handle)
+				visit[n++] = t->by_handle[slot] - 1;
+			slot = (slot + 1) & t->hash_mask;
+		}
+	}
+	else if (ctx->opt.type != NULL)
 	{
-		if (opt.type == NULL)
+		for (i = 0; i < 256; i++)
 		{
-			if (num)
-				pr_info(u"%u structures occupying %u bytes.",
-					num, len);
-			if (!(opt.flags & FLAG_FROM_DUMP))
-				pr_info(u"Table at 0x%08llX.",
-					(unsigned long long)base);
+			if (!ctx->opt.type[i])
+				continue;
+			for (j = t->type_start[i]; j < t->type_start[i + 1]; j++)
+				visit[n++] = t->by_type[j];
 		}
-		pr_sep();
 	}
+	else
+	{
+		for (i = 0; i < t->count; i++)
+			visit[i] = i;
+		return t->count;
+	}
+	qsort(visit, n, sizeof(u32), cmp_u32);
+
+	/* The truncated entry, if any, is always reported */
+	if (t->status == DMI_SCAN_TRUNCATED
+	 && (n == 0 || visit[n - 1] != t->count - 1))
+		visit[n++] = t->count - 1;
+
+	return n;
+}
+
+/*
+ * Snapshot files, written by --snapshot and read back by --from-dump,
+ * hold the table along with the index built by dmi_table_scan() and
+ * dmi_table_index_build(), so that they can be decoded straight from
+ * a mapping of the file, without walking the table again. All fields
+ * are little-endian.
+ *
+ * Offset  Size  Field
+ * 0x00    8     Magic "_DMISNAP"
+ * 0x08    2     Format version (1)
+ * 0x0A    1     Source the table was read from (SNAP_SRC_*)
+ * 0x0B    1     Scan status (DMI_SCAN_*)
+ * 0x0C    2     Structure count, as announced by the entry point
+ * 0x0E    2     Flags (SNAP_FLAG_*)
+ * 0x10    4     SMBIOS version (major << 16 | minor << 8 | docrev)
+ * 0x14    4     Table length, as announced by the entry point
+ * 0x18    4     Table length, as stored
+ * 0x1C    4     Number of index entries
+ * 0x20    4     Number of handle hash slots (power of 2)
+ * 0x24    4     Reserved
+ * 0x28    8     Original table address
+ * 0x30    8     Entry point address (EFI and memory scan sources)
+ * 0x38    8     Reserved
+ * 0x40    32    Entry point, as written by --dump-bin
+ * 0x60          Table, padded to a multiple of 4 bytes, followed by
+ *               the entries (12 bytes each: offset, next, handle, type,
+ *               length), type_start (257 DWORDs), by_type (one DWORD
+ *               per entry) and by_handle (one DWORD per hash slot)
+ */
+#define SNAP_MAGIC		"_DMISNAP"
+#define SNAP_VERSION		1
+#define SNAP_EP_OFFSET		0x40
+#define SNAP_TABLE_OFFSET	0x60
+#define SNAP_ENTRY_SIZE		12
+
+#define SNAP_SRC_UNKNOWN	0
+#define SNAP_SRC_SYSFS		1
+#define SNAP_SRC_EFI		2
+#define SNAP_SRC_MEMORY		3
+#define SNAP_SRC_EFI_TABLE	4	/* Entry point given by the caller */
+
+#define SNAP_FLAG_STOP_AT_EOT	(1 << 0)
+
+struct dmi_snapshot
+{
+	u8 *ep;
+	u8 *table;
+	u32 table_len;
+	u8 *index;		/* Entries, followed by the lookup tables */
+	u32 count;
+	u32 hash_size;
+	int status;
+	int stop_at_eot;
+	u8 source;
+};
+
+static const char *dmi_snapshot_source(u8 code)
+{
+	static const char * const source[] = {
+		u"sysfs", /* 1 */
+		u"EFI",
+		u"memory scan",
+		u"EFI configuration table" /* 4 */
+	};
+
+	return DMI_ENUM(source, 1, code);
+}
+
+static u8 *put_word(u8 *p, u16 v)
+{
+	p[0] = v & 0xFF;
+	p[1] = v >> 8;
+	return p + 2;
+}
+
+static u8 *put_dword(u8 *p, u32 v)
+{
+	put_word(p, v & 0xFFFF);
+	put_word(p + 2, v >> 16);
+	return p + 4;
+}
+
+/*
+ * Check the header of a mapped snapshot file and locate its parts.
+ * Returns 0 on success, -1 if the file is not a valid snapshot.
+ */
+static int dmi_snapshot_open(struct dmi_snapshot *snap, u8 *data, size_t size)
+{
+	u32 padded;
+
+	if (size < SNAP_TABLE_OFFSET
+	 || memcmp(data, SNAP_MAGIC, 8) != 0
+	 || WORD(data + 0x08) != SNAP_VERSION)
+		return -1;
 
-	if ((flags & FLAG_NO_FILE_OFFSET) || (opt.flags & FLAG_FROM_DUMP))
+	snap->source = data[0x0A];
+	snap->status = data[0x0B];
+	snap->stop_at_eot = WORD(data + 0x0E) & SNAP_FLAG_STOP_AT_EOT;
+	snap->table_len = DWORD(data + 0x18);
+	snap->count = DWORD(data + 0x1C);
+	snap->hash_size = DWORD(data + 0x20);
+	snap->ep = data + SNAP_EP_OFFSET;
+	snap->table = data + SNAP_TABLE_OFFSET;
+
+	padded = (snap->table_len + 3) & ~3U;
+	if (snap->table_len > 0xFFFFFFF0U
+	 || padded > size - SNAP_TABLE_OFFSET)
+		return -1;
+	size -= SNAP_TABLE_OFFSET + padded;
+	snap->index = snap->table + padded;
+
+	/* Computed on 64 bits, so that bogus counts can't overflow */
+	if ((unsigned long long)snap->count * (SNAP_ENTRY_SIZE + 4)
+	  + (unsigned long long)snap->hash_size * 4 + 257 * 4 > size)
+		return -1;
+
+	return 0;
+}
+
+/*
+ * Use the index stored in a snapshot instead of scanning the table. It
+ * is checked first, at the cost of a few comparisons per entry, so that
+ * a corrupted file can't send the decoder out of the table.
+ * Returns 0 on success, -1 if the table must be scanned again.
+ */
+static int dmi_snapshot_index(struct dmi_table_index *t,
+			      const struct dmi_snapshot *snap, int stop_at_eot)
+{
+#ifdef BIGENDIAN
+	return -1;
+#else
+	struct dmi_entry *entry = (struct dmi_entry *)snap->index;
+	u32 *type_start = (u32 *)(snap->index + snap->count * SNAP_ENTRY_SIZE);
+	u32 *by_type = type_start + 257;
+	u32 *by_handle = by_type + snap->count;
+	const u8 *table = snap->table;
+	u32 count = snap->count;
+	u32 off = 0, used = 0, i;
+
+	if (sizeof(struct dmi_entry) != SNAP_ENTRY_SIZE
+	 || snap->status > DMI_SCAN_TRUNCATED
+	 || snap->hash_size <= count
+	 || (snap->hash_size & (snap->hash_size - 1)))
+		return -1;
+
+	for (i = 0; i < count; i++)
 	{
-		/*
-		 * When reading from sysfs or from a dump file, the file may be
-		 * shorter than announced. For SMBIOS v3 this is expcted, as we
-		 * only know the maximum table size, not the actual table size.
-		 * For older implementations (and for SMBIOS v3 too), this
-		 * would be the result of the kernel truncating the table on
-		 * parse error.
-		 */
-		size_t size = len;
-		buf = read_file(flags & FLAG_NO_FILE_OFFSET ? 0 : base,
-			&size, devmem);
-		if (!(opt.flags & FLAG_QUIET) && num && size != (size_t)len)
+		const struct dmi_entry *e = &entry[i];
+		const u8 *data = table + e->offset;
+
+		if (e->offset != off || off + 4 > snap->table_len
+		 || e->length < 4 || data[0] != e->type
+		 || data[1] != e->length || WORD(data + 2) != e->handle)
+			return -1;
+
+		/* Only the last entry may go beyond the table */
+		if (e->next > snap->table_len)
 		{
-			printf(u"Wrong DMI structures length: %u bytes "
-				u"announced, only %lu bytes available.\n",
-				len, (unsigned long)size);
+			if (i != count - 1 || snap->status != DMI_SCAN_TRUNCATED)
+				return -1;
 		}
-		len = size;
+		else if (e->next < off + e->length + 2
+		      || table[e->next - 2] || table[e->next - 1])
+			return -1;
+		off = e->next;
 	}
-	else
-		buf = mem_chunk(base, len, devmem);
+	if (snap->status == DMI_SCAN_SHORT
+	 && (off + 4 > snap->table_len || table[off + 1] >= 4))
+		return -1;
+
+	if (type_start[0] != 0 || type_start[256] != count)
+		return -1;
+	for (i = 0; i < 256; i++)
+		if (type_start[i] > type_start[i + 1])
+			return -1;
+	for (i = 0; i < count; i++)
+		if (by_type[i] >= count)
+			return -1;
+	for (i = 0; i < snap->hash_size; i++)
+	{
+		if (by_handle[i] > count)
+			return -1;
+		used += by_handle[i] != 0;
+	}
+	/* Lookups need an empty slot to stop at */
+	if (used > count)
+		return -1;
 
-	if (buf == NULL)
+	/*
+	 * A snapshot scanned past the end-of-table marker can still be used
+	 * in quiet mode, if nothing follows the marker.
+	 */
+	if (stop_at_eot != snap->stop_at_eot)
 	{
-		printf(u"Failed to read table, sorry.\n");
-#ifndef USE_MMAP
-		if (!(flags & FLAG_NO_FILE_OFFSET))
-			printf(u"Try compiling dmidecode with -DUSE_MMAP.\n");
+		if (!stop_at_eot
+		 || (type_start[127] != type_start[128]
+		  && by_type[type_start[127]] != count - 1))
+			return -1;
+	}
+
+	t->entry = entry;
+	t->count = count;
+	t->size = count;
+	t->status = snap->status;
+	memcpy(t->type_start, type_start, sizeof(t->type_start));
+	t->by_type = by_type;
+	t->by_handle = by_handle;
+	t->hash_mask = snap->hash_size - 1;
+	t->mapped = 1;
+
+	return 0;
 #endif
-		return;
+}
+
+/*
+ * Write the table and its index to a snapshot file. The entry point is
+ * added later, by the caller of dmi_table(). Returns 0 on success.
+ */
+static int dmi_table_snapshot(struct dmi_context *ctx, const u8 *buf, u32 len,
+			      u32 announced, u16 num, u32 ver, off_t base,
+			      u32 flags, u8 source, const char *filename)
+{
+	struct dmi_table_index t;
+	u32 padded = (len + 3) & ~3U;
+	size_t size;
+	u8 *data, *p;
+	u32 i;
+	int ret = -1;
+
+	if (dmi_table_scan(&t, buf, len, num, flags & FLAG_STOP_AT_EOT,
+			   NULL, ctx->arena) < 0)
+		return -1;
+	if (dmi_table_index_build(&t) < 0)
+	{
+		arena_free(t.arena, t.entry);
+		return -1;
 	}
 
-	if (opt.flags & FLAG_DUMP_BIN)
-		dmi_table_dump(buf, len);
-	else
-		dmi_table_decode(buf, len, num, ver >> 8, flags);
+	size = SNAP_TABLE_OFFSET + padded
+	     + (size_t)t.count * (SNAP_ENTRY_SIZE + 4) + 257 * 4
+	     + ((size_t)t.hash_mask + 1) * 4;
+	data = arena_calloc(ctx->arena, 1, size);
+	if (data == NULL)
+	{
+		perror(u"calloc");
+		goto out;
+	}
 
-	free(buf);
+	memcpy(data, SNAP_MAGIC, 8);
+	put_word(data + 0x08, SNAP_VERSION);
+	data[0x0A] = source;
+	data[0x0B] = t.status;
+	put_word(data + 0x0C, num);
+	put_word(data + 0x0E,
+		 flags & FLAG_STOP_AT_EOT ? SNAP_FLAG_STOP_AT_EOT : 0);
+	put_dword(data + 0x10, ver);
+	put_dword(data + 0x14, announced);
+	put_dword(data + 0x18, len);
+	put_dword(data + 0x1C, t.count);
+	put_dword(data + 0x20, t.hash_mask + 1);
+	put_dword(data + 0x28, (unsigned long long)base & 0xFFFFFFFF);
+	put_dword(data + 0x2C, (unsigned long long)base >> 32);
+	put_dword(data + 0x30, ctx->ep_address & 0xFFFFFFFF);
+	put_dword(data + 0x34, ctx->ep_address >> 32);
+	memcpy(data + SNAP_TABLE_OFFSET, buf, len);
+
+	p = data + SNAP_TABLE_OFFSET + padded;
+	for (i = 0; i < t.count; i++)
+	{
+		p = put_dword(p, t.entry[i].offset);
+		p = put_dword(p, t.entry[i].next);
+		p = put_word(p, t.entry[i].handle);
+		*p++ = t.entry[i].type;
+		*p++ = t.entry[i].length;
+	}
+	for (i = 0; i < 257; i++)
+		p = put_dword(p, t.type_start[i]);
+	for (i = 0; i < t.count; i++)
+		p = put_dword(p, t.by_type[i]);
+	for (i = 0; i <= t.hash_mask; i++)
+		p = put_dword(p, t.by_handle[i]);
+
+	if ((ctx->opt.flags & (FLAG_QUIET | FLAG_SNAPSHOT)) == FLAG_SNAPSHOT)
+		pr_comment(u"Writing %lu bytes to %s.", (unsigned long)size,
+			   filename);
+	ret = write_dump(0, size, data, filename, 0);
+	arena_free(ctx->arena, data);
+out:
+	dmi_table_index_free(&t);
+	return ret;
 }
 
-
 /*
- * Build a crafted entry point with table address hard-coded to 32,
- * as this is where we will put it in the output file. We adjust the
- * DMI checksum appropriately. The SMBIOS checksum needs no adjustment.
+ * Statistics (--stats): the time of the run is split into phases, each
+ * phase being charged the time elapsed since the end of the previous one.
+ * The time spent writing the output out, which happens whenever the
+ * output buffer fills up, is always charged to the output phase instead.
+ * Decoding time and output size are also counted per structure type,
+ * and the table source is reported along with how it got the table.
  */
-static void overwrite_dmi_address(u8 *buf)
+#define STATS_DISCOVERY		0	/* Finding and checking the entry point */
+#define STATS_READ		1
+#define STATS_INDEX		2	/* Table scan and vendor lookup */
+#define STATS_DECODE		3
+#define STATS_OUTPUT		4
+#define STATS_PHASES		5
+
+struct dmi_stats
+{
+	unsigned long long start;
+	unsigned long long mark;	/* End of the previous phase */
+	unsigned long long mark_write;	/* pr_write_time() at mark */
+	unsigned long long phase[STATS_PHASES];
+	const char *source;		/* See dmi_source[] */
+	const char *access;		/* Mapped, copied... see dmi_table() */
+	struct
+	{
+		u32 count;		/* Structures in the table */
+		u32 decoded;
+		unsigned long long ns;
+		unsigned long long bytes;
+	} type[256];
+};
+
+static struct dmi_stats *dmi_stats_new(struct arena *a)
 {
-	buf[0x05] += buf[0x08] + buf[0x09] + buf[0x0A] + buf[0x0B] - 32;
-	buf[0x08] = 32;
-	buf[0x09] = 0;
-	buf[0x0A] = 0;
-	buf[0x0B] = 0;
+	struct dmi_stats *s;
+
+	if ((s = arena_calloc(a, 1, sizeof(*s))) == NULL)
+	{
+		perror(u"calloc");
+		return NULL;
+	}
+	pr_set_stats(1);
+	s->start = s->mark = monotonic_ns();
+	return s;
 }
 
-/* Same thing for SMBIOS3 entry points */
-static void overwrite_smbios3_address(u8 *buf)
+/* Charge the time elapsed since the end of the previous phase */
+static void dmi_stats_phase(struct dmi_stats *s, int phase)
 {
-	buf[0x05] += buf[0x10] + buf[0x11] + buf[0x12] + buf[0x13]
-		   + buf[0x14] + buf[0x15] + buf[0x16] + buf[0x17] - 32;
-	buf[0x10] = 32;
-	buf[0x11] = 0;
-	buf[0x12] = 0;
-	buf[0x13] = 0;
-	buf[0x14] = 0;
-	buf[0x15] = 0;
-	buf[0x16] = 0;
-	buf[0x17] = 0;
+	unsigned long long now, write;
+
+	if (s == NULL)
+		return;
+
+	now = monotonic_ns();
+	write = pr_write_time();
+	s->phase[phase] += now - s->mark - (write - s->mark_write);
+	s->phase[STATS_OUTPUT] += write - s->mark_write;
+	s->mark = now;
+	s->mark_write = write;
 }
 
-static int smbios3_decode(u8 *buf, const char *devmem, u32 flags)
+static void dmi_stats_access(struct dmi_stats *s, const char *access)
 {
-	u32 ver;
-	u64 offset;
+	if (s != NULL)
+		s->access = access;
+}
 
-	/* Don't let checksum run beyond the buffer */
-	if (buf[0x06] > 0x20)
+static void dmi_stats_print(struct dmi_stats *s)
+{
+	static const char * const phase[STATS_PHASES] = {
+		u"Entry Point Discovery",
+		u"Table Read",
+		u"Table Index",
+		u"Decoding",
+		u"Output"
+	};
+	char name[16];
+	unsigned int i;
+
+	dmi_stats_phase(s, STATS_DECODE);
+
+	/* The summary isn't subject to field selection */
+	pr_set_fields(NULL, 0);
+	pr_handle_name(u"Statistics");
+	for (i = 0; i < STATS_PHASES; i++)
+		pr_attr(phase[i], u"%.3f ms", s->phase[i] / 1e6);
+	pr_attr(u"Total", u"%.3f ms", (s->mark - s->start) / 1e6);
+	if (s->source != NULL)
 	{
-		printf(u"Entry point length too large (%u bytes, expected %u).\n",
-			(unsigned int)buf[0x06], 0x18U);
-		return 0;
+		pr_attr(u"Table Source", u"%s", s->source);
+		if (s->access != NULL)
+			pr_subattr(u"Access", u"%s", s->access);
+	}
+	for (i = 0; i < 256; i++)
+	{
+		if (s->type[i].count == 0)
+			continue;
+		sprintf(name, u"Type %u", i);
+		pr_attr(name, u"%u structures", s->type[i].count);
+		pr_subattr(u"Decoded", u"%u", s->type[i].decoded);
+		pr_subattr(u"Filtered", u"%u",
+			   s->type[i].count - s->type[i].decoded);
+		pr_subattr(u"Time", u"%.3f ms", s->type[i].ns / 1e6);
+		pr_subattr(u"Output", u"%llu bytes", s->type[i].bytes);
 	}
+	pr_sep();
+	pr_set_stats(0);
+}
 
-	if (!checksum(buf, buf[0x06]))
-		return 0;
+/*
+ * Change detection (--baseline, --diff): the table is compared with the
+ * one saved by a previous --dump-bin or --snapshot run. If they are
+ * identical, nothing is decoded and the exit status is 3. Otherwise each
+ * structure is matched with its baseline version, and only the structures
+ * which are new or differ from it are decoded. The structures which
+ * disappeared are listed.
+ */
+#define DMI_DIFF_SAME		0
+#define DMI_DIFF_CHANGED	1
+#define DMI_DIFF_ADDED		2	/* Not in the baseline */
 
-	ver = (buf[0x07] << 16) + (buf[0x08] << 8) + buf[0x09];
-	if (!(opt.flags & FLAG_QUIET))
-		pr_info(u"SMBIOS %u.%u.%u present.",
-			buf[0x07], buf[0x08], buf[0x09]);
+struct dmi_baseline
+{
+	u8 *data;		/* Whole file */
+	u8 *table;
+	u32 len;
+	struct dmi_table_index index;
+};
 
-	offset = QWORD(buf + 0x10);
-	if (!(flags & FLAG_NO_FILE_OFFSET) && offset.h && sizeof(off_t) < 8)
+static struct dmi_baseline *dmi_baseline_load(const char *filename,
+					      struct arena *a)
+{
+	struct dmi_baseline *b;
+	struct dmi_snapshot snap;
+	size_t size = ~(size_t)0;
+	u16 num = 0;
+	u8 *ep;
+
+	if ((b = arena_alloc(a, sizeof(*b))) == NULL)
 	{
-		printf(u"64-bit addresses not supported, sorry.\n");
-		return 0;
+		perror(u"malloc");
+		return NULL;
+	}
+	if ((b->data = read_file(0, &size, filename, a)) == NULL)
+	{
+		pr_info(u"%s: Can't read baseline file", filename);
+		goto err_free;
 	}
 
-	dmi_table(((off_t)offset.h << 32) | offset.l,
-		  DWORD(buf + 0x0C), 0, ver, devmem, flags | FLAG_STOP_AT_EOT);
-
-	if (opt.flags & FLAG_DUMP_BIN)
+	if (dmi_snapshot_open(&snap, b->data, size) == 0)
 	{
-		u8 crafted[32];
+		ep = snap.ep;
+		b->table = snap.table;
+		b->len = snap.table_len;
+	}
+	else
+	{
+		/* Plain dump, the table follows the entry point at offset 32 */
+		ep = b->data;
+		b->table = b->data + 32;
+		if (size >= 32 && memcmp(ep, "_SM3_", 5) == 0)
+			b->len = DWORD(ep + 0x0C);
+		else if (size >= 32 && memcmp(ep, "_SM_", 4) == 0)
+			b->len = WORD(ep + 0x16);
+		else if (size >= 32 && memcmp(ep, "_DMI_", 5) == 0)
+			b->len = WORD(ep + 0x06);
+		else
+		{
+			pr_info(u"%s: Invalid baseline file", filename);
+			goto err_data;
+		}
+		if (b->len > size - 32)
+			b->len = size - 32;
+	}
 
-		memcpy(crafted, buf, 32);
-		overwrite_smbios3_address(crafted);
+	if (memcmp(ep, "_SM_", 4) == 0)
+		num = WORD(ep + 0x1C);
+	else if (memcmp(ep, "_DMI_", 5) == 0)
+		num = WORD(ep + 0x0C);
 
-		if (!(opt.flags & FLAG_QUIET))
-			pr_comment(u"Writing %d bytes to %s.", crafted[0x06],
-				   opt.dumpfile);
-		write_dump(0, crafted[0x06], crafted, opt.dumpfile, 1);
+	if (dmi_table_scan(&b->index, b->table, b->len, num, 0, NULL, a) < 0)
+		goto err_data;
+	if (dmi_table_index_build(&b->index) < 0)
+	{
+		arena_free(a, b->index.entry);
+		goto err_data;
 	}
+	return b;
 
-	return 1;
+err_data:
+	arena_free(a, b->data);
+err_free:
+	arena_free(a, b);
+	return NULL;
 }
 
-static int smbios_decode(u8 *buf, const char *devmem, u32 flags)
+/*
+ * Copy a table just read, to compare the next --watch poll with it. The
+ * copy is taken before decoding filters the strings in place.
+ */
+static struct dmi_baseline *dmi_baseline_copy(const u8 *data, u32 len,
+					      u16 num)
+{
+	struct dmi_baseline *b;
+
+	if ((b = malloc(sizeof(*b))) == NULL
+	 || (b->data = malloc(len ? len : 1)) == NULL)
+	{
+		perror(u"malloc");
+		free(b);
+		return NULL;
+	}
+	memcpy(b->data, data, len);
+	b->table = b->data;
+	b->len = len;
+
+	if (dmi_table_scan(&b->index, b->table, len, num, 0, NULL, NULL) < 0)
+		goto err_data;
+	if (dmi_table_index_build(&b->index) < 0)
+	{
+		free(b->index.entry);
+		goto err_data;
+	}
+	return b;
+
+err_data:
+	free(b->data);
+	free(b);
+	return NULL;
+}
+
+static void dmi_baseline_free(struct dmi_baseline *b)
+{
+	if (b == NULL)
+		return;
+	dmi_table_index_free(&b->index);
+	free(b->data);
+	free(b);
+}
+
+/* How the baseline is called in messages */
+static const char *dmi_baseline_name(const struct dmi_context *ctx)
+{
+	if (ctx->opt.baseline != NULL)
+		return ctx->opt.baseline;
+	return u"the previous poll";
+}
+
+/* Returns the first entry with the given handle, NULL if there is none */
+static const struct dmi_entry *dmi_table_find(const struct dmi_table_index *t,
+					      u16 handle)
+{
+	u32 slot = dmi_handle_hash(t, handle);
+
+	while (t->by_handle[slot])
+	{
+		const struct dmi_entry *e = &t->entry[t->by_handle[slot] - 1];
+
+		if (e->handle == handle)
+			return e;
+		slot = (slot + 1) & t->hash_mask;
+	}
+	return NULL;
+}
+
+/*
+ * Structures which can be told apart by their designation strings are
+ * matched on these, so that renumbered handles don't make the whole table
+ * look different. The others are matched on their handle.
+ */
+static const struct dmi_diff_key
+{
+	u8 type;
+	u8 length;		/* Minimum, to hold the string numbers */
+	u8 s1, s2;		/* Offsets of the string numbers, 0: none */
+} dmi_diff_key[] = {
+	{ 4, 0x05, 0x04, 0 },		/* Socket Designation */
+	{ 7, 0x05, 0x04, 0 },		/* Socket Designation */
+	{ 8, 0x07, 0x04, 0x06 },	/* Internal and External Reference
+					   Designators */
+	{ 9, 0x05, 0x04, 0 },		/* Designation */
+	{ 17, 0x12, 0x10, 0x11 },	/* Locator and Bank Locator */
+	{ 41, 0x05, 0x04, 0 },		/* Reference Designation */
+};
+
+static const struct dmi_diff_key *dmi_diff_key_of(u8 type, u8 length)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(dmi_diff_key); i++)
+		if (dmi_diff_key[i].type == type)
+			return length >= dmi_diff_key[i].length
+			       ? &dmi_diff_key[i] : NULL;
+	return NULL;
+}
+
+/* Returns the key string at offset s of structure data, NULL if none */
+static const char *dmi_diff_key_string(u8 *data, u8 s)
+{
+	struct dmi_header h;
+
+	if (s == 0 || data[s] == 0)
+		return NULL;
+	to_dmi_header(&h, data, NULL);
+	return _dmi_string(&h, data[s], 0);
+}
+
+static int dmi_diff_same_string(const char *a, const char *b)
+{
+	return a == NULL ? b == NULL : b != NULL && strcmp(a, b) == 0;
+}
+
+static int dmi_diff_same_key(const struct dmi_diff_key *k, u8 *a, u8 *b)
+{
+	return dmi_diff_same_string(dmi_diff_key_string(a, k->s1),
+				    dmi_diff_key_string(b, k->s1))
+	    && dmi_diff_same_string(dmi_diff_key_string(a, k->s2),
+				    dmi_diff_key_string(b, k->s2));
+}
+
+/* Returns 1 if entry e of buf differs from baseline entry o */
+static int dmi_baseline_differs(const struct dmi_baseline *b,
+				const struct dmi_entry *o, const u8 *buf,
+				u32 len, const struct dmi_entry *e)
+{
+	const u8 *p = b->table + o->offset, *q = buf + e->offset;
+	u32 size = e->next - e->offset;
+
+	/* The handles may differ, as structures aren't only matched on them */
+	return e->next > len || o->next > b->len
+	    || o->next - o->offset != size
+	    || p[0] != q[0] || p[1] != q[1]
+	    || memcmp(p + 4, q + 4, size - 4) != 0;
+}
+
+/*
+ * Returns the baseline entry not matched yet which entry e of buf is to be
+ * compared with, NULL if there is none. The entry with the same handle and
+ * type comes first, unless the keys of the type tell otherwise, so that the
+ * common case, an unchanged numbering, is cheap. Failing that, the entry
+ * of the same key is looked for, or the only one of a singular type, or
+ * else an identical entry under another handle.
+ */
+static const struct dmi_entry *dmi_baseline_match(const struct dmi_baseline *b,
+						  const u8 *matched, u8 *buf,
+						  u32 len,
+						  const struct dmi_entry *e)
+{
+	const struct dmi_table_index *t = &b->index;
+	const struct dmi_entry *o = dmi_table_find(t, e->handle);
+	const struct dmi_diff_key *k = dmi_diff_key_of(e->type, e->length);
+	u32 i;
+
+	/* Key strings are only looked for in complete structures */
+	if (k != NULL
+	 && (e->next > len
+	  || (dmi_diff_key_string(buf + e->offset, k->s1) == NULL
+	   && dmi_diff_key_string(buf + e->offset, k->s2) == NULL)))
+		k = NULL;
+
+	if (o != NULL && o->type == e->type && !matched[o - t->entry]
+	 && (k == NULL
+	  || (o->length >= k->length && o->next <= b->len
+	   && dmi_diff_same_key(k, b->table + o->offset, buf + e->offset))))
+		return o;
+
+	for (i = t->type_start[e->type]; i < t->type_start[e->type + 1]; i++)
+	{
+		o = &t->entry[t->by_type[i]];
+		if (matched[t->by_type[i]])
+			continue;
+		if (k != NULL)
+		{
+			if (o->length >= k->length && o->next <= b->len
+			 && dmi_diff_same_key(k, b->table + o->offset,
+					      buf + e->offset))
+				return o;
+		}
+		else if (dmi_type_singular(e->type)
+		      || !dmi_baseline_differs(b, o, buf, len, e))
+			return o;
+	}
+	return NULL;
+}
+
+/*
+ * Compare every entry of the table with the baseline, before anything is
+ * decoded as decoding filters the strings in place. changed[i] tells how
+ * entry i differs from its baseline version, see dmi_table_decode_entry(),
+ * and matched[] which baseline entries have a counterpart.
+ * Returns the number of entries which differ.
+ */
+static u32 dmi_baseline_compare(const struct dmi_baseline *b,
+				const struct dmi_table_index *t, u8 *buf,
+				u32 len, u8 *changed, u8 *matched)
+{
+	u32 count = 0, i;
+
+	for (i = 0; i < t->count; i++)
+	{
+		const struct dmi_entry *e = &t->entry[i];
+		const struct dmi_entry *o;
+
+		o = dmi_baseline_match(b, matched, buf, len, e);
+		if (o == NULL)
+			changed[i] = DMI_DIFF_ADDED;
+		else
+		{
+			matched[o - b->index.entry] = 1;
+			changed[i] = dmi_baseline_differs(b, o, buf, len, e)
+				   ? DMI_DIFF_CHANGED : DMI_DIFF_SAME;
+		}
+		count += changed[i] != DMI_DIFF_SAME;
+	}
+
+	return count;
+}
+
+/* Returns the number of baseline entries without a counterpart */
+static u32 dmi_baseline_removed(const struct dmi_baseline *b,
+				const u8 *matched)
+{
+	u32 count = 0, i;
+
+	for (i = 0; i < b->index.count; i++)
+	{
+		const struct dmi_entry *o = &b->index.entry[i];
+
+		if (matched[i])
+			continue;
+		pr_info(u"Handle 0x%04X, DMI type %u, removed.",
+			o->handle, o->type);
+		count++;
+	}
+
+	return count;
+}
+
+/*
+ * Table kept by a library context between runs (see libdmidecode.h), so
+ * that only the first query actually reads it. It is looked up by where
+ * it was read from. Decoding filters strings in place, so each run works
+ * on a fresh copy of the table, while the index is shared as is.
+ */
+struct dmi_cache
+{
+	char *devmem;			/* NULL: nothing cached */
+	off_t base;
+	u32 len;
+	u32 flags;
+	u8 *table;
+	u8 *work;
+	size_t size;
+	int current;			/* Holds the table being decoded */
+
+	struct dmi_table_index index;
+	int indexed;
+	u16 index_num;
+	int index_stop_at_eot;
+};
+
+static struct dmi_cache *dmi_cache_new(void)
+{
+	struct dmi_cache *c;
+
+	if ((c = calloc(1, sizeof(*c))) == NULL)
+		perror(u"calloc");
+	return c;
+}
+
+static void dmi_cache_drop(struct dmi_cache *c)
+{
+	if (c->indexed)
+		dmi_table_index_free(&c->index);
+	c->indexed = 0;
+	free(c->devmem);
+	free(c->table);
+	free(c->work);
+	c->devmem = NULL;
+	c->table = NULL;
+	c->work = NULL;
+}
+
+static void dmi_cache_free(struct dmi_cache *c)
+{
+	if (c == NULL)
+		return;
+	dmi_cache_drop(c);
+	free(c);
+}
+
+/* Returns a working copy of the table if it is cached, NULL otherwise */
+static u8 *dmi_cache_lookup(struct dmi_cache *c, off_t base, u32 len,
+			    const char *devmem, u32 flags, size_t *size)
+{
+	if (c == NULL)
+		return NULL;
+
+	c->current = 0;
+	if (c->devmem == NULL || c->base != base || c->len != len
+	 || c->flags != flags || strcmp(c->devmem, devmem) != 0)
+		return NULL;
+
+	memcpy(c->work, c->table, c->size);
+	*size = c->size;
+	c->current = 1;
+	return c->work;
+}
+
+/* Replace the cached table with the one which was just read */
+static void dmi_cache_store(struct dmi_cache *c, off_t base, u32 len,
+			    const char *devmem, u32 flags, const u8 *data,
+			    size_t size)
+{
+	size_t n = strlen(devmem) + 1;
+
+	if (c == NULL)
+		return;
+
+	dmi_cache_drop(c);
+	c->devmem = malloc(n);
+	c->table = malloc(size ? size : 1);
+	c->work = malloc(size ? size : 1);
+	if (c->devmem == NULL || c->table == NULL || c->work == NULL)
+	{
+		/* Not fatal, the table will be read again next time */
+		dmi_cache_drop(c);
+		return;
+	}
+	memcpy(c->devmem, devmem, n);
+	memcpy(c->table, data, size);
+	c->base = base;
+	c->len = len;
+	c->flags = flags;
+	c->size = size;
+	c->current = 1;
+}
+
+/*
+ * Lend the cached index of the table being decoded.
+ * Returns 0 on success, -1 if there is none for these parameters.
+ */
+static int dmi_cache_index(const struct dmi_cache *c,
+			   struct dmi_table_index *t, u16 num, int stop_at_eot)
+{
+	if (c == NULL || !c->current || !c->indexed
+	 || c->index_num != num || c->index_stop_at_eot != stop_at_eot)
+		return -1;
+
+	*t = c->index;
+	t->mapped = 1;
+	return 0;
+}
+
+/* Hand a freshly built index of the table being decoded over to the cache */
+static void dmi_cache_keep_index(struct dmi_cache *c,
+				 struct dmi_table_index *t, u16 num,
+				 int stop_at_eot)
+{
+	if (c == NULL || !c->current)
+		return;
+
+	if (c->indexed)
+		dmi_table_index_free(&c->index);
+	c->index = *t;
+	c->indexed = 1;
+	c->index_num = num;
+	c->index_stop_at_eot = stop_at_eot;
+	t->mapped = 1;
+}
+
+/*
+ * Decode one structure, if the options select it. truncated tells that
+ * the structure doesn't fit in the table, changed how it differs from
+ * the baseline (DMI_DIFF_SAME: not at all, it isn't decoded then).
+ * Returns 0 to go on with the next one, -1 to stop here.
+ */
+static int dmi_table_decode_entry(struct dmi_context *ctx, u8 *data,
+				  u16 ver, int truncated, int changed)
+{
+	struct dmi_strings strings;
+	struct dmi_header h;
+	int display;
+	unsigned long long start = 0, write = 0, bytes = 0;
+
+	if (ctx->stats != NULL)
+	{
+		start = monotonic_ns();
+		write = pr_write_time();
+		bytes = pr_output_bytes();
+	}
+
+	to_dmi_header(&h, data, &strings);
+	display = ((ctx->opt.type == NULL || ctx->opt.type[h.type])
+		&& (ctx->opt.handle == ~0U || ctx->opt.handle == h.handle)
+		&& !((ctx->opt.flags & FLAG_QUIET)
+		  && (h.type == 126 || h.type == 127))
+		&& changed);
+
+	/* In quiet mode, stop decoding at end of table marker */
+	if ((ctx->opt.flags & FLAG_QUIET) && h.type == 127)
+		return -1;
+
+	if (display && (ctx->opt.flags & FLAG_DIFF))
+		pr_info(u"Handle 0x%04X, DMI type %u, %s.", h.handle, h.type,
+			changed == DMI_DIFF_ADDED ? u"added" : u"changed");
+
+	/* Field selection doesn't apply to raw dumps */
+	if (display && !(ctx->opt.flags & FLAG_DUMP))
+		pr_select_type(h.type);
+	if (display && (!(ctx->opt.flags & FLAG_COMPACT) || truncated)
+	 && (!(ctx->opt.flags & FLAG_QUIET) || (ctx->opt.flags & FLAG_DUMP)))
+		pr_handle(&h);
+
+	/* Make sure the whole structure fits in the table */
+	if (truncated)
+	{
+		if (display && !(ctx->opt.flags & FLAG_QUIET))
+			pr_struct_err(u"<TRUNCATED>");
+		pr_sep();
+		return -1;
+	}
+
+	/* Fixup a common mistake */
+	if (h.type == 34)
+		dmi_fixup_type_34(ctx, &h, display);
+
+	if (display)
+	{
+		if (ctx->opt.flags & FLAG_COMPACT)
+			dmi_dump_compact(&h);
+		else if (ctx->opt.flags & FLAG_DUMP)
+		{
+			dmi_dump(ctx, &h);
+			pr_sep();
+		}
+		else
+			dmi_decode(ctx, &h, ver);
+	}
+
+	if (ctx->stats != NULL && display)
+	{
+		ctx->stats->type[h.type].decoded++;
+		ctx->stats->type[h.type].ns += monotonic_ns() - start
+					     - (pr_write_time() - write);
+		ctx->stats->type[h.type].bytes += pr_output_bytes() - bytes;
+	}
+
+	return 0;
+}
+
+/*
+ * Memory topology summary (--memory): the memory arrays (type 16), their
+ * devices (type 17), and the address ranges mapped to them (types 19 and
+ * 20), read straight from the structures and followed through the handle
+ * index rather than decoded one by one. SMBIOS has no notion of channel,
+ * so the devices are grouped by Bank Locator, which is where firmwares
+ * name the channel.
+ */
+struct dmi_memory_array
+{
+	u16 handle;
+	int known;			/* Has a type 16 structure */
+	unsigned long long capacity;	/* kB, 0: unknown */
+	u16 slots;
+	u32 devices;
+	u32 populated;
+	u32 mapped;			/* Devices with a type 20 range */
+	unsigned long long size;	/* kB */
+	u32 speed[2], configured[2];	/* MT/s, lowest and highest */
+	u32 rank[2];
+};
+
+struct dmi_memory_device
+{
+	int known;			/* Structure is complete */
+	u32 array;			/* Index in the arrays */
+	const char *bank;
+	int populated;
+	int mapped;
+};
+
+static unsigned long long dmi_memory_qword(const u8 *p)
+{
+	u64 q = QWORD(p);
+
+	return ((unsigned long long)q.h << 32) | q.l;
+}
+
+/* Format a size given in kB with the greatest exact unit */
+static void dmi_memory_summary_size(char *s, unsigned long long size)
+{
+	static const char * const unit[5] = {
+		u"kB", u"MB", u"GB", u"TB", u"PB"
+	};
+	int i = 0;
+
+	while (i < 4 && size != 0 && (size & 0x3FF) == 0)
+	{
+		size >>= 10;
+		i++;
+	}
+	sprintf(s, u"%llu %s", size, unit[i]);
+}
+
+static void dmi_memory_summary_range(const char *attr, const u32 *range,
+				     const char *unit)
+{
+	if (range[0] == 0)
+		pr_subattr(attr, u"Unknown");
+	else if (range[0] == range[1])
+		pr_subattr(attr, u"%u%s", range[0], unit);
+	else
+		pr_subattr(attr, u"%u to %u%s", range[0], range[1], unit);
+}
+
+static void dmi_memory_summary_minmax(u32 *range, u32 value)
+{
+	if (value == 0)
+		return;
+	if (range[0] == 0 || value < range[0])
+		range[0] = value;
+	if (value > range[1])
+		range[1] = value;
+}
+
+/* Type 19 range, in bytes */
+static void dmi_memory_summary_mapped(const char *attr, const u8 *data,
+				      u8 length)
+{
+	unsigned long long start, end;
+
+	if (length >= 0x1F && DWORD(data + 0x04) == 0xFFFFFFFF)
+	{
+		start = dmi_memory_qword(data + 0x0F);
+		end = dmi_memory_qword(data + 0x17);
+	}
+	else
+	{
+		start = (unsigned long long)DWORD(data + 0x04) << 10;
+		end = ((unsigned long long)DWORD(data + 0x08) << 10) + 0x3FF;
+	}
+	pr_subattr(attr, u"0x%011llX-0x%011llX", start, end);
+}
+
+/* Returns the size of the device in kB, 0 if none is installed */
+static unsigned long long dmi_memory_device_kb(const u8 *data, u8 length)
+{
+	u16 code = WORD(data + 0x0C);
+
+	if (length >= 0x20 && code == 0x7FFF)
+		return (unsigned long long)(DWORD(data + 0x1C) & 0x7FFFFFFFUL)
+		       << 10;
+	if (code == 0 || code == 0xFFFF)
+		return 0;
+	if (code & 0x8000)
+		return code & 0x7FFF;
+	return (unsigned long long)code << 10;
+}
+
+static u32 dmi_memory_device_mts(const u8 *data, u8 length, u8 offset,
+				 u8 extended)
+{
+	u16 code = WORD(data + offset);
+
+	if (code == 0xFFFF)
+		return length >= 0x5C ? DWORD(data + extended) : 0;
+	return code;
+}
+
+/* Returns the rank of entry e among the entries of its type */
+static u32 dmi_table_rank(const struct dmi_table_index *t,
+			  const struct dmi_entry *e)
+{
+	u32 lo = t->type_start[e->type], hi = t->type_start[e->type + 1];
+	u32 i = e - t->entry;
+
+	/* Entries of a type are listed in table order */
+	while (hi - lo > 1)
+	{
+		u32 mid = lo + (hi - lo) / 2;
+
+		if (t->by_type[mid] > i)
+			hi = mid;
+		else
+			lo = mid;
+	}
+	return lo - t->type_start[e->type];
+}
+
+/*
+ * Returns the index of the array of handle, those not described by a type
+ * 16 structure being added after the others
+ */
+static u32 dmi_memory_array_of(const struct dmi_table_index *t,
+			       struct dmi_memory_array *array, u32 *count,
+			       u16 handle)
+{
+	const struct dmi_entry *e = dmi_table_find(t, handle);
+	u32 arrays = t->type_start[17] - t->type_start[16];
+	u32 i;
+
+	if (e != NULL && e->type == 16 && array[dmi_table_rank(t, e)].known)
+		return dmi_table_rank(t, e);
+
+	for (i = arrays; i < *count; i++)
+		if (array[i].handle == handle)
+			return i;
+	memset(&array[i], 0, sizeof(array[i]));
+	array[i].handle = handle;
+	(*count)++;
+	return i;
+}
+
+static void dmi_memory_summary(struct dmi_context *ctx,
+			       const struct dmi_table_index *t, u8 *buf,
+			       u32 len)
+{
+	u32 arrays = t->type_start[17] - t->type_start[16];
+	u32 devices = t->type_start[18] - t->type_start[17];
+	struct dmi_memory_array *array;
+	struct dmi_memory_device *device;
+	unsigned long long capacity = 0, size = 0;
+	u32 count = arrays, described = 0, total = 0, populated = 0;
+	u32 i, j, k;
+	char s[32];
+
+	/*
+	 * Arrays and devices are indexed like their structures among those
+	 * of their type. Every device may belong to an array without a type
+	 * 16 structure.
+	 */
+	array = arena_calloc(ctx->arena, arrays + devices + 1, sizeof(*array));
+	device = arena_calloc(ctx->arena, devices + 1, sizeof(*device));
+	if (array == NULL || device == NULL)
+	{
+		perror(u"calloc");
+		goto out;
+	}
+
+	for (i = 0; i < arrays; i++)
+	{
+		const struct dmi_entry *e = &t->entry[t->by_type[t->type_start[16] + i]];
+		const u8 *data = buf + e->offset;
+		struct dmi_memory_array *a = &array[i];
+
+		a->handle = e->handle;
+		if (e->next > len || e->length < 0x0F)
+			continue;
+		a->known = 1;
+		if (DWORD(data + 0x07) != 0x80000000)
+			a->capacity = DWORD(data + 0x07);
+		else if (e->length >= 0x17)
+			a->capacity = dmi_memory_qword(data + 0x0F) >> 10;
+		a->slots = WORD(data + 0x0D);
+	}
+
+	for (i = 0; i < devices; i++)
+	{
+		const struct dmi_entry *e = &t->entry[t->by_type[t->type_start[17] + i]];
+		u8 *data = buf + e->offset;
+		struct dmi_memory_device *d = &device[i];
+		struct dmi_memory_array *a;
+		struct dmi_header h;
+
+		if (e->next > len || e->length < 0x15)
+			continue;
+		d->known = 1;
+		d->array = dmi_memory_array_of(t, array, &count,
+					       WORD(data + 0x04));
+		to_dmi_header(&h, data, NULL);
+		d->bank = dmi_string(&h, data[0x11]);
+
+		a = &array[d->array];
+		a->devices++;
+		d->populated = WORD(data + 0x0C) != 0;
+		if (!d->populated)
+			continue;
+		a->populated++;
+		a->size += dmi_memory_device_kb(data, e->length);
+		if (e->length >= 0x17)
+			dmi_memory_summary_minmax(a->speed,
+				dmi_memory_device_mts(data, e->length, 0x15, 0x54));
+		if (e->length >= 0x22)
+			dmi_memory_summary_minmax(a->configured,
+				dmi_memory_device_mts(data, e->length, 0x20, 0x58));
+		if (e->length >= 0x1C)
+			dmi_memory_summary_minmax(a->rank, data[0x1B] & 0x0F);
+	}
+
+	/* Type 20 ranges point to their device, and so to its array */
+	for (i = t->type_start[20]; i < t->type_start[21]; i++)
+	{
+		const struct dmi_entry *e = &t->entry[t->by_type[i]];
+		const struct dmi_entry *o;
+		struct dmi_memory_device *d;
+
+		if (e->next > len || e->length < 0x13)
+			continue;
+		o = dmi_table_find(t, WORD(buf + e->offset + 0x0C));
+		if (o == NULL || o->type != 17)
+			continue;
+		d = &device[dmi_table_rank(t, o)];
+		if (d->known && !d->mapped)
+		{
+			d->mapped = 1;
+			array[d->array].mapped++;
+		}
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		capacity += array[i].capacity;
+		size += array[i].size;
+		populated += array[i].populated;
+		total += array[i].devices;
+		described += array[i].known;
+	}
+
+	/* The summary isn't subject to field selection */
+	pr_set_fields(NULL, 0);
+	pr_handle_name(u"Memory Topology");
+	pr_attr(u"Arrays", u"%u", described);
+	pr_attr(u"Devices", u"%u of %u populated", populated, total);
+	if (capacity)
+	{
+		dmi_memory_summary_size(s, capacity);
+		pr_attr(u"Maximum Capacity", u"%s", s);
+	}
+	else
+		pr_attr(u"Maximum Capacity", u"Unknown");
+	dmi_memory_summary_size(s, size);
+	pr_attr(u"Installed Size", u"%s", s);
+	for (i = 0; i < count; i++)
+	{
+		struct dmi_memory_array *a = &array[i];
+		char name[80];
+
+		if (!a->known && a->devices == 0)
+			continue;
+		sprintf(name, u"Array 0x%04X", a->handle);
+		if (a->known)
+			pr_attr(name, u"%u of %u devices populated",
+				a->populated, a->slots);
+		else
+			pr_attr(name, u"%u of %u devices populated",
+				a->populated, a->devices);
+		if (a->capacity)
+		{
+			dmi_memory_summary_size(s, a->capacity);
+			pr_subattr(u"Maximum Capacity", u"%s", s);
+		}
+		else
+			pr_subattr(u"Maximum Capacity", u"Unknown");
+		dmi_memory_summary_size(s, a->size);
+		pr_subattr(u"Installed Size", u"%s", s);
+		dmi_memory_summary_range(u"Speed", a->speed, u" MT/s");
+		dmi_memory_summary_range(u"Configured Speed", a->configured,
+					 u" MT/s");
+		dmi_memory_summary_range(u"Rank", a->rank, u"");
+		pr_subattr(u"Mapped Devices", u"%u of %u", a->mapped,
+			   a->devices);
+		for (j = t->type_start[19], k = 0; j < t->type_start[20]; j++)
+		{
+			const struct dmi_entry *e = &t->entry[t->by_type[j]];
+			const struct dmi_entry *o;
+
+			if (e->next > len || e->length < 0x0F)
+				continue;
+			o = dmi_table_find(t, WORD(buf + e->offset + 0x0C));
+			if (o == NULL || o->type != 16 || dmi_table_rank(t, o) != i)
+				continue;
+			sprintf(name, u"Mapped Range %u", ++k);
+			dmi_memory_summary_mapped(name, buf + e->offset,
+						  e->length);
+		}
+
+		/* One subattribute per channel, in order of first device */
+		for (j = 0; j < devices; j++)
+		{
+			const struct dmi_memory_device *d = &device[j];
+			u32 total = 0, used = 0;
+
+			if (!d->known || d->array != i)
+				continue;
+			for (k = 0; k < j; k++)
+				if (device[k].known && device[k].array == i
+				 && strcmp(device[k].bank, d->bank) == 0)
+					break;
+			if (k < j)
+				continue;
+			for (k = j; k < devices; k++)
+				if (device[k].known && device[k].array == i
+				 && strcmp(device[k].bank, d->bank) == 0)
+				{
+					total++;
+					used += device[k].populated;
+				}
+			sprintf(name, u"Channel %.64s", d->bank);
+			pr_subattr(name, u"%u of %u populated", used, total);
+		}
+	}
+	pr_sep();
+
+out:
+	arena_free(ctx->arena, device);
+	arena_free(ctx->arena, array);
+}
+
+/*
+ * Decode the selected entries visit[first] to visit[last - 1].
+ * Returns -1 if decoding stopped before the last one, 0 otherwise.
+ */
+static int dmi_table_decode_range(struct dmi_context *ctx,
+				  const struct dmi_table_index *t,
+				  const u32 *visit, u32 first, u32 last,
+				  u8 *buf, u32 len, u16 ver,
+				  const u8 *changed)
+{
+	u32 i;
+
+	for (i = first; i < last; i++)
+	{
+		const struct dmi_entry *e = &t->entry[visit[i]];
+
+		if (dmi_table_decode_entry(ctx, buf + e->offset, ver,
+					   e->next > len,
+					   changed != NULL ? changed[visit[i]]
+							   : DMI_DIFF_CHANGED) < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+#ifdef USE_PTHREAD
+/*
+ * Parallel decoding (--jobs out of batch mode): the selected entries are
+ * split into as many contiguous ranges as there are jobs. The calling
+ * thread decodes the first range straight to the output, while worker
+ * threads decode the others, each with its own copy of the context and
+ * into its own part of the output. The parts are then written in table
+ * order, so the output is the same as that of a serial decoding.
+ */
+struct dmi_part
+{
+	struct dmi_context ctx;
+	const struct dmi_table_index *t;
+	const u32 *visit;
+	u32 first, last;
+	u8 *buf;
+	u32 len;
+	u16 ver;
+	const u8 *changed;
+	struct pr_capture out;
+	struct dmi_stats stats;		/* Of the part, with FLAG_STATS */
+	int stopped;
+	int started;
+	pthread_t thread;
+};
+
+static void *dmi_part_worker(void *arg)
+{
+	struct dmi_part *p = arg;
+	struct arena arena;
+
+	arena_init(&arena);
+	p->ctx.arena = &arena;
+	pr_set_arena(&arena);
+	pr_set_format(p->ctx.opt.format);
+	pr_set_fields(p->ctx.opt.field, p->ctx.opt.field_count);
+	pr_part_start();
+	p->stopped = dmi_table_decode_range(&p->ctx, p->t, p->visit,
+					    p->first, p->last, p->buf,
+					    p->len, p->ver, p->changed) < 0;
+	pr_part_end(&p->out);
+	pr_set_arena(NULL);
+	p->ctx.arena = NULL;
+	arena_release(&arena);
+
+	return NULL;
+}
+
+static void dmi_stats_add(struct dmi_stats *s, const struct dmi_stats *part)
+{
+	unsigned int i;
+
+	for (i = 0; i < 256; i++)
+	{
+		s->type[i].decoded += part->type[i].decoded;
+		s->type[i].ns += part->type[i].ns;
+		s->type[i].bytes += part->type[i].bytes;
+	}
+}
+
+/*
+ * Returns -1 if the table must be decoded serially: too few entries for
+ * the threads to pay off, or entries which depend on the previous ones.
+ * The ranges of the threads which couldn't be started are decoded by the
+ * calling thread, in turn.
+ */
+static int dmi_table_decode_parallel(struct dmi_context *ctx,
+				     const struct dmi_table_index *t,
+				     const u32 *visit, u32 n, u8 *buf,
+				     u32 len, u16 ver, const u8 *changed)
+{
+	struct dmi_part *part;
+	u32 jobs = ctx->opt.jobs, i;
+	int stopped;
+
+	if (jobs > n / PARALLEL_MIN_ENTRIES)
+		jobs = n / PARALLEL_MIN_ENTRIES;
+	if (jobs < 2 || (ctx->opt.flags & FLAG_BATCH) || dmi_oem_ordered(ctx)
+	 || (ctx->opt.format == OUTPUT_KEYVALUE
+	  && (ctx->opt.flags & FLAG_QUIET)))
+		return -1;
+
+	if ((part = arena_calloc(ctx->arena, jobs, sizeof(*part))) == NULL)
+		return -1;
+
+	for (i = 0; i < jobs; i++)
+	{
+		struct dmi_part *p = &part[i];
+
+		p->first = (unsigned long long)n * i / jobs;
+		p->last = (unsigned long long)n * (i + 1) / jobs;
+		if (i == 0)
+			continue;
+
+		p->ctx = *ctx;
+		p->ctx.stats = ctx->stats != NULL ? &p->stats : NULL;
+		p->t = t;
+		p->visit = visit;
+		p->buf = buf;
+		p->len = len;
+		p->ver = ver;
+		p->changed = changed;
+		p->started = pthread_create(&p->thread, NULL, dmi_part_worker,
+					    p) == 0;
+	}
+
+	stopped = dmi_table_decode_range(ctx, t, visit, part[0].first,
+					 part[0].last, buf, len, ver,
+					 changed) < 0;
+	for (i = 1; i < jobs; i++)
+	{
+		struct dmi_part *p = &part[i];
+
+		if (!p->started)
+		{
+			if (!stopped)
+				stopped = dmi_table_decode_range(ctx, t, visit,
+						p->first, p->last, buf, len,
+						ver, changed) < 0;
+			continue;
+		}
+
+		pthread_join(p->thread, NULL);
+		if (!stopped)
+		{
+			pr_part_write(&p->out);
+			if (ctx->stats != NULL)
+				dmi_stats_add(ctx->stats, &p->stats);
+			stopped = p->stopped;
+		}
+		free(p->out.buf);
+	}
+
+	arena_free(ctx->arena, part);
+	return 0;
+}
+#endif
+
+static void dmi_table_decode(struct dmi_context *ctx, u8 *buf, u32 len,
+			     u16 num, u16 ver, u32 flags,
+			     const struct dmi_snapshot *snap)
+{
+	struct dmi_table_index t;
+	struct dmi_strings strings;
+	u32 *visit;
+	u8 *changed = NULL, *matched = NULL;
+	u32 differ = 0;
+	const char *vendor = NULL, *product = NULL;
+	int quiet = ctx->opt.flags & FLAG_QUIET;
+	int stop_at_eot = quiet || (flags & FLAG_STOP_AT_EOT);
+	u32 end, n, i;
+
+	if ((snap == NULL || dmi_snapshot_index(&t, snap, stop_at_eot) != 0)
+	 && dmi_cache_index(ctx->cache, &t, num, stop_at_eot) != 0)
+	{
+		struct dmi_query q;
+		int keep;
+
+		/*
+		 * A partial index only answers this query, so only the index
+		 * of a whole walk is handed over to the cache, and outlives
+		 * the run.
+		 */
+		dmi_query_init(&q, ctx);
+		keep = ctx->cache != NULL && !q.active;
+		if (dmi_table_scan(&t, buf, len, num, stop_at_eot, &q,
+				   keep ? NULL : ctx->arena) < 0)
+			return;
+		if (dmi_table_index_build(&t) < 0)
+		{
+			arena_free(t.arena, t.entry);
+			return;
+		}
+		if (keep)
+			dmi_cache_keep_index(ctx->cache, &t, num, stop_at_eot);
+	}
+	visit = arena_alloc(ctx->arena, (t.count ? t.count : 1) * sizeof(u32));
+	if (visit == NULL)
+	{
+		perror(u"malloc");
+		goto out;
+	}
+
+	/* Save the vendor so that so that we can decode OEM types */
+	for (i = t.type_start[1]; i < t.type_start[2]; i++)
+	{
+		const struct dmi_entry *e = &t.entry[t.by_type[i]];
+		struct dmi_header h;
+
+		if (e->next > len)
+			continue;
+
+		if (e->length >= 6)
+		{
+			to_dmi_header(&h, buf + e->offset, &strings);
+			vendor = _dmi_string(&h, h.data[0x04], 0);
+			product = _dmi_string(&h, h.data[0x05], 0);
+			break;
+		}
+	}
+	dmi_set_vendor(ctx, vendor, product);
+	if (ctx->stats != NULL)
+	{
+		for (i = 0; i < 256; i++)
+			ctx->stats->type[i].count = t.type_start[i + 1]
+						  - t.type_start[i];
+		dmi_stats_phase(ctx->stats, STATS_INDEX);
+	}
+
+	if (ctx->opt.string != NULL)
+	{
+		dmi_table_strings(ctx, &t, buf, len, ver);
+		goto out_free;
+	}
+
+	if (ctx->opt.flags & FLAG_MEMORY)
+	{
+		dmi_memory_summary(ctx, &t, buf, len);
+		goto out_free;
+	}
+
+	/* Compared before decoding filters the strings */
+	if (ctx->baseline != NULL)
+	{
+		changed = arena_alloc(ctx->arena, t.count + 1);
+		matched = arena_calloc(ctx->arena,
+				       ctx->baseline->index.count + 1, 1);
+		if (changed == NULL || matched == NULL)
+		{
+			perror(u"malloc");
+			goto out_free;
+		}
+		differ = dmi_baseline_compare(ctx->baseline, &t, buf, len,
+					      changed, matched);
+	}
+
+	/* Actually decode the data */
+	n = dmi_table_select(ctx, &t, visit);
+#ifdef USE_PTHREAD
+	if (dmi_table_decode_parallel(ctx, &t, visit, n, buf, len, ver,
+				      changed) < 0)
+#endif
+		dmi_table_decode_range(ctx, &t, visit, 0, n, buf, len, ver,
+				       changed);
+
+	if (changed != NULL)
+	{
+		differ += dmi_baseline_removed(ctx->baseline, matched);
+		if (differ == 0)
+		{
+			if (!quiet)
+				pr_info(u"No entry changed since %s.",
+					dmi_baseline_name(ctx));
+			ctx->unchanged = 1;
+		}
+	}
+
+	/*
+	 * If a short entry was found, let the user know his/her table is
+	 * broken.
+	 */
+	end = t.count ? t.entry[t.count - 1].next : 0;
+	if (t.status == DMI_SCAN_SHORT && !quiet)
+	{
+		pr_info(u"Invalid entry length (%u). DMI table "
+			u"is broken! Stop.",
+			(unsigned int)buf[end + 1]);
+		pr_sep();
+		quiet = 1;
+	}
+
+	/*
+	 * SMBIOS v3 64-bit entry points do not announce a structures count,
+	 * and only indicate a maximum size for the table. Nothing can be
+	 * told about the structures beyond an early exit.
+	 */
+	if (!quiet && t.status != DMI_SCAN_PARTIAL)
+	{
+		if (num && t.count != num)
+			pr_info(u"Wrong DMI structures count: %d announced, "
+				u"only %d decoded.", num, t.count);
+		if (end > len || (num && end < len))
+			pr_info(u"Wrong DMI structures length: %u bytes "
+				u"announced, structures occupy %lu bytes.",
+				len, (unsigned long)end);
+	}
+
+out_free:
+	arena_free(ctx->arena, visit);
+out:
+	dmi_table_index_free(&t);
+}
+
+/* Set the vendor from the type 1 structure at buf, in streaming mode */
+static void dmi_stream_set_vendor(struct dmi_context *ctx, u8 *buf,
+				  char **product)
+{
+	struct dmi_strings strings;
+	struct dmi_header h;
+	const char *s;
+
+	/* The buffer moves, the vendor decoders need a copy */
+	to_dmi_header(&h, buf, &strings);
+	s = _dmi_string(&h, h.data[0x05], 0);
+	if (s != NULL
+	 && (*product = arena_alloc(ctx->arena, strlen(s) + 1)) != NULL)
+		strcpy(*product, s);
+	dmi_set_vendor(ctx, _dmi_string(&h, h.data[0x04], 0), *product);
+}
+
+/*
+ * Before an OEM structure is decoded in streaming mode, look for the type 1
+ * structure further in the buffer, from *ahead on, so that the vendor is
+ * the same as when decoding the whole table. Returns 0 if more of the table
+ * must be read first, 1 once the vendor is set or the table is known not
+ * to tell it.
+ */
+static int dmi_stream_find_vendor(struct dmi_context *ctx, u8 *buf,
+				  u32 *ahead, u32 avail, int eof,
+				  char **product)
+{
+	u32 next;
+
+	while (avail - *ahead >= 4 && buf[*ahead + 1] >= 4)
+	{
+		next = dmi_entry_next(buf, *ahead, *ahead, avail);
+		if (next > avail)
+			break;
+		if (buf[*ahead] == 1 && buf[*ahead + 1] >= 6)
+		{
+			dmi_stream_set_vendor(ctx, buf + *ahead, product);
+			return 1;
+		}
+		if (buf[*ahead] == 127)
+			return 1;
+		*ahead = next;
+	}
+
+	/* A broken structure ends the table walk as well */
+	return eof || (avail - *ahead >= 4 && buf[*ahead + 1] < 4);
+}
+
+/*
+ * Streaming decode: SMBIOS 3 entry points only give a maximum size for the
+ * table, which may be much larger than the table itself. Such tables are
+ * read STREAM_CHUNK_SIZE bytes at a time, and every structure is decoded
+ * as soon as it is complete, so the output starts right away and memory
+ * use is bounded by the chunk size (or by the largest structure), not by
+ * the announced size. OEM structures met before type 1 are held back until
+ * type 1 is read, as they can only be decoded once the vendor is known.
+ * Reading stops at the end-of-table marker. Only used when nothing needs
+ * the whole table at once, see dmi_table().
+ */
+static void dmi_table_stream(struct dmi_context *ctx, off_t base, u32 len,
+			     u16 ver, const char *devmem, u32 flags)
+{
+	u8 *buf, *p;
+	char *product = NULL;
+	size_t size = STREAM_CHUNK_SIZE, avail = 0, n;
+	u32 read = 0;		/* Table bytes read so far */
+	u32 off = 0;		/* Current structure, in buf */
+	u32 next = 0;
+	u32 scan = 0;		/* Searched so far for the strings end, from off */
+	u32 ahead = 0;		/* Searched so far for type 1, in buf */
+	int vendor = 0, eof = 0, truncated = 0;
+	struct dmi_query q;
+
+	if ((buf = arena_alloc(ctx->arena, size)) == NULL)
+	{
+		perror(u"malloc");
+		return;
+	}
+	if (flags & FLAG_NO_FILE_OFFSET)
+		base = 0;
+
+	/* Until a type 1 structure tells better */
+	dmi_set_vendor(ctx, NULL, NULL);
+	dmi_query_init(&q, ctx);
+
+	for (;;)
+	{
+		if (avail - off >= 4 && buf[off + 1] < 4)
+		{
+			if (!(ctx->opt.flags & FLAG_QUIET))
+			{
+				pr_info(u"Invalid entry length (%u). DMI table "
+					u"is broken! Stop.",
+					(unsigned int)buf[off + 1]);
+				pr_sep();
+			}
+			break;
+		}
+
+		next = avail - off >= 4 ? dmi_entry_next(buf, off, off + scan,
+							 avail)
+					: avail + 1;
+		if (next <= avail && !vendor && buf[off] >= 128)
+		{
+			if (ahead < off)
+				ahead = off;
+			vendor = dmi_stream_find_vendor(ctx, buf, &ahead,
+							avail, eof, &product);
+		}
+		if ((next > avail || (!vendor && buf[off] >= 128)) && !eof)
+		{
+			/*
+			 * Keep the partial structure, or everything from the
+			 * OEM structure on while looking for type 1, and read
+			 * the next chunk. The last byte may start the double
+			 * NUL, so it is searched again.
+			 */
+			if (next > avail && avail - off >= 4)
+				scan = avail - 1 - off;
+			ahead = ahead > off ? ahead - off : 0;
+			avail -= off;
+			if (off != 0)
+				memmove(buf, buf + off, avail);
+			off = 0;
+			if (avail + STREAM_CHUNK_SIZE > size)
+			{
+				p = arena_realloc(ctx->arena, buf, avail,
+						  2 * size);
+				if (p == NULL)
+				{
+					perror(u"realloc");
+					break;
+				}
+				buf = p;
+				size *= 2;
+			}
+
+			n = len - read < STREAM_CHUNK_SIZE ? len - read
+							   : STREAM_CHUNK_SIZE;
+			if (n && mem_read(base + read, buf + avail, &n,
+					  devmem) != 0)
+			{
+				pr_info(u"Failed to read table, sorry.");
+				break;
+			}
+			read += n;
+			avail += n;
+			if (n == 0 || read == len)
+				eof = 1;
+			continue;
+		}
+		if (avail - off < 4)
+			break;
+
+		if (buf[off] == 1 && !vendor && buf[off + 1] >= 6 && next <= avail)
+		{
+			dmi_stream_set_vendor(ctx, buf + off, &product);
+			vendor = 1;
+		}
+
+		if (ctx->stats != NULL)
+			ctx->stats->type[buf[off]].count++;
+		truncated = next > avail;
+		if (dmi_table_decode_entry(ctx, buf + off, ver, truncated,
+					   DMI_DIFF_CHANGED) < 0)
+			break;
+		if (buf[off] == 127
+		 || dmi_query_seen(&q, buf[off]))
+			break;
+		off = next;
+		scan = 0;
+	}
+
+	if (truncated && !(ctx->opt.flags & FLAG_QUIET))
+		pr_info(u"Wrong DMI structures length: %u bytes "
+			u"announced, structures occupy %lu bytes.",
+			read, (unsigned long)(read - avail + next));
+
+	dmi_set_vendor(ctx, NULL, NULL);
+	arena_free(ctx->arena, product);
+	arena_free(ctx->arena, buf);
+}
+
+/*
+ * Bytes of the table at data up to the end-of-table marker, or up to the
+ * header of the first invalid structure, so that it is still reported.
+ * Never more than len.
+ */
+static u32 dmi_table_length(const u8 *data, u32 len)
+{
+	u32 off = 0, next;
+
+	while (off + 4 <= len)
+	{
+		if (data[off + 1] < 4)
+			return off + 4;
+		next = dmi_entry_next(data, off, off, len);
+		if (data[off] == 127 || next >= len)
+			return next < len ? next : len;
+		off = next;
+	}
+	return len;
+}
+
+static void dmi_table(struct dmi_context *ctx, off_t base, u32 len, u16 num,
+		      u32 ver, const char *devmem, u32 flags,
+		      const struct dmi_snapshot *snap)
+{
+	struct mem_view view;
+	u32 announced = len;
+	size_t size;
+	u8 *data;
+	u8 source;
+	int viewed = 0, copied = 0, prefetched;
+
+	dmi_stats_phase(ctx->stats, STATS_DISCOVERY);
+
+	if (ver > SUPPORTED_SMBIOS_VER && !(ctx->opt.flags & FLAG_QUIET))
+	{
+		pr_comment(u"SMBIOS implementations newer than version %u.%u.%u are not",
+			   SUPPORTED_SMBIOS_VER >> 16,
+			   (SUPPORTED_SMBIOS_VER >> 8) & 0xFF,
+			   SUPPORTED_SMBIOS_VER & 0xFF);
+		pr_comment(u"fully supported by this version of dmidecode.");
+	}
+
+	if (!(ctx->opt.flags & FLAG_QUIET))
+	{
+		if (ctx->opt.type == NULL)
+		{
+			if (num)
+				pr_info(u"%u structures occupying %u bytes.",
+					num, len);
+			if (!(ctx->opt.flags & FLAG_FROM_DUMP))
+				pr_info(u"Table at 0x%08llX.",
+					(unsigned long long)base);
+		}
+		pr_sep();
+	}
+
+	/*
+	 * When reading from sysfs or from a dump file, the file may be
+	 * shorter than announced. For SMBIOS v3 this is expcted, as we
+	 * only know the maximum table size, not the actual table size.
+	 * For older implementations (and for SMBIOS v3 too), this
+	 * would be the result of the kernel truncating the table on
+	 * parse error.
+	 */
+	/* The sysfs table may be read already, see dmi_run() */
+	prefetched = snap == NULL && ctx->prefetch != NULL
+		  && (flags & FLAG_NO_FILE_OFFSET)
+		  && strcmp(devmem, ctx->prefetch->filename) == 0;
+
+	/*
+	 * Oversized SMBIOS 3 tables are streamed, unless the whole table is
+	 * needed: to be kept (library contexts, --cache, --watch), written
+	 * out, compared with a baseline, searched for strings or summarized,
+	 * or was read ahead. A table in memory already, such as the EFI
+	 * configuration table, is cut to its structures instead.
+	 */
+	if (snap == NULL && !prefetched && num == 0 && len > STREAM_CHUNK_SIZE
+	 && !(flags & FLAG_IN_MEMORY) && ctx->cache == NULL && ctx->opt.cache_file == NULL
+	 && ctx->opt.watch == 0
+	 && ctx->baseline == NULL && ctx->opt.string == NULL
+	 && !(ctx->opt.flags & (FLAG_DUMP_BIN | FLAG_MEMORY)))
+	{
+		dmi_stats_access(ctx->stats, u"streamed");
+		dmi_table_stream(ctx, base, len, ver >> 8, devmem, flags);
+		dmi_stats_phase(ctx->stats, STATS_DECODE);
+		return;
+	}
+
+	if (snap != NULL)
+	{
+		/* The table was read along with the snapshot */
+		data = snap->table;
+		size = snap->table_len;
+		dmi_stats_access(ctx->stats, u"snapshot");
+	}
+	else if (prefetched
+	      && (data = file_prefetch_wait(ctx->prefetch, &size)) != NULL)
+	{
+		if (size > (size_t)len)
+			size = len;
+		dmi_stats_access(ctx->stats, u"read ahead");
+	}
+	else if (flags & FLAG_IN_MEMORY)
+	{
+		/*
+		 * Decoding filters the strings, the firmware's copy stays.
+		 * Only the structures are copied, not the whole maximum
+		 * size of SMBIOS 3.
+		 */
+		size = num ? len : dmi_table_length((const u8 *)(uintptr_t)base,
+						    len);
+		if ((data = arena_alloc(ctx->arena, size ? size : 1)) == NULL)
+		{
+			perror(u"malloc");
+			return;
+		}
+		memcpy(data, (const u8 *)(uintptr_t)base, size);
+		copied = 1;
+		dmi_stats_access(ctx->stats, u"copied");
+	}
+	else if ((data = dmi_cache_lookup(ctx->cache, base, len, devmem, flags,
+					  &size)) != NULL)
+		dmi_stats_access(ctx->stats, u"cached");
+	else
+	{
+		size = len;
+		if (mem_view(&view, flags & FLAG_NO_FILE_OFFSET ? 0 : base,
+			     &size, devmem, ctx->arena) != 0)
+		{
+			pr_info(u"Failed to read table, sorry.");
+#ifndef USE_MMAP
+			if (!(flags & FLAG_NO_FILE_OFFSET))
+				pr_info(u"Try compiling dmidecode with -DUSE_MMAP.");
+#endif
+			return;
+		}
+		data = view.data;
+		viewed = 1;
+		dmi_stats_access(ctx->stats, view.map != NULL ? u"mapped"
+							      : u"read");
+		dmi_cache_store(ctx->cache, base, len, devmem, flags, data,
+				size);
+	}
+	if (!(ctx->opt.flags & FLAG_QUIET) && num && size != (size_t)len)
+	{
+		pr_info(u"Wrong DMI structures length: %u bytes "
+			u"announced, only %lu bytes available.",
+			len, (unsigned long)size);
+	}
+	len = size;
+	dmi_stats_phase(ctx->stats, STATS_READ);
+
+	if (flags & FLAG_NO_FILE_OFFSET)
+		source = SNAP_SRC_SYSFS;
+	else if (flags & FLAG_IN_MEMORY)
+		source = SNAP_SRC_EFI_TABLE;
+	else if (flags & FLAG_FROM_EFI)
+		source = SNAP_SRC_EFI;
+	else
+		source = SNAP_SRC_MEMORY;
+
+	/*
+	 * Saved before decoding, which filters the strings in place. A table
+	 * already in memory is cheaper to read again than a cache file.
+	 */
+	if (ctx->opt.cache_file != NULL && snap == NULL
+	 && !(flags & FLAG_IN_MEMORY))
+		ctx->cache_update = dmi_table_snapshot(ctx, data, len, announced,
+						       num, ver, base, flags,
+						       source,
+						       ctx->opt.cache_file) == 0;
+
+	if (ctx->baseline != NULL && len == ctx->baseline->len
+	 && memcmp(data, ctx->baseline->table, len) == 0)
+	{
+		if (!(ctx->opt.flags & FLAG_QUIET))
+			pr_info(u"Table unchanged since %s.",
+				dmi_baseline_name(ctx));
+		ctx->unchanged = 1;
+	}
+	else if (ctx->opt.flags & FLAG_SNAPSHOT)
+		dmi_table_snapshot(ctx, data, len, announced, num, ver, base, flags,
+				   source, ctx->opt.dumpfile);
+	else if (ctx->opt.flags & FLAG_DUMP_BIN)
+		dmi_table_dump(ctx, data, len);
+	else if (ctx->opt.watch)
+	{
+		/* The first poll only keeps the table, see dmi_watch() */
+		dmi_baseline_free(ctx->polled);
+		ctx->polled = dmi_baseline_copy(data, len, num);
+		if (ctx->baseline != NULL)
+			dmi_table_decode(ctx, data, len, num, ver >> 8, flags,
+					 snap);
+	}
+	else
+		dmi_table_decode(ctx, data, len, num, ver >> 8, flags, snap);
+
+	if (viewed)
+		mem_view_release(&view);
+	if (copied)
+		arena_free(ctx->arena, data);
+	if (ctx->cache != NULL)
+		ctx->cache->current = 0;
+	dmi_stats_phase(ctx->stats, STATS_DECODE);
+}
+
+
+/*
+ * Build a crafted entry point with table address hard-coded to 32,
+ * as this is where we will put it in the output file. We adjust the
+ * DMI checksum appropriately. The SMBIOS checksum needs no adjustment.
+ */
+static void overwrite_dmi_address(u8 *buf)
+{
+	buf[0x05] += buf[0x08] + buf[0x09] + buf[0x0A] + buf[0x0B] - 32;
+	buf[0x08] = 32;
+	buf[0x09] = 0;
+	buf[0x0A] = 0;
+	buf[0x0B] = 0;
+}
+
+/* Same thing for SMBIOS3 entry points */
+static void overwrite_smbios3_address(u8 *buf)
+{
+	buf[0x05] += buf[0x10] + buf[0x11] + buf[0x12] + buf[0x13]
+		   + buf[0x14] + buf[0x15] + buf[0x16] + buf[0x17] - 32;
+	buf[0x10] = 32;
+	buf[0x11] = 0;
+	buf[0x12] = 0;
+	buf[0x13] = 0;
+	buf[0x14] = 0;
+	buf[0x15] = 0;
+	buf[0x16] = 0;
+	buf[0x17] = 0;
+}
+
+/*
+ * Add the crafted entry point to what dmi_table() wrote: the dump or
+ * snapshot file, and the cache file if it was just refreshed.
+ */
+static void dmi_write_ep(struct dmi_context *ctx, const u8 *crafted, u8 len)
+{
+	if (ctx->opt.flags & FLAG_DUMP_BIN)
+	{
+		if (!(ctx->opt.flags & FLAG_QUIET))
+			pr_comment(u"Writing %d bytes to %s.", len,
+				   ctx->opt.dumpfile);
+		write_dump(ctx->opt.flags & FLAG_SNAPSHOT ? SNAP_EP_OFFSET : 0,
+			   len, crafted, ctx->opt.dumpfile, 1);
+	}
+
+	if (ctx->cache_update)
+	{
+		write_dump(SNAP_EP_OFFSET, len, crafted, ctx->opt.cache_file, 1);
+		ctx->cache_update = 0;
+	}
+}
+
+static int smbios3_decode(struct dmi_context *ctx, u8 *buf, const char *devmem,
+			  u32 flags, const struct dmi_snapshot *snap)
+{
+	u32 ver;
+	u64 offset;
+
+	/* Don't let checksum run beyond the buffer */
+	if (buf[0x06] > 0x20)
+	{
+		pr_info(u"Entry point length too large (%u bytes, expected %u).",
+			(unsigned int)buf[0x06], 0x18U);
+		return 0;
+	}
+
+	if (!checksum(buf, buf[0x06]))
+		return 0;
+
+	ver = (buf[0x07] << 16) + (buf[0x08] << 8) + buf[0x09];
+	if (!(ctx->opt.flags & FLAG_QUIET))
+		pr_info(u"SMBIOS %u.%u.%u present.",
+			buf[0x07], buf[0x08], buf[0x09]);
+
+	offset = QWORD(buf + 0x10);
+	if (!(flags & FLAG_NO_FILE_OFFSET) && offset.h && sizeof(off_t) < 8)
+	{
+		pr_info(u"64-bit addresses not supported, sorry.");
+		return 0;
+	}
+
+	dmi_table(ctx, ((off_t)offset.h << 32) | offset.l,
+		  DWORD(buf + 0x0C), 0, ver, devmem, flags | FLAG_STOP_AT_EOT, snap);
+
+	if ((ctx->opt.flags & FLAG_DUMP_BIN) || ctx->cache_update)
+	{
+		u8 crafted[32];
+
+		memcpy(crafted, buf, 32);
+		overwrite_smbios3_address(crafted);
+		dmi_write_ep(ctx, crafted, crafted[0x06]);
+	}
+
+	return 1;
+}
+
+static int smbios_decode(struct dmi_context *ctx, u8 *buf, const char *devmem,
+			 u32 flags, const struct dmi_snapshot *snap)
+{
+	u16 ver;
+
+	/* Don't let checksum run beyond the buffer */
+	if (buf[0x05] > 0x20)
+	{
+		pr_info(u"Entry point length too large (%u bytes, expected %u).",
+			(unsigned int)buf[0x05], 0x1FU);
+		return 0;
+	}
+
+	if (!checksum(buf, buf[0x05])
+	 || memcmp(buf + 0x10, u"_DMI_", 5) != 0
+	 || !checksum(buf + 0x10, 0x0F))
+		return 0;
+
+	ver = (buf[0x06] << 8) + buf[0x07];
+	/* Some BIOS report weird SMBIOS version, fix that up */
+	switch (ver)
+	{
+		case 0x021F:
+		case 0x0221:
+			if (!(ctx->opt.flags & FLAG_QUIET))
+				pr_info(u"SMBIOS version fixup (2.%d -> 2.%d).",
+					ver & 0xFF, 3);
+			ver = 0x0203;
+			break;
+		case 0x0233:
+			if (!(ctx->opt.flags & FLAG_QUIET))
+				pr_info(u"SMBIOS version fixup (2.%d -> 2.%d).",
+					51, 6);
+			ver = 0x0206;
+			break;
+	}
+	if (!(ctx->opt.flags & FLAG_QUIET))
+		pr_info(u"SMBIOS %u.%u present.",
+			ver >> 8, ver & 0xFF);
+
+	dmi_table(ctx, DWORD(buf + 0x18), WORD(buf + 0x16), WORD(buf + 0x1C),
+		ver << 8, devmem, flags, snap);
+
+	if ((ctx->opt.flags & FLAG_DUMP_BIN) || ctx->cache_update)
+	{
+		u8 crafted[32];
+
+		memcpy(crafted, buf, 32);
+		overwrite_dmi_address(crafted + 0x10);
+		dmi_write_ep(ctx, crafted, crafted[0x05]);
+	}
+
+	return 1;
+}
+
+static int legacy_decode(struct dmi_context *ctx, u8 *buf, const char *devmem,
+			 u32 flags, const struct dmi_snapshot *snap)
 {
-	u16 ver;
+	if (!checksum(buf, 0x0F))
+		return 0;
+
+	if (!(ctx->opt.flags & FLAG_QUIET))
+		pr_info(u"Legacy DMI %u.%u present.",
+			buf[0x0E] >> 4, buf[0x0E] & 0x0F);
+
+	dmi_table(ctx, DWORD(buf + 0x08), WORD(buf + 0x06), WORD(buf + 0x0C),
+		((buf[0x0E] & 0xF0) << 12) + ((buf[0x0E] & 0x0F) << 8),
+		devmem, flags, snap);
+
+	if ((ctx->opt.flags & FLAG_DUMP_BIN) || ctx->cache_update)
+	{
+		u8 crafted[16];
+
+		memcpy(crafted, buf, 16);
+		overwrite_dmi_address(crafted);
+		dmi_write_ep(ctx, crafted, 0x0F);
+	}
+
+	return 1;
+}
+
+/*
+ * Decode a snapshot file written by --snapshot, straight from a mapping
+ * of the file. Returns 1 if a valid entry point was found and decoded,
+ * 0 otherwise.
+ */
+static int dmi_snapshot_decode(struct dmi_context *ctx, const char *filename)
+{
+	struct dmi_snapshot snap;
+	struct mem_view view;
+	size_t size = ~(size_t)0;
+	int found = 0;
+
+	if (mem_view(&view, 0, &size, filename, ctx->arena) != 0)
+		return 0;
+
+	if (dmi_snapshot_open(&snap, view.data, size) != 0)
+	{
+		pr_info(u"%s: Invalid snapshot file", filename);
+		goto out;
+	}
+
+	if (!(ctx->opt.flags & FLAG_QUIET))
+		pr_info(u"Snapshot of SMBIOS/DMI data read from %s.",
+			dmi_snapshot_source(snap.source));
+
+	if (memcmp(snap.ep, "_SM3_", 5) == 0)
+		found = smbios3_decode(ctx, snap.ep, filename,
+				       FLAG_NO_FILE_OFFSET, &snap);
+	else if (memcmp(snap.ep, "_SM_", 4) == 0)
+		found = smbios_decode(ctx, snap.ep, filename,
+				      FLAG_NO_FILE_OFFSET, &snap);
+	else if (memcmp(snap.ep, "_DMI_", 5) == 0)
+		found = legacy_decode(ctx, snap.ep, filename,
+				      FLAG_NO_FILE_OFFSET, &snap);
+
+out:
+	mem_view_release(&view);
+	return found;
+}
+
+/*
+ * Probe for EFI interface
+ */
+#define EFI_NOT_FOUND   (-1)
+#define EFI_NO_SMBIOS   (-2)
+static int address_from_efi(struct dmi_context *ctx, off_t *address)
+{
+#if defined(__linux__)
+	FILE *efi_systab;
+	const char *filename;
+	char linebuf[64];
+#elif defined(__FreeBSD__)
+	char addrstr[KENV_MVALLEN + 1];
+#endif
+	const char *eptype;
+	int ret;
+
+	*address = 0; /* Prevent compiler warning */
+
+#if defined(__linux__)
+	/*
+	 * Linux up to 2.6.6: /proc/efi/systab
+	 * Linux 2.6.7 and up: /sys/firmware/efi/systab
+	 */
+	if ((efi_systab = fopen(filename = u"/sys/firmware/efi/systab", u"r")) == NULL
+	 && (efi_systab = fopen(filename = u"/proc/efi/systab", u"r")) == NULL)
+	{
+		/* No EFI interface, fallback to memory scan */
+		return EFI_NOT_FOUND;
+	}
+	ret = EFI_NO_SMBIOS;
+	while ((fgets(linebuf, sizeof(linebuf) - 1, efi_systab)) != NULL)
+	{
+		char *addrp = strchr(linebuf, '=');
+		*(addrp++) = '\0';
+		if (strcmp(linebuf, u"SMBIOS3") == 0
+		 || strcmp(linebuf, u"SMBIOS") == 0)
+		{
+			*address = strtoull(addrp, NULL, 0);
+			eptype = linebuf;
+			ret = 0;
+			break;
+		}
+	}
+	if (fclose(efi_systab) != 0)
+		perror(filename);
+
+	if (ret == EFI_NO_SMBIOS)
+		pr_info(u"%s: SMBIOS entry point missing", filename);
+#elif defined(__FreeBSD__)
+	/*
+	 * On FreeBSD, SMBIOS anchor base address in UEFI mode is exposed
+	 * via kernel environment:
+	 * https://svnweb.freebsd.org/base?view=revision&revision=307326
+	 */
+	ret = kenv(KENV_GET, u"hint.smbios.0.mem", addrstr, sizeof(addrstr));
+	if (ret == -1)
+	{
+		if (errno != ENOENT)
+			perror(u"kenv");
+		return EFI_NOT_FOUND;
+	}
+
+	*address = strtoull(addrstr, NULL, 0);
+	eptype = u"SMBIOS";
+	ret = 0;
+#else
+	ret = EFI_NOT_FOUND;
+#endif
+
+	if (ret == 0 && !(ctx->opt.flags & FLAG_QUIET))
+		pr_comment(u"%s entry point at 0x%08llx",
+			   eptype, (unsigned long long)*address);
+
+	return ret;
+}
+
+/*
+ * Persistent cache (--cache): every live run saves a snapshot of the
+ * table, along with where its entry point was found. The next runs only
+ * read that entry point again, and if it is still identical, decode the
+ * saved table instead of going through sysfs, EFI or the memory scan.
+ * A table changed behind an unchanged entry point goes unnoticed, the
+ * cache file must be removed then.
+ * Returns 1 if the saved table was decoded, 0 if it must be read again.
+ */
+static int dmi_cache_file_decode(struct dmi_context *ctx)
+{
+	struct dmi_snapshot snap;
+	size_t size = ~(size_t)0;
+	const char *devmem = ctx->opt.devmem;
+	u8 crafted[32], ep[0x20];
+	u8 *data, *buf = NULL;
+	unsigned long long base;
+	u32 flags = 0;
+	u8 len;
+	int found = 0;
+
+	if ((data = read_file(0, &size, ctx->opt.cache_file,
+			      ctx->arena)) == NULL)
+		return 0;
+	if (dmi_snapshot_open(&snap, data, size) != 0)
+		goto out;
+
+	ctx->ep_address = DWORD(data + 0x30)
+			| (unsigned long long)DWORD(data + 0x34) << 32;
+	switch (snap.source)
+	{
+		case SNAP_SRC_SYSFS:
+			if (ctx->opt.flags & FLAG_NO_SYSFS)
+				goto out;
+			size = 0x20;
+			buf = read_file(0, &size, SYS_ENTRY_FILE, ctx->arena);
+			devmem = SYS_TABLE_FILE;
+			flags = FLAG_NO_FILE_OFFSET;
+			break;
+		case SNAP_SRC_EFI:
+			flags = FLAG_FROM_EFI;
+			/* fall through */
+		case SNAP_SRC_MEMORY:
+			size = 0x20;
+			buf = mem_chunk(ctx->ep_address, 0x20, devmem,
+					ctx->arena);
+			break;
+	}
+	if (buf == NULL)
+		goto out;
+
+	/* The sysfs entry point file may be shorter than 32 bytes */
+	memset(ep, 0, sizeof(ep));
+	memcpy(ep, buf, size < sizeof(ep) ? size : sizeof(ep));
+
+	/* Compare with the crafted copy saved along with the table */
+	memcpy(crafted, ep, 32);
+	if (memcmp(ep, "_SM3_", 5) == 0 && ep[0x06] <= 0x20)
+	{
+		base = QWORD(ep + 0x10).l
+		     | (unsigned long long)QWORD(ep + 0x10).h << 32;
+		overwrite_smbios3_address(crafted);
+		len = ep[0x06];
+	}
+	else if (memcmp(ep, "_SM_", 4) == 0 && ep[0x05] <= 0x20)
+	{
+		base = DWORD(ep + 0x18);
+		overwrite_dmi_address(crafted + 0x10);
+		len = ep[0x05];
+	}
+	else if (memcmp(ep, "_DMI_", 5) == 0)
+	{
+		base = DWORD(ep + 0x08);
+		overwrite_dmi_address(crafted);
+		len = 0x0F;
+	}
+	else
+		goto out;
+	if (memcmp(crafted, snap.ep, len) != 0
+	 || base != (DWORD(data + 0x28)
+		   | (unsigned long long)DWORD(data + 0x2C) << 32))
+		goto out;
+
+	if (!(ctx->opt.flags & FLAG_QUIET))
+	{
+		/* Same messages as when reading the table from its source */
+		if (snap.source == SNAP_SRC_SYSFS)
+			pr_info(u"Getting SMBIOS data from sysfs.");
+		else if (snap.source == SNAP_SRC_EFI)
+		{
+			pr_comment(u"%s entry point at 0x%08llx",
+				   ep[3] == '3' ? u"SMBIOS3" : u"SMBIOS",
+				   ctx->ep_address);
+			pr_info(u"Found SMBIOS entry point in EFI, reading table from %s.",
+				devmem);
+		}
+		else
+			pr_info(u"Scanning %s for entry point.", devmem);
+	}
+
+	if (ep[1] == 'S')
+		found = ep[3] == '3'
+		      ? smbios3_decode(ctx, ep, devmem, flags, &snap)
+		      : smbios_decode(ctx, ep, devmem, flags, &snap);
+	else
+		found = legacy_decode(ctx, ep, devmem, flags, &snap);
+
+out:
+	arena_free(ctx->arena, buf);
+	arena_free(ctx->arena, data);
+	return found;
+}
+
+#if defined __i386__ || defined __x86_64__
+/*
+ * Look for an entry point in the 64 kB legacy BIOS area. Anchors are
+ * paragraph-aligned, and their first 4 bytes are enough to tell them
+ * apart, so a single word comparison per paragraph finds all candidates
+ * in one pass. 64-bit entry points are tried first, as they are found.
+ * The 32-bit and legacy ones are only tried, in address order, if no
+ * valid 64-bit entry point exists.
+ * Returns 1 if a valid entry point was found and decoded, 0 otherwise.
+ */
+static int scan_memory(struct dmi_context *ctx, const u8 *buf)
+{
+	const u32 anchor_sm3 = DWORD((const u8 *)"_SM3");
+	const u32 anchor_sm = DWORD((const u8 *)"_SM_");
+	const u32 anchor_dmi = DWORD((const u8 *)"_DMI");
+	u16 candidate[0x10000 / 16];
+	unsigned int n = 0, i;
+	u32 fp;
+
+	for (fp = 0; fp <= 0xFFF0; fp += 16)
+	{
+		u32 anchor = DWORD(buf + fp);
+
+		if (anchor == anchor_sm3)
+		{
+			ctx->ep_address = 0xF0000 + fp;
+			if (fp <= 0xFFE0 && buf[fp + 4] == '_'
+			 && smbios3_decode(ctx, (u8 *)buf + fp, ctx->opt.devmem,
+					   0, NULL))
+				return 1;
+		}
+		else if ((anchor == anchor_sm && fp <= 0xFFE0)
+		      || (anchor == anchor_dmi && buf[fp + 4] == '_'))
+			candidate[n++] = fp;
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		u8 *p = (u8 *)buf + candidate[i];
+
+		ctx->ep_address = 0xF0000 + candidate[i];
+		if (p[1] == 'S' ? smbios_decode(ctx, p, ctx->opt.devmem, 0, NULL)
+				: legacy_decode(ctx, p, ctx->opt.devmem, 0, NULL))
+			return 1;
+	}
+
+	return 0;
+}
+#endif
+
+/*
+ * Decode a dump file, as written by --dump-bin or --snapshot.
+ * Returns 1 if a valid entry point was found and decoded, 0 if not, -1
+ * if the file couldn't be read.
+ */
+static int dmi_decode_dump(struct dmi_context *ctx, const char *filename)
+{
+	int found = 0;
+	u8 *buf;
+
+	if (!(ctx->opt.flags & FLAG_QUIET))
+		pr_info(u"Reading SMBIOS/DMI data from file %s.", filename);
+	if ((buf = mem_chunk(0, 0x20, filename, ctx->arena)) == NULL)
+		return -1;
+
+	if (memcmp(buf, SNAP_MAGIC, 8) == 0)
+		found = dmi_snapshot_decode(ctx, filename);
+	else if (memcmp(buf, u"_SM3_", 5) == 0)
+		found = smbios3_decode(ctx, buf, filename, 0, NULL);
+	else if (memcmp(buf, u"_SM_", 4) == 0)
+		found = smbios_decode(ctx, buf, filename, 0, NULL);
+	else if (memcmp(buf, u"_DMI_", 5) == 0)
+		found = legacy_decode(ctx, buf, filename, 0, NULL);
+
+	arena_free(ctx->arena, buf);
+	return found;
+}
+
+/*
+ * Batch mode: every dump file is decoded into its own buffer, exactly as
+ * a single --from-dump run would print it, and the outputs are written
+ * in command line order, labelled with the file name. Each worker thread
+ * decodes with its own copy of the context, and the state of the output
+ * layer is per thread, so the files can be decoded in parallel.
+ * Returns 1 if the file couldn't be read, 3 if it is identical to the
+ * baseline, 0 otherwise.
+ */
+static int dmi_batch_decode(struct dmi_context *ctx, const char *filename,
+			    struct pr_capture *c)
+{
+	struct arena arena;
+	int found;
+
+	/* Each file is a run of its own */
+	ctx->unchanged = 0;
+	arena_init(&arena);
+	ctx->arena = &arena;
+	pr_set_arena(&arena);
+	pr_capture_start();
+	if (!(ctx->opt.flags & FLAG_QUIET))
+		pr_comment(u"dmidecode %s", VERSION);
+	found = dmi_decode_dump(ctx, filename);
+	if (found == 0 && !(ctx->opt.flags & FLAG_QUIET))
+		pr_comment(u"No SMBIOS nor DMI entry point found, sorry.");
+	pr_capture_end(c);
+	pr_set_arena(NULL);
+	ctx->arena = NULL;
+	arena_release(&arena);
+
+	if (found < 0)
+		return 1;
+	return ctx->unchanged ? 3 : 0;
+}
+
+/*
+ * Exit status of a batch, from the number of files which couldn't be read
+ * and of files identical to the baseline: 3 only if all of them are
+ */
+static int dmi_batch_status(unsigned int failed, unsigned int unchanged,
+			    unsigned int count)
+{
+	if (failed)
+		return 1;
+	return count && unchanged == count ? 3 : 0;
+}
+
+#ifdef USE_PTHREAD
+struct dmi_batch
+{
+	const struct dmi_context *ctx;
+	struct
+	{
+		struct pr_capture out;
+		int ret;
+		int done;
+	} *job;
+	unsigned int next;	/* Next file to decode */
+	pthread_mutex_t lock;
+	pthread_cond_t done;
+};
+
+static void *dmi_batch_worker(void *arg)
+{
+	struct dmi_batch *b = arg;
+	struct dmi_context ctx = *b->ctx;
+	struct pr_capture c;
+	unsigned int i;
+	int ret;
+
+	pr_set_chunk_size(ctx.opt.chunk_size);
+	pr_set_format(ctx.opt.format);
+	pr_set_fields(ctx.opt.field, ctx.opt.field_count);
+	for (;;)
+	{
+		pthread_mutex_lock(&b->lock);
+		i = b->next++;
+		pthread_mutex_unlock(&b->lock);
+		if (i >= ctx.opt.batch_count)
+			break;
+
+		ret = dmi_batch_decode(&ctx, ctx.opt.batch_file[i], &c);
+
+		pthread_mutex_lock(&b->lock);
+		b->job[i].out = c;
+		b->job[i].ret = ret;
+		b->job[i].done = 1;
+		pthread_cond_broadcast(&b->done);
+		pthread_mutex_unlock(&b->lock);
+	}
+
+	return NULL;
+}
+
+/*
+ * Decode the files with a pool of worker threads. The outputs are
+ * written as soon as all the previous ones have been.
+ * Returns -1 if the threads couldn't be started.
+ */
+static int dmi_batch_threads(const struct dmi_context *ctx,
+			     unsigned int jobs)
+{
+	struct dmi_batch b;
+	pthread_t *thread;
+	unsigned int started, i, failed = 0, unchanged = 0;
+	int ret = 0;
+
+	b.job = calloc(ctx->opt.batch_count, sizeof(*b.job));
+	thread = malloc(jobs * sizeof(pthread_t));
+	if (b.job == NULL || thread == NULL)
+	{
+		perror(u"malloc");
+		free(b.job);
+		free(thread);
+		return -1;
+	}
+	b.ctx = ctx;
+	b.next = 0;
+	pthread_mutex_init(&b.lock, NULL);
+	pthread_cond_init(&b.done, NULL);
+
+	for (started = 0; started < jobs; started++)
+		if (pthread_create(&thread[started], NULL, dmi_batch_worker,
+				   &b) != 0)
+			break;
+	if (started == 0)
+	{
+		ret = -1;
+		goto out;
+	}
+
+	for (i = 0; i < ctx->opt.batch_count; i++)
+	{
+		pthread_mutex_lock(&b.lock);
+		while (!b.job[i].done)
+			pthread_cond_wait(&b.done, &b.lock);
+		pthread_mutex_unlock(&b.lock);
+
+		pr_stream_write(ctx->opt.batch_file[i], &b.job[i].out);
+		free(b.job[i].out.buf);
+		failed += b.job[i].ret == 1;
+		unchanged += b.job[i].ret == 3;
+	}
+	ret = dmi_batch_status(failed, unchanged, ctx->opt.batch_count);
+
+	while (started)
+		pthread_join(thread[--started], NULL);
+out:
+	pthread_cond_destroy(&b.done);
+	pthread_mutex_destroy(&b.lock);
+	free(thread);
+	free(b.job);
+	return ret;
+}
+#endif
+
+static int dmi_batch(const struct dmi_context *ctx)
+{
+	struct dmi_context bctx = *ctx;
+	struct pr_capture c;
+	unsigned int i, failed = 0, unchanged = 0;
+	int ret;
+#ifdef USE_PTHREAD
+	long jobs = ctx->opt.jobs;
+#endif
 
-	/* Don't let checksum run beyond the buffer */
-	if (buf[0x05] > 0x20)
-	{
-		printf(u"Entry point length too large (%u bytes, expected %u).\n",
-			(unsigned int)buf[0x05], 0x1FU);
-		return 0;
-	}
+	/* Every file is read only once, caching the tables is useless */
+	bctx.cache = NULL;
 
-	if (!checksum(buf, buf[0x05])
-	 || memcmp(buf + 0x10, u"_DMI_", 5) != 0
-	 || !checksum(buf + 0x10, 0x0F))
-		return 0;
+#ifdef USE_PTHREAD
+	if (jobs == 0)
+		jobs = sysconf(_SC_NPROCESSORS_ONLN);
+	if (jobs > (long)ctx->opt.batch_count)
+		jobs = ctx->opt.batch_count;
+	if (jobs > 1 && (ret = dmi_batch_threads(&bctx, jobs)) >= 0)
+		return ret;
+#endif
 
-	ver = (buf[0x06] << 8) + buf[0x07];
-	/* Some BIOS report weird SMBIOS version, fix that up */
-	switch (ver)
+	for (i = 0; i < ctx->opt.batch_count; i++)
 	{
-		case 0x021F:
-		case 0x0221:
-			if (!(opt.flags & FLAG_QUIET))
-				printf(u"SMBIOS version fixup (2.%d -> 2.%d).\n",
-					ver & 0xFF, 3);
-			ver = 0x0203;
-			break;
-		case 0x0233:
-			if (!(opt.flags & FLAG_QUIET))
-				printf(u"SMBIOS version fixup (2.%d -> 2.%d).\n",
-					51, 6);
-			ver = 0x0206;
-			break;
+		ret = dmi_batch_decode(&bctx, ctx->opt.batch_file[i], &c);
+		failed += ret == 1;
+		unchanged += ret == 3;
+		pr_stream_write(ctx->opt.batch_file[i], &c);
+		free(c.buf);
 	}
-	if (!(opt.flags & FLAG_QUIET))
-		pr_info(u"SMBIOS %u.%u present.",
-			ver >> 8, ver & 0xFF);
 
-	dmi_table(DWORD(buf + 0x18), WORD(buf + 0x16), WORD(buf + 0x1C),
-		ver << 8, devmem, flags);
+	return dmi_batch_status(failed, unchanged, ctx->opt.batch_count);
+}
 
-	if (opt.flags & FLAG_DUMP_BIN)
-	{
-		u8 crafted[32];
+/*
+ * Table sources, tried in turn by dmi_run() until one of them is
+ * available. Each finds the entry point its own way, then has dmi_table()
+ * read the table behind it the cheapest way it can: probe() returns
+ * DMI_SOURCE_NONE if the source isn't available, so that the next one is
+ * tried, and DMI_SOURCE_DONE once it has searched, with *found telling if
+ * an entry point was decoded. With --stats, the source is reported along
+ * with how the table was read.
+ */
+#define DMI_SOURCE_ERROR	(-1)	/* Don't try further, exit status 1 */
+#define DMI_SOURCE_NONE		0
+#define DMI_SOURCE_DONE		1
 
-		memcpy(crafted, buf, 32);
-		overwrite_dmi_address(crafted + 0x10);
+struct dmi_source
+{
+	const char *name;
+	int (*probe)(struct dmi_context *ctx, int *found);
+};
 
-		if (!(opt.flags & FLAG_QUIET))
-			pr_comment(u"Writing %d bytes to %s.", crafted[0x05],
-				   opt.dumpfile);
-		write_dump(0, crafted[0x05], crafted, opt.dumpfile, 1);
-	}
+/* Read from dump if so instructed */
+static int dmi_source_dump(struct dmi_context *ctx, int *found)
+{
+	if (!(ctx->opt.flags & FLAG_FROM_DUMP))
+		return DMI_SOURCE_NONE;
 
-	return 1;
+	if ((*found = dmi_decode_dump(ctx, ctx->opt.dumpfile)) < 0)
+		return DMI_SOURCE_ERROR;
+	return DMI_SOURCE_DONE;
 }
 
-static int legacy_decode(u8 *buf, const char *devmem, u32 flags)
+/*
+ * Entry point given by the caller, see dmi_context_set_entry_point(),
+ * with the table mapped at the address it announces. Only library
+ * callers, such as a UEFI application which looked the entry point up in
+ * the configuration table, can use this source: dmidecode itself never
+ * sets one, and goes on with the other sources.
+ */
+static int dmi_source_efi_table(struct dmi_context *ctx, int *found)
 {
-	if (!checksum(buf, 0x0F))
-		return 0;
+	const u8 *ep = ctx->ep_memory;
+	u8 buf[0x20];
+	size_t len = 0;
 
-	if (!(opt.flags & FLAG_QUIET))
-		pr_info(u"Legacy DMI %u.%u present.",
-			buf[0x0E] >> 4, buf[0x0E] & 0x0F);
+	if (ep == NULL)
+		return DMI_SOURCE_NONE;
 
-	dmi_table(DWORD(buf + 0x08), WORD(buf + 0x06), WORD(buf + 0x0C),
-		((buf[0x0E] & 0xF0) << 12) + ((buf[0x0E] & 0x0F) << 8),
-		devmem, flags);
+	if (!(ctx->opt.flags & FLAG_QUIET))
+		pr_info(u"Getting SMBIOS data from the EFI configuration table.");
 
-	if (opt.flags & FLAG_DUMP_BIN)
-	{
-		u8 crafted[16];
+	/* Nothing is read beyond the announced length of the entry point */
+	if (memcmp(ep, "_SM3_", 5) == 0)
+		len = ep[0x06];
+	else if (memcmp(ep, "_SM_", 4) == 0)
+		len = ep[0x05];
+	if (len > sizeof(buf))
+		len = sizeof(buf);
+	memset(buf, 0, sizeof(buf));
+	memcpy(buf, ep, len);
 
-		memcpy(crafted, buf, 16);
-		overwrite_dmi_address(crafted);
+	ctx->ep_address = (uintptr_t)ep;
+	if (memcmp(buf, "_SM3_", 5) == 0)
+		*found = smbios3_decode(ctx, buf, ctx->opt.devmem,
+					FLAG_IN_MEMORY, NULL);
+	else if (memcmp(buf, "_SM_", 4) == 0)
+		*found = smbios_decode(ctx, buf, ctx->opt.devmem,
+				       FLAG_IN_MEMORY, NULL);
+	return DMI_SOURCE_DONE;
+}
 
-		if (!(opt.flags & FLAG_QUIET))
-			pr_comment(u"Writing %d bytes to %s.", 0x0F,
-				   opt.dumpfile);
-		write_dump(0, 0x0F, crafted, opt.dumpfile, 1);
-	}
+/* The table saved by a previous run, if still valid */
+static int dmi_source_cache(struct dmi_context *ctx, int *found)
+{
+	if (ctx->opt.cache_file == NULL || !dmi_cache_file_decode(ctx))
+		return DMI_SOURCE_NONE;
 
-	return 1;
+	*found = 1;
+	return DMI_SOURCE_DONE;
 }
 
 /*
- * Probe for EFI interface
+ * The entry point file could contain one of several types of entry
+ * points, so read enough for the largest one, then determine what type
+ * it contains.
  */
-#define EFI_NOT_FOUND   (-1)
-#define EFI_NO_SMBIOS   (-2)
-static int address_from_efi(off_t *address)
+static int dmi_source_sysfs(struct dmi_context *ctx, int *found)
 {
-#if defined(__linux__)
-	FILE *efi_systab;
-	const char *filename;
-	char linebuf[64];
-#elif defined(__FreeBSD__)
-	char addrstr[KENV_MVALLEN + 1];
-#endif
-	const char *eptype;
-	int ret;
+	struct file_prefetch *prefetch;
+	size_t size = 0x20;
+	u8 ep[0x20];
+	u8 *buf;
 
-	*address = 0; /* Prevent compiler warning */
+	if (ctx->opt.flags & FLAG_NO_SYSFS)
+		return DMI_SOURCE_NONE;
 
-#if defined(__linux__)
 	/*
-	 * Linux up to 2.6.6: /proc/efi/systab
-	 * Linux 2.6.7 and up: /sys/firmware/efi/systab
+	 * Start reading the table while the entry point is checked,
+	 * unless a library context may have it cached already
 	 */
-	if ((efi_systab = fopen(filename = u"/sys/firmware/efi/systab", u"r")) == NULL
-	 && (efi_systab = fopen(filename = u"/proc/efi/systab", u"r")) == NULL)
-	{
-		/* No EFI interface, fallback to memory scan */
-		return EFI_NOT_FOUND;
-	}
-	ret = EFI_NO_SMBIOS;
-	while ((fgets(linebuf, sizeof(linebuf) - 1, efi_systab)) != NULL)
-	{
-		char *addrp = strchr(linebuf, '=');
-		*(addrp++) = '\0';
-		if (strcmp(linebuf, u"SMBIOS3") == 0
-		 || strcmp(linebuf, u"SMBIOS") == 0)
-		{
-			*address = strtoull(addrp, NULL, 0);
-			eptype = linebuf;
-			ret = 0;
-			break;
-		}
-	}
-	if (fclose(efi_systab) != 0)
-		perror(filename);
+	if (ctx->cache == NULL
+	 && (prefetch = arena_alloc(ctx->arena, sizeof(*prefetch))) != NULL
+	 && file_prefetch_start(prefetch, SYS_TABLE_FILE, ctx->arena) == 0)
+		ctx->prefetch = prefetch;
+	if ((buf = read_file(0, &size, SYS_ENTRY_FILE, ctx->arena)) == NULL)
+		return DMI_SOURCE_NONE;
 
-	if (ret == EFI_NO_SMBIOS)
-		printf(u"%s: SMBIOS entry point missing\n", filename);
-#elif defined(__FreeBSD__)
 	/*
-	 * On FreeBSD, SMBIOS anchor base address in UEFI mode is exposed
-	 * via kernel environment:
-	 * https://svnweb.freebsd.org/base?view=revision&revision=307326
+	 * The file may be shorter than 32 bytes, but the entry point is
+	 * copied whole when written to a dump or cache file
 	 */
-	ret = kenv(KENV_GET, u"hint.smbios.0.mem", addrstr, sizeof(addrstr));
-	if (ret == -1)
+	memset(ep, 0, sizeof(ep));
+	memcpy(ep, buf, size);
+	arena_free(ctx->arena, buf);
+
+	if (!(ctx->opt.flags & FLAG_QUIET))
+		pr_info(u"Getting SMBIOS data from sysfs.");
+	if (size >= 24 && memcmp(ep, u"_SM3_", 5) == 0)
+		*found = smbios3_decode(ctx, ep, SYS_TABLE_FILE,
+					FLAG_NO_FILE_OFFSET, NULL);
+	else if (size >= 31 && memcmp(ep, u"_SM_", 4) == 0)
+		*found = smbios_decode(ctx, ep, SYS_TABLE_FILE,
+				       FLAG_NO_FILE_OFFSET, NULL);
+	else if (size >= 15 && memcmp(ep, u"_DMI_", 5) == 0)
+		*found = legacy_decode(ctx, ep, SYS_TABLE_FILE,
+				       FLAG_NO_FILE_OFFSET, NULL);
+
+	if (*found)
+		return DMI_SOURCE_DONE;
+	if (!(ctx->opt.flags & FLAG_QUIET))
+		pr_info(u"Failed to get SMBIOS data from sysfs.");
+	return DMI_SOURCE_NONE;
+}
+
+/* EFI systab or kenv (ia64, Intel-based Mac, arm64) */
+static int dmi_source_efi(struct dmi_context *ctx, int *found)
+{
+	off_t fp;
+	u8 *buf;
+
+	switch (address_from_efi(ctx, &fp))
 	{
-		if (errno != ENOENT)
-			perror(u"kenv");
-		return EFI_NOT_FOUND;
+		case EFI_NOT_FOUND:
+			return DMI_SOURCE_NONE;
+		case EFI_NO_SMBIOS:
+			return DMI_SOURCE_ERROR;
 	}
 
-	*address = strtoull(addrstr, NULL, 0);
-	eptype = u"SMBIOS";
-	ret = 0;
-#else
-	ret = EFI_NOT_FOUND;
-#endif
+	if (!(ctx->opt.flags & FLAG_QUIET))
+		pr_info(u"Found SMBIOS entry point in EFI, reading table from %s.",
+			ctx->opt.devmem);
+	ctx->ep_address = fp;
+	if ((buf = mem_chunk(fp, 0x20, ctx->opt.devmem, ctx->arena)) == NULL)
+		return DMI_SOURCE_ERROR;
 
-	if (ret == 0 && !(opt.flags & FLAG_QUIET))
-		pr_comment(u"%s entry point at 0x%08llx",
-			   eptype, (unsigned long long)*address);
+	if (memcmp(buf, u"_SM3_", 5) == 0)
+		*found = smbios3_decode(ctx, buf, ctx->opt.devmem,
+					FLAG_FROM_EFI, NULL);
+	else if (memcmp(buf, u"_SM_", 4) == 0)
+		*found = smbios_decode(ctx, buf, ctx->opt.devmem,
+				       FLAG_FROM_EFI, NULL);
+	return DMI_SOURCE_DONE;
+}
 
-	return ret;
+#if defined __i386__ || defined __x86_64__
+/* Fallback to memory scan (x86, x86_64) */
+static int dmi_source_scan(struct dmi_context *ctx, int *found)
+{
+	struct mem_view view;
+	size_t size = 0x10000;
+
+	if (!(ctx->opt.flags & FLAG_QUIET))
+		pr_info(u"Scanning %s for entry point.", ctx->opt.devmem);
+	if (mem_view(&view, 0xF0000, &size, ctx->opt.devmem, ctx->arena) != 0)
+		return DMI_SOURCE_ERROR;
+	if (size != 0x10000)
+	{
+		pr_info(u"%s: Can't read data beyond EOF", ctx->opt.devmem);
+		mem_view_release(&view);
+		return DMI_SOURCE_ERROR;
+	}
+
+	*found = scan_memory(ctx, view.data);
+	mem_view_release(&view);
+	return DMI_SOURCE_DONE;
 }
+#endif
 
-int main(int argc, char * const argv[])
+static const struct dmi_source dmi_source[] = {
+	{ u"dump file",			dmi_source_dump },
+	{ u"EFI configuration table",	dmi_source_efi_table },
+	{ u"cache file",		dmi_source_cache },
+	{ u"sysfs",			dmi_source_sysfs },
+	{ u"EFI",			dmi_source_efi },
+#if defined __i386__ || defined __x86_64__
+	{ u"memory scan",		dmi_source_scan },
+#endif
+	{ NULL, NULL }
+};
+
+/*
+ * Decode the table as the options of the context say, reading it from
+ * the first source which has one. This is a whole dmidecode run, option
+ * parsing apart. Returns the exit status.
+ */
+static int dmi_run(struct dmi_context *ctx)
 {
 	int ret = 0;                /* Returned value */
 	int found = 0;
-	off_t fp;
-	size_t size;
-	int efi;
-	u8 *buf = NULL;
-
-	/* Set default option values */
-	opt.devmem = DEFAULT_MEM_DEV;
-	opt.flags = 0;
-	opt.handle = ~0U;
-
-	if (parse_command_line(argc, argv)<0)
+	int status;
+	unsigned int i;
+	struct arena arena;
+
+	arena_init(&arena);
+	pr_set_sink(ctx->write, ctx->write_arg);
+	pr_set_chunk_size(ctx->opt.chunk_size);
+	pr_set_format(ctx->opt.format);
+	pr_set_fields(ctx->opt.field, ctx->opt.field_count);
+
+	/* Everything the run allocates goes away at once at exit_free */
+	ctx->arena = &arena;
+
+	/* Shared by the batch workers, which only read it */
+	ctx->unchanged = 0;
+	if (ctx->opt.baseline != NULL
+	 && (ctx->baseline = dmi_baseline_load(ctx->opt.baseline,
+						ctx->arena)) == NULL)
 	{
-		ret = 2;
+		ret = 1;
 		goto exit_free;
 	}
 
-	if (opt.flags & FLAG_HELP)
+	if (ctx->opt.flags & FLAG_BATCH)
 	{
-		print_help();
+		ret = dmi_batch(ctx);
 		goto exit_free;
 	}
+	pr_set_arena(&arena);
 
-	if (opt.flags & FLAG_VERSION)
+	if ((ctx->opt.flags & FLAG_STATS)
+	 && (ctx->stats = dmi_stats_new(ctx->arena)) == NULL)
 	{
-		printf(u"%s\n", VERSION);
+		ret = 1;
 		goto exit_free;
 	}
 
-	if (!(opt.flags & FLAG_QUIET))
+	if (!(ctx->opt.flags & FLAG_QUIET))
 		pr_comment(u"dmidecode %s", VERSION);
 
-	/* Read from dump if so instructed */
-	if (opt.flags & FLAG_FROM_DUMP)
+	for (i = 0; dmi_source[i].name != NULL; i++)
 	{
-		if (!(opt.flags & FLAG_QUIET))
-			pr_info(u"Reading SMBIOS/DMI data from file %s.",
-				opt.dumpfile);
-		if ((buf = mem_chunk(0, 0x20, opt.dumpfile)) == NULL)
+		ctx->ep_address = 0;
+		status = dmi_source[i].probe(ctx, &found);
+		if (status == DMI_SOURCE_ERROR)
 		{
 			ret = 1;
 			goto exit_free;
 		}
-
-		if (memcmp(buf, u"_SM3_", 5) == 0)
-		{
-			if (smbios3_decode(buf, opt.dumpfile, 0))
-				found++;
-		}
-		else if (memcmp(buf, u"_SM_", 4) == 0)
-		{
-			if (smbios_decode(buf, opt.dumpfile, 0))
-				found++;
-		}
-		else if (memcmp(buf, u"_DMI_", 5) == 0)
+		if (status == DMI_SOURCE_DONE)
 		{
-			if (legacy_decode(buf, opt.dumpfile, 0))
-				found++;
+			if (ctx->stats != NULL && found)
+				ctx->stats->source = dmi_source[i].name;
+			break;
 		}
-		goto done;
 	}
 
-	/*
-	 * First try reading from sysfs tables.  The entry point file could
-	 * contain one of several types of entry points, so read enough for
-	 * the largest one, then determine what type it contains.
-	 */
-	size = 0x20;
-	if (!(opt.flags & FLAG_NO_SYSFS)
-	 && (buf = read_file(0, &size, SYS_ENTRY_FILE)) != NULL)
+	if (!found && !(ctx->opt.flags & FLAG_QUIET))
+		pr_comment(u"No SMBIOS nor DMI entry point found, sorry.");
+	if (ctx->unchanged)
+		ret = 3;
+	if (ctx->stats != NULL)
+		dmi_stats_print(ctx->stats);
+
+exit_free:
+	if (ctx->prefetch != NULL)
 	{
-		if (!(opt.flags & FLAG_QUIET))
-			pr_info(u"Getting SMBIOS data from sysfs.");
-		if (size >= 24 && memcmp(buf, u"_SM3_", 5) == 0)
-		{
-			if (smbios3_decode(buf, SYS_TABLE_FILE, FLAG_NO_FILE_OFFSET))
-				found++;
-		}
-		else if (size >= 31 && memcmp(buf, u"_SM_", 4) == 0)
-		{
-			if (smbios_decode(buf, SYS_TABLE_FILE, FLAG_NO_FILE_OFFSET))
-				found++;
-		}
-		else if (size >= 15 && memcmp(buf, u"_DMI_", 5) == 0)
-		{
-			if (legacy_decode(buf, SYS_TABLE_FILE, FLAG_NO_FILE_OFFSET))
-				found++;
-		}
+		file_prefetch_release(ctx->prefetch, ctx->arena);
+		ctx->prefetch = NULL;
+	}
+	ctx->baseline = NULL;
+	ctx->stats = NULL;
+	pr_end();
+	pr_set_sink(NULL, NULL);
+	pr_set_arena(NULL);
+	ctx->arena = NULL;
+	arena_release(&arena);
+
+	return ret;
+}
+
+static void dmi_context_init(struct dmi_context *ctx)
+{
+	memset(ctx, 0, sizeof(*ctx));
+	opt_init(&ctx->opt);
+}
+
+/*
+ * Library interface, see libdmidecode.h
+ */
 
-		if (found)
-			goto done;
-		if (!(opt.flags & FLAG_QUIET))
-			pr_info(u"Failed to get SMBIOS data from sysfs.");
+struct dmi_context *dmi_context_new(void)
+{
+	struct dmi_context *ctx;
+
+	if ((ctx = malloc(sizeof(*ctx))) == NULL)
+	{
+		perror(u"malloc");
+		return NULL;
 	}
+	dmi_context_init(ctx);
 
-	/* Next try EFI (ia64, Intel-based Mac, arm64) */
-	efi = address_from_efi(&fp);
-	switch (efi)
+	if ((ctx->cache = dmi_cache_new()) == NULL)
 	{
-		case EFI_NOT_FOUND:
-			goto memory_scan;
-		case EFI_NO_SMBIOS:
-			ret = 1;
-			goto exit_free;
+		free(ctx);
+		return NULL;
 	}
+	return ctx;
+}
 
-	if (!(opt.flags & FLAG_QUIET))
-		pr_info(u"Found SMBIOS entry point in EFI, reading table from %s.",
-			opt.devmem);
-	if ((buf = mem_chunk(fp, 0x20, opt.devmem)) == NULL)
+void dmi_context_free(struct dmi_context *ctx)
+{
+	if (ctx == NULL)
+		return;
+	opt_free(&ctx->opt);
+	dmi_cache_free(ctx->cache);
+	free(ctx);
+}
+
+int dmi_context_set_options(struct dmi_context *ctx, int argc,
+			    char * const argv[])
+{
+	opt_free(&ctx->opt);
+	if (parse_command_line(&ctx->opt, argc, argv) < 0)
 	{
-		ret = 1;
-		goto exit_free;
+		opt_free(&ctx->opt);
+		return -1;
 	}
 
-	if (memcmp(buf, u"_SM3_", 5) == 0)
+	/* Each query is a single run, watching is up to the caller */
+	if (ctx->opt.watch)
 	{
-		if (smbios3_decode(buf, opt.devmem, 0))
-			found++;
+		printf(u"Option --watch can't be used in library contexts\n");
+		opt_free(&ctx->opt);
+		return -1;
 	}
-	else if (memcmp(buf, u"_SM_", 4) == 0)
+	return 0;
+}
+
+void dmi_context_set_output(struct dmi_context *ctx,
+			    void (*write)(void *arg, const char *buf,
+					  size_t len),
+			    void *arg)
+{
+	ctx->write = write;
+	ctx->write_arg = arg;
+}
+
+void dmi_context_set_entry_point(struct dmi_context *ctx, const void *ep)
+{
+	ctx->ep_memory = ep;
+}
+
+int dmi_context_decode(struct dmi_context *ctx)
+{
+	return dmi_run(ctx);
+}
+
+#ifndef LIBDMIDECODE
+#ifdef USE_WATCH
+/*
+ * --watch: the table is read again every opt.watch seconds, or as soon as
+ * SIGUSR1 is received, and compared with the table of the previous poll
+ * as with --diff: the entries which were added or changed are decoded,
+ * those which were removed are listed. The output of a poll is written
+ * out only if something changed, or if the table couldn't be read. The
+ * first poll only reads the table. SIGINT and SIGTERM stop watching once
+ * the current poll is over.
+ */
+struct dmi_watch_output
+{
+	char *buf;
+	size_t len;
+	size_t size;
+};
+
+static void dmi_watch_write(void *arg, const char *buf, size_t len)
+{
+	struct dmi_watch_output *o = arg;
+	char *p;
+
+	if (o->len + len > o->size)
 	{
-		if (smbios_decode(buf, opt.devmem, 0))
-			found++;
+		size_t size = o->size ? o->size : DEFAULT_CHUNK_SIZE;
+
+		while (size < o->len + len)
+			size *= 2;
+		if ((p = realloc(o->buf, size)) == NULL)
+		{
+			/* Better out of place than lost */
+			perror(u"realloc");
+			fwrite(buf, 1, len, stdout);
+			return;
+		}
+		o->buf = p;
+		o->size = size;
 	}
-	goto done;
+	memcpy(o->buf + o->len, buf, len);
+	o->len += len;
+}
 
-memory_scan:
-#if defined __i386__ || defined __x86_64__
-	if (!(opt.flags & FLAG_QUIET))
-		pr_info(u"Scanning %s for entry point.", opt.devmem);
-	/* Fallback to memory scan (x86, x86_64) */
-	if ((buf = mem_chunk(0xF0000, 0x10000, opt.devmem)) == NULL)
+static int dmi_watch(struct dmi_context *ctx)
+{
+	struct dmi_watch_output o = { NULL, 0, 0 };
+	struct dmi_baseline *last = NULL;
+	struct timespec interval;
+	sigset_t set;
+	unsigned int poll;
+	int ret = 0, sig = 0;
+
+	/* Only received while waiting for the next poll */
+	sigemptyset(&set);
+	sigaddset(&set, SIGUSR1);
+	sigaddset(&set, SIGINT);
+	sigaddset(&set, SIGTERM);
+	if (sigprocmask(SIG_BLOCK, &set, NULL) != 0)
 	{
-		ret = 1;
-		goto exit_free;
+		perror(u"sigprocmask");
+		return 1;
 	}
+	interval.tv_sec = ctx->opt.watch;
+	interval.tv_nsec = 0;
 
-	/* Look for a 64-bit entry point first */
-	for (fp = 0; fp <= 0xFFE0; fp += 16)
+	ctx->opt.flags |= FLAG_DIFF;
+	ctx->write = dmi_watch_write;
+	ctx->write_arg = &o;
+	for (poll = 0; sig != SIGINT && sig != SIGTERM; poll++)
 	{
-		if (memcmp(buf + fp, u"_SM3_", 5) == 0)
+		o.len = 0;
+		ctx->baseline = last;
+		ctx->polled = NULL;
+		ret = dmi_run(ctx);
+		if (ctx->polled != NULL)
 		{
-			if (smbios3_decode(buf + fp, opt.devmem, 0))
-			{
-				found++;
-				goto done;
-			}
+			dmi_baseline_free(last);
+			last = ctx->polled;
+			ctx->polled = NULL;
 		}
-	}
 
-	/* If none found, look for a 32-bit entry point */
-	for (fp = 0; fp <= 0xFFF0; fp += 16)
-	{
-		if (memcmp(buf + fp, u"_SM_", 4) == 0 && fp <= 0xFFE0)
+		/* Status 3: nothing changed */
+		if (poll == 0 || ret != 3)
 		{
-			if (smbios_decode(buf + fp, opt.devmem, 0))
-			{
-				found++;
-				goto done;
-			}
+			fwrite(o.buf, 1, o.len, stdout);
+			fflush(stdout);
 		}
-		else if (memcmp(buf + fp, u"_DMI_", 5) == 0)
+		/* Nothing to watch */
+		if (poll == 0 && last == NULL)
 		{
-			if (legacy_decode(buf + fp, opt.devmem, 0))
-			{
-				found++;
-				goto done;
-			}
+			ret = 1;
+			break;
 		}
+		ret = 0;
+
+		sig = sigtimedwait(&set, NULL, &interval);
 	}
+
+	ctx->write = NULL;
+	ctx->write_arg = NULL;
+	dmi_baseline_free(last);
+	free(o.buf);
+
+	return ret;
+}
 #endif
 
-done:
-	if (!found && !(opt.flags & FLAG_QUIET))
-		pr_comment(u"No SMBIOS nor DMI entry point found, sorry.");
+int main(int argc, char * const argv[])
+{
+	struct dmi_context ctx;
+	int ret = 0;                /* Returned value */
+
+	dmi_context_init(&ctx);
+
+	if (parse_command_line(&ctx.opt, argc, argv)<0)
+	{
+		ret = 2;
+		goto exit_free;
+	}
+
+	pr_set_chunk_size(ctx.opt.chunk_size);
+
+	if (ctx.opt.flags & FLAG_HELP)
+	{
+		print_help();
+		goto exit_free;
+	}
+
+	if (ctx.opt.flags & FLAG_VERSION)
+	{
+		pr_info(u"%s", VERSION);
+		goto exit_free;
+	}
+
+#ifdef USE_WATCH
+	if (ctx.opt.watch)
+		ret = dmi_watch(&ctx);
+	else
+#endif
+		ret = dmi_run(&ctx);
 
-	free(buf);
 exit_free:
-	free(opt.type);
+	pr_flush();
+	opt_free(&ctx.opt);
 
 	return ret;
 }
+#endif
@@ -21,7 +21,22 @@
 #ifndef DMIDECODE_H
 #define DMIDECODE_H
 
+#include <stddef.h>
+
 #include "types.h"
+#include "dmiopt.h"
+
+/*
+ * Start offsets of the strings of a structure, relative to its data.
+ * Built on first use by dmi_string(), so that looking up a string
+ * doesn't require walking over all the previous ones.
+ */
+struct dmi_strings
+{
+	int count;		/* -1 until built */
+	u8 filtered[32];	/* Bitmap of strings already ASCII-filtered */
+	u32 offset[255];
+};
 
 struct dmi_header
 {
@@ -29,6 +44,43 @@ struct dmi_header
 	u8 length;
 	u16 handle;
 	u8 *data;
+	struct dmi_strings *strings;	/* Optional, may be NULL */
+};
+
+struct dmi_cache;
+struct dmi_baseline;
+struct dmi_stats;
+struct dmi_oem_vendor;
+struct file_prefetch;
+struct arena;
+
+/*
+ * Everything a decoding run depends on: the options, the state of the
+ * vendor-specific decodes and where the output goes. Each thread decodes
+ * with its own context, see libdmidecode.h for the library interface.
+ */
+struct dmi_context
+{
+	struct opt opt;
+	/* Set by dmi_set_vendor() */
+	const struct dmi_oem_vendor *oem;
+	int (*oem_decode[128])(struct dmi_context *ctx,
+			       const struct dmi_header *h);	/* Types 128+ */
+	const char *product;
+	int oem_gen;			/* Product generation, for HPE */
+	u8 nic_ctr;
+	void (*write)(void *arg, const char *buf, size_t len);
+	void *write_arg;		/* write() NULL: stdout */
+	struct dmi_cache *cache;	/* Table kept between runs, may be NULL */
+	struct dmi_baseline *baseline;	/* Loaded from opt.baseline */
+	struct dmi_baseline *polled;	/* Copy of the table, with --watch */
+	int unchanged;			/* Table identical to the baseline */
+	unsigned long long ep_address;	/* Of the entry point being decoded */
+	const u8 *ep_memory;		/* See dmi_context_set_entry_point() */
+	int cache_update;		/* opt.cache_file waits for the entry point */
+	struct dmi_stats *stats;	/* Allocated with FLAG_STATS */
+	struct arena *arena;		/* Of the current run, may be NULL */
+	struct file_prefetch *prefetch;	/* Of the sysfs table, may be NULL */
 };
 
 int is_printable(const u8 *data, int len);
@@ -0,0 +1,176 @@
+/*
+ * Fuzz target of the table decoder
+ * This file is part of the dmidecode project.
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ * Inputs are laid out as --dump-bin files, entry point at offset 0 and
+ * table at offset 32, such as those of corpus/. The table is copied to a
+ * buffer of its exact size and decoded in-process through libdmidecode,
+ * from an SMBIOS 3 entry point built around it: only the version is taken
+ * from the entry point of the input, so that mutations go to the decoders
+ * rather than to the checksums. The structure count of SMBIOS 2.x entry
+ * points is therefore not fuzzed. Byte 0x1F, which neither type of entry
+ * point uses, selects the output format or decoding path.
+ *
+ * "make dmifuzz" builds it for libFuzzer with clang, "make fuzz" runs it
+ * on a copy of corpus/. AFL++ takes the same target, built with
+ * FUZZ_CC=afl-clang-fast. Built with FUZZ_CC=gcc
+ * FUZZ_FLAGS="-fsanitize=address -DDMIFUZZ_MAIN", it decodes the files
+ * given on its command line instead, e.g. to replay a crash without clang.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "types.h"
+#include "libdmidecode.h"
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+static const char * const fuzz_options[][5] = {
+	{ NULL },
+	{ "--format", "json", NULL },
+	{ "--format", "keyvalue", NULL },
+	{ "--dump", NULL },
+	{ "--memory", NULL },
+	{ "-s", "system-uuid", "-s", "processor-family", NULL },
+	{ "--type", "17", NULL },
+	{ "--handle", "0x0001", NULL },
+};
+
+static void discard_output(void *arg, const char *buf, size_t len)
+{
+	(void)arg;
+	(void)buf;
+	(void)len;
+}
+
+static void put32(u8 *p, u32 v)
+{
+	p[0] = v & 0xFF;
+	p[1] = (v >> 8) & 0xFF;
+	p[2] = (v >> 16) & 0xFF;
+	p[3] = v >> 24;
+}
+
+static void make_ep(u8 *ep, const uint8_t *data, const u8 *table, u32 len)
+{
+	unsigned long long address = (uintptr_t)table;
+	u8 sum = 0;
+	int i;
+
+	memset(ep, 0, 0x18);
+	memcpy(ep, "_SM3_", 5);
+	ep[0x06] = 0x18;
+	if (memcmp(data, "_SM3_", 5) == 0)
+	{
+		ep[0x07] = data[0x07];
+		ep[0x08] = data[0x08];
+		ep[0x09] = data[0x09];
+	}
+	else if (memcmp(data, "_SM_", 4) == 0)
+	{
+		ep[0x07] = data[0x06];
+		ep[0x08] = data[0x07];
+	}
+	else
+		ep[0x07] = 2;
+	ep[0x0A] = 0x01;
+	put32(ep + 0x0C, len);
+	put32(ep + 0x10, address & 0xFFFFFFFF);
+	put32(ep + 0x14, address >> 32);
+	for (i = 0; i < 0x18; i++)
+		sum += ep[i];
+	ep[0x05] = -sum;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	const char * const *options;
+	char *argv[8];
+	struct dmi_context *ctx;
+	u8 ep[0x18];
+	u8 *table;
+	size_t len;
+	int argc = 0;
+
+	if (size < 32 || size - 32 > 0xFFFFFFFF)
+		return 0;
+	len = size - 32;
+
+	options = fuzz_options[data[0x1F] % (sizeof(fuzz_options)
+					     / sizeof(fuzz_options[0]))];
+	argv[argc++] = (char *)"dmifuzz";
+	while (*options != NULL)
+		argv[argc++] = (char *)*options++;
+	argv[argc] = NULL;
+
+	if ((table = malloc(len ? len : 1)) == NULL)
+		return 0;
+	memcpy(table, data + 32, len);
+	make_ep(ep, data, table, len);
+
+	if ((ctx = dmi_context_new()) != NULL)
+	{
+		if (dmi_context_set_options(ctx, argc, argv) == 0)
+		{
+			dmi_context_set_output(ctx, discard_output, NULL);
+			dmi_context_set_entry_point(ctx, ep);
+			dmi_context_decode(ctx);
+		}
+		dmi_context_free(ctx);
+	}
+	free(table);
+	return 0;
+}
+
+#ifdef DMIFUZZ_MAIN
+int main(int argc, char *argv[])
+{
+	u8 *buf;
+	size_t size;
+	FILE *f;
+	long len;
+	int i, ret = 0;
+
+	for (i = 1; i < argc; i++)
+	{
+		if ((f = fopen(argv[i], "rb")) == NULL
+		 || fseek(f, 0, SEEK_END) != 0 || (len = ftell(f)) < 0
+		 || fseek(f, 0, SEEK_SET) != 0)
+		{
+			perror(argv[i]);
+			if (f != NULL)
+				fclose(f);
+			ret = 1;
+			continue;
+		}
+		if ((buf = malloc(len ? len : 1)) == NULL)
+		{
+			perror("malloc");
+			fclose(f);
+			return 1;
+		}
+		size = fread(buf, 1, len, f);
+		fclose(f);
+		LLVMFuzzerTestOneInput(buf, size);
+		free(buf);
+	}
+	return ret;
+}
+#endif
@@ -22,6 +22,7 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "config.h"
 #include "types.h"
 #include "util.h"
 #include "dmidecode.h"
@@ -30,122 +31,97 @@
 #include "dmioutput.h"
 
 /*
- * Globals for vendor-specific decodes
+ * Vendors with specific decodes. Each vendor module gives the system
+ * manufacturer names it matches and a table of its decoders, one per
+ * vendor-specific type. Once the vendor of a table is known,
+ * dmi_set_vendor() resolves them into the dispatch array of the decoder
+ * context, so that every OEM entry is decoded with a single lookup. A new
+ * module only has to be added to dmi_oem_vendors[] below.
  */
 
-enum DMI_VENDORS
+struct dmi_oem_decoder
 {
-	VENDOR_UNKNOWN,
-	VENDOR_ACER,
-	VENDOR_HP,
-	VENDOR_HPE,
-	VENDOR_IBM,
-	VENDOR_LENOVO,
+	u8 type;
+	/* Return 1 if decoding was successful, 0 otherwise */
+	int (*decode)(struct dmi_context *ctx, const struct dmi_header *h);
 };
 
-static enum DMI_VENDORS dmi_vendor = VENDOR_UNKNOWN;
-static const char *dmi_product = NULL;
-
-/*
- * Remember the system vendor for later use. We only actually store the
- * value if we know how to decode at least one specific entry type for
- * that vendor.
- */
-void dmi_set_vendor(const char *v, const char *p)
+struct dmi_oem_vendor
 {
-	const struct { const char *str; enum DMI_VENDORS id; } vendor[] = {
-		{ "Acer",			VENDOR_ACER },
-		{ "HP",				VENDOR_HP },
-		{ "Hewlett-Packard",		VENDOR_HP },
-		{ "HPE",			VENDOR_HPE },
-		{ "Hewlett Packard Enterprise",	VENDOR_HPE },
-		{ "IBM",			VENDOR_IBM },
-		{ "LENOVO",			VENDOR_LENOVO },
-	};
-	unsigned int i;
-	size_t len;
-
-	/*
-	 * Often DMI strings have trailing spaces. Ignore these
-	 * when checking for known vendor names.
-	 */
-	len = v ? strlen(v) : 0;
-	while (len && v[len - 1] == ' ')
-		len--;
-
-	for (i = 0; i < ARRAY_SIZE(vendor); i++)
-	{
-		if (strlen(vendor[i].str) == len &&
-		    strncmp(v, vendor[i].str, len) == 0)
-		{
-			dmi_vendor = vendor[i].id;
-			break;
-		}
-	}
-
-	dmi_product = p;
-}
+	const char *name;		/* As printed in entry names */
+	const char * const *match;	/* Manufacturers, NULL-terminated */
+	const struct dmi_oem_decoder *decoder;	/* Terminated by type 0 */
+	/* May be NULL, returns -1 if the product has nothing to decode */
+	int (*init)(struct dmi_context *ctx);
+	int ordered;			/* See dmi_oem_ordered() */
+};
 
+#if !defined CONFIG_OEM || defined CONFIG_OEM_ACER
 /*
  * Acer-specific data structures are decoded here.
  */
 
-static int dmi_decode_acer(const struct dmi_header *h)
+static int dmi_decode_acer_170(MAYBE_UNUSED struct dmi_context *ctx,
+			       const struct dmi_header *h)
 {
 	u8 *data = h->data;
 	u16 cap;
 
-	switch (h->type)
-	{
-		case 170:
-			/*
-			 * Vendor Specific: Acer Hotkey Function
-			 *
-			 * Source: acer-wmi kernel driver
-			 *
-			 * Probably applies to some laptop models of other
-			 * brands, including Fujitsu-Siemens, Medion, Lenovo,
-			 * and eMachines.
-			 */
-			pr_handle_name("Acer Hotkey Function");
-			if (h->length < 0x0F) break;
-			cap = WORD(data + 0x04);
-			pr_attr("Function bitmap for Communication Button", "0x%04hx", cap);
-			pr_subattr("WiFi", "%s", cap & 0x0001 ? "Yes" : "No");
-			pr_subattr("3G", "%s", cap & 0x0040 ? "Yes" : "No");
-			pr_subattr("WiMAX", "%s", cap & 0x0080 ? "Yes" : "No");
-			pr_subattr("Bluetooth", "%s", cap & 0x0800 ? "Yes" : "No");
-			pr_attr("Function bitmap for Application Button", "0x%04hx", WORD(data + 0x06));
-			pr_attr("Function bitmap for Media Button", "0x%04hx", WORD(data + 0x08));
-			pr_attr("Function bitmap for Display Button", "0x%04hx", WORD(data + 0x0A));
-			pr_attr("Function bitmap for Others Button", "0x%04hx", WORD(data + 0x0C));
-			pr_attr("Communication Function Key Number", "%d", data[0x0E]);
-			break;
-
-		default:
-			return 0;
-	}
+	/*
+	 * Vendor Specific: Acer Hotkey Function
+	 *
+	 * Source: acer-wmi kernel driver
+	 *
+	 * Probably applies to some laptop models of other
+	 * brands, including Fujitsu-Siemens, Medion, Lenovo,
+	 * and eMachines.
+	 */
+	pr_handle_name("Acer Hotkey Function");
+	if (h->length < 0x0F) return 1;
+	cap = WORD(data + 0x04);
+	pr_attr("Function bitmap for Communication Button", "0x%04hx", cap);
+	pr_subattr("WiFi", "%s", cap & 0x0001 ? "Yes" : "No");
+	pr_subattr("3G", "%s", cap & 0x0040 ? "Yes" : "No");
+	pr_subattr("WiMAX", "%s", cap & 0x0080 ? "Yes" : "No");
+	pr_subattr("Bluetooth", "%s", cap & 0x0800 ? "Yes" : "No");
+	pr_attr("Function bitmap for Application Button", "0x%04hx", WORD(data + 0x06));
+	pr_attr("Function bitmap for Media Button", "0x%04hx", WORD(data + 0x08));
+	pr_attr("Function bitmap for Display Button", "0x%04hx", WORD(data + 0x0A));
+	pr_attr("Function bitmap for Others Button", "0x%04hx", WORD(data + 0x0C));
+	pr_attr("Communication Function Key Number", "%d", data[0x0E]);
 	return 1;
 }
 
+static const struct dmi_oem_decoder dmi_acer_decoder[] = {
+	{ 170,	dmi_decode_acer_170 },
+	{ 0, NULL }
+};
+
+static const char * const dmi_acer_match[] = { "Acer", NULL };
+
+static const struct dmi_oem_vendor dmi_oem_acer = {
+	"Acer", dmi_acer_match, dmi_acer_decoder, NULL, 0
+};
+#endif
+
+#if !defined CONFIG_OEM || defined CONFIG_OEM_HP
 /*
  * HPE-specific data structures are decoded here.
  *
  * Code contributed by John Cagle and Tyler Bell.
  */
 
-static void dmi_print_hp_net_iface_rec(u8 id, u8 bus, u8 dev, const u8 *mac)
+static void dmi_print_hp_net_iface_rec(struct dmi_context *ctx, u8 id, u8 bus, u8 dev, const u8 *mac)
 {
 	/* Some systems do not provide an id. nic_ctr provides an artificial
 	 * id, and assumes the records will be provided "in order".  Also,
 	 * using 0xFF marker is not future proof. 256 NICs is a lot, but
 	 * 640K ought to be enough for anybody(said no one, ever).
 	 * */
-	static u8 nic_ctr;
 	char attr[8];
 
 	if (id == 0xFF)
-		id = ++nic_ctr;
+		id = ++ctx->nic_ctr;
 
 	sprintf(attr, "NIC %hhu", id);
 	if (dev == 0x00 && bus == 0x00)
@@ -163,7 +139,8 @@ static void dmi_print_hp_net_iface_rec(u8 id, u8 bus, u8 dev, const u8 *mac)
 
 typedef enum { G6 = 6, G7, G8, G9, G10, G10P } dmi_hpegen_t;
 
-static int dmi_hpegen(const char *s)
+/* fallback is the generation of products which don't tell theirs */
+static int dmi_hpegen(const char *s, int fallback)
 {
 	struct { const char *name; dmi_hpegen_t gen; } table[] = {
 		{ "Gen10 Plus",	G10P },
@@ -175,6 +152,9 @@ static int dmi_hpegen(const char *s)
 	};
 	unsigned int i;
 
+	if (s == NULL)
+		return -1;
+
 	if (!strstr(s, "ProLiant") && !strstr(s, "Apollo") &&
 	    !strstr(s, "Synergy")  && !strstr(s, "Edgeline"))
 		return -1;
@@ -184,7 +164,7 @@ static int dmi_hpegen(const char *s)
 			return(table[i].gen);
 	}
 
-	return (dmi_vendor == VENDOR_HPE) ? G10P : G6;
+	return fallback;
 }
 
 static void dmi_hp_240_attr(u64 defined, u64 set)
@@ -207,9 +187,10 @@ static void dmi_hp_240_attr(u64 defined, u64 set)
 	}
 }
 
-static void dmi_hp_203_assoc_hndl(const char *fname, u16 num)
+static void dmi_hp_203_assoc_hndl(const struct dmi_context *ctx,
+				  const char *fname, u16 num)
 {
-	if (opt.flags & FLAG_QUIET)
+	if (ctx->opt.flags & FLAG_QUIET)
 		return;
 
 	if (num == 0xFFFE)
@@ -299,450 +280,615 @@ static void dmi_hp_203_devloc(const char *fname, unsigned int code)
 	pr_attr(fname, "%s", str);
 }
 
-static int dmi_decode_hp(const struct dmi_header *h)
+static int dmi_decode_hp_203(struct dmi_context *ctx,
+			     const struct dmi_header *h)
 {
 	u8 *data = h->data;
-	int nic, ptr;
-	u32 feat;
-	const char *company = (dmi_vendor == VENDOR_HP) ? "HP" : "HPE";
-	int gen;
+	const char *company = ctx->oem->name;
 
-	gen = dmi_hpegen(dmi_product);
-	if (gen < 0)
-		return 0;
+	/*
+	 * Vendor Specific: HP Device Correlation Record
+	 *
+	 * Offset |  Name        | Width | Description
+	 * -------------------------------------
+	 *  0x00  | Type         | BYTE  | 0xCB, Correlation Record
+	 *  0x01  | Length       | BYTE  | Length of structure
+	 *  0x02  | Handle       | WORD  | Unique handle
+	 *  0x04  | Assoc Device | WORD  | Handle of Associated Type 9 or Type 41 Record
+	 *  0x06  | Assoc SMBus  | WORD  | Handle of Associated Type 228 SMBus Segment Record
+	 *  0x08  | PCI Vendor ID| WORD  | PCI Vendor ID of device 0xFFFF -> not present
+	 *  0x0A  | PCI Device ID| WORD  | PCI Device ID of device 0xFFFF -> not present
+	 *  0x0C  | PCI SubVendor| WORD  | PCI Sub Vendor ID of device 0xFFFF -> not present
+	 *  0x0E  | PCI SubDevice| WORD  | PCI Sub Device ID of device 0xFFFF -> not present
+	 *  0x10  | Class Code   | BYTE  | PCI Class Code of Endpoint. 0xFF if device not present.
+	 *  0x11  | Class SubCode| BYTE  | PCI Sub Class Code of Endpoint. 0xFF if device not present.
+	 *  0x12  | Parent Handle| WORD  |
+	 *  0x14  | Flags        | WORD  |
+	 *  0x16  | Device Type  | BYTE  | UEFI only
+	 *  0x17  | Device Loc   | BYTE  | Device Location
+	 *  0x18  | Dev Instance | BYTE  | Device Instance
+	 *  0x19  | Sub Instance | BYTE  | NIC Port # or NVMe Drive Bay
+	 *  0x1A  | Bay          | BYTE  |
+	 *  0x1B  | Enclosure    | BYTE  |
+	 *  0x1C  | UEFI Dev Path| STRING| String number for UEFI Device Path
+	 *  0x1D  | Struct Name  | STRING| String number for UEFI Device Structured Name
+	 *  0x1E  | Device Name  | STRING| String number for UEFI Device Name
+	 *  0x1F  | UEFI Location| STRING| String number for UEFI Location
+	 *  0x20  | Assoc Handle | WORD  | Type 9 Handle.  Defined if Flags[0] == 1.
+	 *  0x22  | Part Number  | STRING| PCI Device Part Number
+	 *  0x23  | Serial Number| STRING| PCI Device Serial Number
+	 *  0x24  | Seg Number   | WORD  | Segment Group number. 0 -> Single group topology
+	 *  0x26  | Bus Number   | BYTE  | PCI Device Bus Number
+	 *  0x27  | Func Number  | BTYE  | PCI Device and Function Number
+	 */
+	if (ctx->oem_gen < G9) return 1;
+	if (h->length < 0x1F) return 1;
+	pr_handle_name("%s HP Device Correlation Record", company);
+	dmi_hp_203_assoc_hndl(ctx, "Associated Device Record", WORD(data + 0x04));
+	dmi_hp_203_assoc_hndl(ctx, "Associated SMBus Record",  WORD(data + 0x06));
+	if (WORD(data + 0x08) == 0xffff && WORD(data + 0x0A) == 0xffff &&
+	    WORD(data + 0x0C) == 0xffff && WORD(data + 0x0E) == 0xffff &&
+	    data[0x10] == 0xFF && data[0x11] == 0xFF)
+	{
+		pr_attr("PCI Device Info", "Device Not Present");
+	}
+	else
+	{
+		dmi_hp_203_pciinfo("PCI Vendor ID", WORD(data + 0x08));
+		dmi_hp_203_pciinfo("PCI Device ID", WORD(data + 0x0A));
+		dmi_hp_203_pciinfo("PCI Sub Vendor ID", WORD(data + 0x0C));
+		dmi_hp_203_pciinfo("PCI Sub Device ID", WORD(data + 0x0E));
+		dmi_hp_203_pciinfo("PCI Class Code", (char)data[0x10]);
+		dmi_hp_203_pciinfo("PCI Sub Class Code", (char)data[0x11]);
+	}
+	dmi_hp_203_assoc_hndl(ctx, "Parent Handle", WORD(data + 0x12));
+	pr_attr("Flags", "0x%04X", WORD(data + 0x14));
+	dmi_hp_203_devtyp("Device Type", data[0x16]);
+	dmi_hp_203_devloc("Device Location", data[0x17]);
+	pr_attr("Device Instance", "%d", data[0x18]);
+	pr_attr("Device Sub-Instance", "%d", data[0x19]);
+	dmi_hp_203_bayenc("Bay", data[0x1A]);
+	dmi_hp_203_bayenc("Enclosure", data[0x1B]);
+	pr_attr("Device Path", "%s", dmi_string(h, data[0x1C]));
+	pr_attr("Structured Name", "%s", dmi_string(h, data[0x1D]));
+	pr_attr("Device Name", "%s", dmi_string(h, data[0x1E]));
+	if (h->length < 0x22) return 1;
+	pr_attr("UEFI Location", "%s", dmi_string(h, data[0x1F]));
+	if (!(ctx->opt.flags & FLAG_QUIET))
+	{
+		if (WORD(data + 0x14) & 1)
+			pr_attr("Associated Real/Phys Handle", "0x%04X",
+				WORD(data + 0x20));
+		else
+			pr_attr("Associated Real/Phys Handle", "N/A");
+	}
+	if (h->length < 0x24) return 1;
+	pr_attr("PCI Part Number", "%s", dmi_string(h, data[0x22]));
+	pr_attr("Serial Number", "%s", dmi_string(h, data[0x23]));
+	if (h->length < 0x28) return 1;
+	pr_attr("Segment Group Number", "0x%04x", WORD(data + 0x24));
+	pr_attr("PCI Device", "%02x:%02x.%x",
+		data[0x26], data[0x27] >> 3, data[0x27] & 7);
+	return 1;
+}
+
+static int dmi_decode_hp_204(struct dmi_context *ctx,
+			     const struct dmi_header *h)
+{
+	u8 *data = h->data;
+	const char *company = ctx->oem->name;
 
-	switch (h->type)
+	/*
+	 * Vendor Specific: HPE ProLiant System/Rack Locator
+	 */
+	pr_handle_name("%s ProLiant System/Rack Locator", company);
+	if (h->length < 0x0B) return 1;
+	pr_attr("Rack Name", "%s", dmi_string(h, data[0x04]));
+	pr_attr("Enclosure Name", "%s", dmi_string(h, data[0x05]));
+	pr_attr("Enclosure Model", "%s", dmi_string(h, data[0x06]));
+	pr_attr("Enclosure Serial", "%s", dmi_string(h, data[0x0A]));
+	pr_attr("Enclosure Bays", "%d", data[0x08]);
+	pr_attr("Server Bay", "%s", dmi_string(h, data[0x07]));
+	pr_attr("Bays Filled", "%d", data[0x09]);
+	return 1;
+}
+
+static int dmi_decode_hp_209(struct dmi_context *ctx,
+			     const struct dmi_header *h)
+{
+	u8 *data = h->data;
+	const char *company = ctx->oem->name;
+	int nic, ptr;
+
+	/*
+	 * Vendor Specific: HPE ProLiant NIC MAC Information
+	 *
+	 * This prints the BIOS NIC number,
+	 * PCI bus/device/function, and MAC address
+	 *
+	 * Type 209:
+	 * Offset |  Name  | Width | Description
+	 * -------------------------------------
+	 *  0x00  |  Type  | BYTE  | 0xD1, MAC Info
+	 *  0x01  | Length | BYTE  | Length of structure
+	 *  0x02  | Handle | WORD  | Unique handle
+	 *  0x04  | Dev No | BYTE  | PCI Device/Function No
+	 *  0x05  | Bus No | BYTE  | PCI Bus
+	 *  0x06  |   MAC  | 6B    | MAC addr
+	 *  0x0C  | NIC #2 | 8B    | Repeat 0x04-0x0B
+	 *
+	 * Type 221: is deprecated in the latest docs
+	 */
+	pr_handle_name("%s %s", company, h->type == 221 ?
+		       "BIOS iSCSI NIC PCI and MAC Information" :
+		       "BIOS PXE NIC PCI and MAC Information");
+	nic = 1;
+	ptr = 4;
+	while (h->length >= ptr + 8)
 	{
-		case 203:
-			/*
-			 * Vendor Specific: HP Device Correlation Record
-			 *
-			 * Offset |  Name        | Width | Description
-			 * -------------------------------------
-			 *  0x00  | Type         | BYTE  | 0xCB, Correlation Record
-			 *  0x01  | Length       | BYTE  | Length of structure
-			 *  0x02  | Handle       | WORD  | Unique handle
-			 *  0x04  | Assoc Device | WORD  | Handle of Associated Type 9 or Type 41 Record
-			 *  0x06  | Assoc SMBus  | WORD  | Handle of Associated Type 228 SMBus Segment Record
-			 *  0x08  | PCI Vendor ID| WORD  | PCI Vendor ID of device 0xFFFF -> not present
-			 *  0x0A  | PCI Device ID| WORD  | PCI Device ID of device 0xFFFF -> not present
-			 *  0x0C  | PCI SubVendor| WORD  | PCI Sub Vendor ID of device 0xFFFF -> not present
-			 *  0x0E  | PCI SubDevice| WORD  | PCI Sub Device ID of device 0xFFFF -> not present
-			 *  0x10  | Class Code   | BYTE  | PCI Class Code of Endpoint. 0xFF if device not present.
-			 *  0x11  | Class SubCode| BYTE  | PCI Sub Class Code of Endpoint. 0xFF if device not present.
-			 *  0x12  | Parent Handle| WORD  |
-			 *  0x14  | Flags        | WORD  |
-			 *  0x16  | Device Type  | BYTE  | UEFI only
-			 *  0x17  | Device Loc   | BYTE  | Device Location
-			 *  0x18  | Dev Instance | BYTE  | Device Instance
-			 *  0x19  | Sub Instance | BYTE  | NIC Port # or NVMe Drive Bay
-			 *  0x1A  | Bay          | BYTE  |
-			 *  0x1B  | Enclosure    | BYTE  |
-			 *  0x1C  | UEFI Dev Path| STRING| String number for UEFI Device Path
-			 *  0x1D  | Struct Name  | STRING| String number for UEFI Device Structured Name
-			 *  0x1E  | Device Name  | STRING| String number for UEFI Device Name
-			 *  0x1F  | UEFI Location| STRING| String number for UEFI Location
-			 *  0x20  | Assoc Handle | WORD  | Type 9 Handle.  Defined if Flags[0] == 1.
-			 *  0x22  | Part Number  | STRING| PCI Device Part Number
-			 *  0x23  | Serial Number| STRING| PCI Device Serial Number
-			 *  0x24  | Seg Number   | WORD  | Segment Group number. 0 -> Single group topology
-			 *  0x26  | Bus Number   | BYTE  | PCI Device Bus Number
-			 *  0x27  | Func Number  | BTYE  | PCI Device and Function Number
-			 */
-			if (gen < G9) break;
-			if (h->length < 0x1F) break;
-			pr_handle_name("%s HP Device Correlation Record", company);
-			dmi_hp_203_assoc_hndl("Associated Device Record", WORD(data + 0x04));
-			dmi_hp_203_assoc_hndl("Associated SMBus Record",  WORD(data + 0x06));
-			if (WORD(data + 0x08) == 0xffff && WORD(data + 0x0A) == 0xffff &&
-			    WORD(data + 0x0C) == 0xffff && WORD(data + 0x0E) == 0xffff &&
-			    data[0x10] == 0xFF && data[0x11] == 0xFF)
-			{
-				pr_attr("PCI Device Info", "Device Not Present");
-			}
-			else
-			{
-				dmi_hp_203_pciinfo("PCI Vendor ID", WORD(data + 0x08));
-				dmi_hp_203_pciinfo("PCI Device ID", WORD(data + 0x0A));
-				dmi_hp_203_pciinfo("PCI Sub Vendor ID", WORD(data + 0x0C));
-				dmi_hp_203_pciinfo("PCI Sub Device ID", WORD(data + 0x0E));
-				dmi_hp_203_pciinfo("PCI Class Code", (char)data[0x10]);
-				dmi_hp_203_pciinfo("PCI Sub Class Code", (char)data[0x11]);
-			}
-			dmi_hp_203_assoc_hndl("Parent Handle", WORD(data + 0x12));
-			pr_attr("Flags", "0x%04X", WORD(data + 0x14));
-			dmi_hp_203_devtyp("Device Type", data[0x16]);
-			dmi_hp_203_devloc("Device Location", data[0x17]);
-			pr_attr("Device Instance", "%d", data[0x18]);
-			pr_attr("Device Sub-Instance", "%d", data[0x19]);
-			dmi_hp_203_bayenc("Bay", data[0x1A]);
-			dmi_hp_203_bayenc("Enclosure", data[0x1B]);
-			pr_attr("Device Path", "%s", dmi_string(h, data[0x1C]));
-			pr_attr("Structured Name", "%s", dmi_string(h, data[0x1D]));
-			pr_attr("Device Name", "%s", dmi_string(h, data[0x1E]));
-			if (h->length < 0x22) break;
-			pr_attr("UEFI Location", "%s", dmi_string(h, data[0x1F]));
-			if (!(opt.flags & FLAG_QUIET))
-			{
-				if (WORD(data + 0x14) & 1)
-					pr_attr("Associated Real/Phys Handle", "0x%04X",
-						WORD(data + 0x20));
-				else
-					pr_attr("Associated Real/Phys Handle", "N/A");
-			}
-			if (h->length < 0x24) break;
-			pr_attr("PCI Part Number", "%s", dmi_string(h, data[0x22]));
-			pr_attr("Serial Number", "%s", dmi_string(h, data[0x23]));
-			if (h->length < 0x28) break;
-			pr_attr("Segment Group Number", "0x%04x", WORD(data + 0x24));
-			pr_attr("PCI Device", "%02x:%02x.%x",
-				data[0x26], data[0x27] >> 3, data[0x27] & 7);
-			break;
+		dmi_print_hp_net_iface_rec(ctx, nic,
+					   data[ptr + 0x01],
+					   data[ptr],
+					   &data[ptr + 0x02]);
+		nic++;
+		ptr += 8;
+	}
+	return 1;
+}
 
-		case 204:
-			/*
-			 * Vendor Specific: HPE ProLiant System/Rack Locator
-			 */
-			pr_handle_name("%s ProLiant System/Rack Locator", company);
-			if (h->length < 0x0B) break;
-			pr_attr("Rack Name", "%s", dmi_string(h, data[0x04]));
-			pr_attr("Enclosure Name", "%s", dmi_string(h, data[0x05]));
-			pr_attr("Enclosure Model", "%s", dmi_string(h, data[0x06]));
-			pr_attr("Enclosure Serial", "%s", dmi_string(h, data[0x0A]));
-			pr_attr("Enclosure Bays", "%d", data[0x08]);
-			pr_attr("Server Bay", "%s", dmi_string(h, data[0x07]));
-			pr_attr("Bays Filled", "%d", data[0x09]);
-			break;
+static int dmi_decode_hp_212(struct dmi_context *ctx,
+			     const struct dmi_header *h)
+{
+	u8 *data = h->data;
+	const char *company = ctx->oem->name;
 
-		case 209:
-		case 221:
-			/*
-			 * Vendor Specific: HPE ProLiant NIC MAC Information
-			 *
-			 * This prints the BIOS NIC number,
-			 * PCI bus/device/function, and MAC address
-			 *
-			 * Type 209:
-			 * Offset |  Name  | Width | Description
-			 * -------------------------------------
-			 *  0x00  |  Type  | BYTE  | 0xD1, MAC Info
-			 *  0x01  | Length | BYTE  | Length of structure
-			 *  0x02  | Handle | WORD  | Unique handle
-			 *  0x04  | Dev No | BYTE  | PCI Device/Function No
-			 *  0x05  | Bus No | BYTE  | PCI Bus
-			 *  0x06  |   MAC  | 6B    | MAC addr
-			 *  0x0C  | NIC #2 | 8B    | Repeat 0x04-0x0B
-			 *
-			 * Type 221: is deprecated in the latest docs
-			 */
-			pr_handle_name("%s %s", company, h->type == 221 ?
-				       "BIOS iSCSI NIC PCI and MAC Information" :
-				       "BIOS PXE NIC PCI and MAC Information");
-			nic = 1;
-			ptr = 4;
-			while (h->length >= ptr + 8)
-			{
-				dmi_print_hp_net_iface_rec(nic,
-							   data[ptr + 0x01],
-							   data[ptr],
-							   &data[ptr + 0x02]);
-				nic++;
-				ptr += 8;
-			}
-			break;
+	/*
+	 * Vendor Specific: HPE 64-bit CRU Information
+	 *
+	 * Source: hpwdt kernel driver
+	 */
+	pr_handle_name("%s 64-bit CRU Information", company);
+	if (h->length < 0x18) return 1;
+	if (is_printable(data + 0x04, 4))
+		pr_attr("Signature", "0x%08x (%c%c%c%c)",
+			DWORD(data + 0x04),
+			data[0x04], data[0x05],
+			data[0x06], data[0x07]);
+	else
+		pr_attr("Signature", "0x%08x", DWORD(data + 0x04));
+	if (DWORD(data + 0x04) == 0x55524324)
+	{
+		u64 paddr = QWORD(data + 0x08);
+		paddr.l += DWORD(data + 0x14);
+		if (paddr.l < DWORD(data + 0x14))
+			paddr.h++;
+		pr_attr("Physical Address", "0x%08x%08x",
+			paddr.h, paddr.l);
+		pr_attr("Length", "0x%08x", DWORD(data + 0x10));
+	}
+	return 1;
+}
 
-		case 212:
-			/*
-			 * Vendor Specific: HPE 64-bit CRU Information
-			 *
-			 * Source: hpwdt kernel driver
-			 */
-			pr_handle_name("%s 64-bit CRU Information", company);
-			if (h->length < 0x18) break;
-			if (is_printable(data + 0x04, 4))
-				pr_attr("Signature", "0x%08x (%c%c%c%c)",
-					DWORD(data + 0x04),
-					data[0x04], data[0x05],
-					data[0x06], data[0x07]);
-			else
-				pr_attr("Signature", "0x%08x", DWORD(data + 0x04));
-			if (DWORD(data + 0x04) == 0x55524324)
-			{
-				u64 paddr = QWORD(data + 0x08);
-				paddr.l += DWORD(data + 0x14);
-				if (paddr.l < DWORD(data + 0x14))
-					paddr.h++;
-				pr_attr("Physical Address", "0x%08x%08x",
-					paddr.h, paddr.l);
-				pr_attr("Length", "0x%08x", DWORD(data + 0x10));
-			}
-			break;
+static int dmi_decode_hp_219(struct dmi_context *ctx,
+			     const struct dmi_header *h)
+{
+	u8 *data = h->data;
+	const char *company = ctx->oem->name;
+	u32 feat;
 
-		case 219:
-			/*
-			 * Vendor Specific: HPE ProLiant Information
-			 *
-			 * Source: hpwdt kernel driver
-			 */
-			pr_handle_name("%s ProLiant Information", company);
-			if (h->length < 0x08) break;
-			pr_attr("Power Features", "0x%08x", DWORD(data + 0x04));
-			if (h->length < 0x0C) break;
-			pr_attr("Omega Features", "0x%08x", DWORD(data + 0x08));
-			if (h->length < 0x14) break;
-			feat = DWORD(data + 0x10);
-			pr_attr("Misc. Features", "0x%08x", feat);
-			pr_subattr("iCRU", "%s", feat & 0x0001 ? "Yes" : "No");
-			pr_subattr("UEFI", "%s", feat & 0x1400 ? "Yes" : "No");
-			break;
+	/*
+	 * Vendor Specific: HPE ProLiant Information
+	 *
+	 * Source: hpwdt kernel driver
+	 */
+	pr_handle_name("%s ProLiant Information", company);
+	if (h->length < 0x08) return 1;
+	pr_attr("Power Features", "0x%08x", DWORD(data + 0x04));
+	if (h->length < 0x0C) return 1;
+	pr_attr("Omega Features", "0x%08x", DWORD(data + 0x08));
+	if (h->length < 0x14) return 1;
+	feat = DWORD(data + 0x10);
+	pr_attr("Misc. Features", "0x%08x", feat);
+	pr_subattr("iCRU", "%s", feat & 0x0001 ? "Yes" : "No");
+	pr_subattr("UEFI", "%s", feat & 0x1400 ? "Yes" : "No");
+	return 1;
+}
 
-		case 233:
-			/*
-			 * Vendor Specific: HPE ProLiant NIC MAC Information
-			 *
-			 * This prints the BIOS NIC number,
-			 * PCI bus/device/function, and MAC address
-			 *
-			 * Offset |  Name  | Width | Description
-			 * -------------------------------------
-			 *  0x00  |  Type  | BYTE  | 0xE9, NIC structure
-			 *  0x01  | Length | BYTE  | Length of structure
-			 *  0x02  | Handle | WORD  | Unique handle
-			 *  0x04  | Grp No | WORD  | 0 for single segment
-			 *  0x06  | Bus No | BYTE  | PCI Bus
-			 *  0x07  | Dev No | BYTE  | PCI Device/Function No
-			 *  0x08  |   MAC  | 32B   | MAC addr padded w/ 0s
-			 *  0x28  | Port No| BYTE  | Each NIC maps to a Port
-			 */
-			pr_handle_name("%s BIOS PXE NIC PCI and MAC Information",
-				       company);
-			if (h->length < 0x0E) break;
-			/* If the record isn't long enough, we don't have an ID
-			 * use 0xFF to use the internal counter.
-			 * */
-			nic = h->length > 0x28 ? data[0x28] : 0xFF;
-			dmi_print_hp_net_iface_rec(nic, data[0x06], data[0x07],
-						   &data[0x08]);
-			break;
+static int dmi_decode_hp_233(struct dmi_context *ctx,
+			     const struct dmi_header *h)
+{
+	u8 *data = h->data;
+	const char *company = ctx->oem->name;
+	int nic;
 
-		case 236:
-			/*
-			 * Vendor Specific: HPE ProLiant HDD Backplane
-			 *
-			 * Offset |  Name      | Width | Description
-			 * ---------------------------------------
-			 *  0x00  | Type       | BYTE  | 0xEC, HDD Backplane
-			 *  0x01  | Length     | BYTE  | Length of structure
-			 *  0x02  | Handle     | WORD  | Unique handle
-			 *  0x04  | I2C Address| BYTE  | Backplane FRU I2C Address
-			 *  0x05  | Box Number | WORD  | Backplane Box Number
-			 *  0x07  | NVRAM ID   | WORD  | Backplane NVRAM ID
-			 *  0x09  | WWID       | QWORD | SAS Expander WWID
-			 *  0x11  | Total Bays | BYTE  | Total SAS Bays
-			 *  0x12  | A0 Bays    | BYTE  | (deprecated) Number of SAS drive bays behind port 0xA0
-			 *  0x13  | A2 Bays    | BYTE  | (deprecated) Number of SAS drive bays behind port 0xA2
-			 *  0x14  | Name       | STRING| (deprecated) Backplane Name
-			 */
-			pr_handle_name("%s HDD Backplane FRU Information", company);
-			if (h->length < 0x08) break;
-			pr_attr("FRU I2C Address", "0x%X raw(0x%X)", data[0x4] >> 1, data[0x4]);
-			pr_attr("Box Number", "%d", WORD(data + 0x5));
-			pr_attr("NVRAM ID", "0x%X", WORD(data + 0x7));
-			if (h->length < 0x11) break;
-			pr_attr("SAS Expander WWID", "0x%X", QWORD(data + 0x9));
-			if (h->length < 0x12) break;
-			pr_attr("Total SAS Bays", "%d", data[0x11]);
-			if (h->length < 0x15) break;
-			if (gen < G10P) {
-				pr_attr("A0 Bay Count", "%d", data[0x12]);
-				pr_attr("A2 Bay Count", "%d", data[0x13]);
-				pr_attr("Backplane Name", "%s", dmi_string(h, data[0x14]));
-			}
-			break;
+	/*
+	 * Vendor Specific: HPE ProLiant NIC MAC Information
+	 *
+	 * This prints the BIOS NIC number,
+	 * PCI bus/device/function, and MAC address
+	 *
+	 * Offset |  Name  | Width | Description
+	 * -------------------------------------
+	 *  0x00  |  Type  | BYTE  | 0xE9, NIC structure
+	 *  0x01  | Length | BYTE  | Length of structure
+	 *  0x02  | Handle | WORD  | Unique handle
+	 *  0x04  | Grp No | WORD  | 0 for single segment
+	 *  0x06  | Bus No | BYTE  | PCI Bus
+	 *  0x07  | Dev No | BYTE  | PCI Device/Function No
+	 *  0x08  |   MAC  | 32B   | MAC addr padded w/ 0s
+	 *  0x28  | Port No| BYTE  | Each NIC maps to a Port
+	 */
+	pr_handle_name("%s BIOS PXE NIC PCI and MAC Information",
+		       company);
+	if (h->length < 0x0E) return 1;
+	/* If the record isn't long enough, we don't have an ID
+	 * use 0xFF to use the internal counter.
+	 * */
+	nic = h->length > 0x28 ? data[0x28] : 0xFF;
+	dmi_print_hp_net_iface_rec(ctx, nic, data[0x06], data[0x07],
+				   &data[0x08]);
+	return 1;
+}
 
-		case 240:
-			/*
-			 * Vendor Specific: HPE Proliant Inventory Record
-			 *
-			 * Reports firmware version information for devices that report their
-			 * firmware using their UEFI drivers. Additionally provides association
-			 * with other SMBIOS records, such as Type 203 (which in turn is
-			 * associated with Types 9, 41, and 228).
-			 *
-			 * Offset |  Name      | Width | Description
-			 * ---------------------------------------
-			 *  0x00  | Type       | BYTE  | 0xF0, HP Firmware Inventory Record
-			 *  0x01  | Length     | BYTE  | Length of structure
-			 *  0x02  | Handle     | WORD  | Unique handle
-			 *  0x04  | Hndl Assoc | WORD  | Handle to map to Type 203
-			 *  0x06  | Pkg Vers   | DWORD | FW Vers Release of All FW in Device
-			 *  0x0A  | Ver String | STRING| FW Version String
-			 *  0x0B  | Image Size | QWORD | FW image size (bytes)
-			 *  0x13  | Attributes | QWORD | Bitfield: Is attribute defined?
-			 *  0x1B  | Attr Set   | QWORD | BitField: If defined, is attribute set?
-			 *  0x23  | Version    | DWORD | Lowest supported version.
-			 */
-			pr_handle_name("%s Proliant Inventory Record", company);
-			if (h->length < 0x27) break;
-			if (!(opt.flags & FLAG_QUIET))
-				pr_attr("Associated Handle", "0x%04X", WORD(data + 0x4));
-			pr_attr("Package Version", "0x%08X", DWORD(data + 0x6));
-			pr_attr("Version String", "%s", dmi_string(h, data[0x0A]));
-
-			if (DWORD(data + 0x0B))
-				dmi_print_memory_size("Image Size", QWORD(data + 0xB), 0);
-			else
-				pr_attr("Image Size", "Not Available");
-
-			dmi_hp_240_attr(QWORD(data + 0x13), QWORD(data + 0x1B));
-
-			if (DWORD(data + 0x23))
-				pr_attr("Lowest Supported Version", "0x%08X", DWORD(data + 0x23));
-			else
-				pr_attr("Lowest Supported Version", "Not Available");
-			break;
+static int dmi_decode_hp_236(struct dmi_context *ctx,
+			     const struct dmi_header *h)
+{
+	u8 *data = h->data;
+	const char *company = ctx->oem->name;
 
-		default:
-			return 0;
+	/*
+	 * Vendor Specific: HPE ProLiant HDD Backplane
+	 *
+	 * Offset |  Name      | Width | Description
+	 * ---------------------------------------
+	 *  0x00  | Type       | BYTE  | 0xEC, HDD Backplane
+	 *  0x01  | Length     | BYTE  | Length of structure
+	 *  0x02  | Handle     | WORD  | Unique handle
+	 *  0x04  | I2C Address| BYTE  | Backplane FRU I2C Address
+	 *  0x05  | Box Number | WORD  | Backplane Box Number
+	 *  0x07  | NVRAM ID   | WORD  | Backplane NVRAM ID
+	 *  0x09  | WWID       | QWORD | SAS Expander WWID
+	 *  0x11  | Total Bays | BYTE  | Total SAS Bays
+	 *  0x12  | A0 Bays    | BYTE  | (deprecated) Number of SAS drive bays behind port 0xA0
+	 *  0x13  | A2 Bays    | BYTE  | (deprecated) Number of SAS drive bays behind port 0xA2
+	 *  0x14  | Name       | STRING| (deprecated) Backplane Name
+	 */
+	pr_handle_name("%s HDD Backplane FRU Information", company);
+	if (h->length < 0x09) return 1;
+	pr_attr("FRU I2C Address", "0x%X raw(0x%X)", data[0x4] >> 1, data[0x4]);
+	pr_attr("Box Number", "%d", WORD(data + 0x5));
+	pr_attr("NVRAM ID", "0x%X", WORD(data + 0x7));
+	if (h->length < 0x11) return 1;
+	pr_attr("SAS Expander WWID", "0x%X", QWORD(data + 0x9));
+	if (h->length < 0x12) return 1;
+	pr_attr("Total SAS Bays", "%d", data[0x11]);
+	if (h->length < 0x15) return 1;
+	if (ctx->oem_gen < G10P) {
+		pr_attr("A0 Bay Count", "%d", data[0x12]);
+		pr_attr("A2 Bay Count", "%d", data[0x13]);
+		pr_attr("Backplane Name", "%s", dmi_string(h, data[0x14]));
 	}
 	return 1;
 }
 
-static int dmi_decode_ibm_lenovo(const struct dmi_header *h)
+static int dmi_decode_hp_240(struct dmi_context *ctx,
+			     const struct dmi_header *h)
 {
 	u8 *data = h->data;
+	const char *company = ctx->oem->name;
 
-	switch (h->type)
-	{
-		case 131:
-			/*
-			 * Vendor Specific: ThinkVantage Technologies feature bits
-			 *
-			 * Source: Compal hel81 Service Manual Software Specification,
-			 *         documented under "System Management BIOS(SM BIOS)
-			 *         version 2.4 or greater"
-			 *
-			 * Offset |  Name         | Width   | Description
-			 * ----------------------------------------------
-			 *  0x00  | Type          | BYTE    | 0x83
-			 *  0x01  | Length        | BYTE    | 0x16
-			 *  0x02  | Handle        | WORD    | Varies
-			 *  0x04  | Version       | BYTE    | 0x01
-			 *  0x05  | TVT Structure | BYTEx16 | Each of the 128 bits represents a TVT feature:
-			 *        |               |         |  - bit 127 means diagnostics (PC Doctor) is available
-			 *        |               |         |    (http://www.pc-doctor.com/company/pr-articles/45-lenovo-introduces-thinkvantage-toolbox)
-			 *        |               |         |  - the rest (126-0) are reserved/unknown
-			 *
-			 * It must also be followed by a string containing
-			 * "TVT-Enablement". There exist other type 131 records
-			 * with different length and a different string, for
-			 * other purposes.
-			 */
-
-			if (h->length != 0x16
-			 || strcmp(dmi_string(h, 1), "TVT-Enablement") != 0)
-				return 0;
-
-			pr_handle_name("ThinkVantage Technologies");
-			pr_attr("Version", "%u", data[0x04]);
-			pr_attr("Diagnostics", "%s",
-				data[0x14] & 0x80 ? "Available" : "No");
-			break;
+	/*
+	 * Vendor Specific: HPE Proliant Inventory Record
+	 *
+	 * Reports firmware version information for devices that report their
+	 * firmware using their UEFI drivers. Additionally provides association
+	 * with other SMBIOS records, such as Type 203 (which in turn is
+	 * associated with Types 9, 41, and 228).
+	 *
+	 * Offset |  Name      | Width | Description
+	 * ---------------------------------------
+	 *  0x00  | Type       | BYTE  | 0xF0, HP Firmware Inventory Record
+	 *  0x01  | Length     | BYTE  | Length of structure
+	 *  0x02  | Handle     | WORD  | Unique handle
+	 *  0x04  | Hndl Assoc | WORD  | Handle to map to Type 203
+	 *  0x06  | Pkg Vers   | DWORD | FW Vers Release of All FW in Device
+	 *  0x0A  | Ver String | STRING| FW Version String
+	 *  0x0B  | Image Size | QWORD | FW image size (bytes)
+	 *  0x13  | Attributes | QWORD | Bitfield: Is attribute defined?
+	 *  0x1B  | Attr Set   | QWORD | BitField: If defined, is attribute set?
+	 *  0x23  | Version    | DWORD | Lowest supported version.
+	 */
+	pr_handle_name("%s Proliant Inventory Record", company);
+	if (h->length < 0x27) return 1;
+	if (!(ctx->opt.flags & FLAG_QUIET))
+		pr_attr("Associated Handle", "0x%04X", WORD(data + 0x4));
+	pr_attr("Package Version", "0x%08X", DWORD(data + 0x6));
+	pr_attr("Version String", "%s", dmi_string(h, data[0x0A]));
+
+	if (DWORD(data + 0x0B))
+		dmi_print_memory_size("Image Size", QWORD(data + 0xB), 0);
+	else
+		pr_attr("Image Size", "Not Available");
 
-		case 135:
-			/*
-			 * Vendor Specific: Device Presence Detection bits
-			 *
-			 * Source: Compal hel81 Service Manual Software Specification,
-			 *         documented as "SMBIOS Type 135: Bulk for Lenovo
-			 *         Mobile PC Unique OEM Data" under appendix D.
-			 *
-			 * Offset |  Name                | Width | Description
-			 * ---------------------------------------------------
-			 *  0x00  | Type                 | BYTE  | 0x87
-			 *  0x01  | Length               | BYTE  | 0x0A
-			 *  0x02  | Handle               | WORD  | Varies
-			 *  0x04  | Signature            | WORD  | 0x5054 (ASCII for "TP")
-			 *  0x06  | OEM struct offset    | BYTE  | 0x07
-			 *  0x07  | OEM struct number    | BYTE  | 0x03, for this structure
-			 *  0x08  | OEM struct revision  | BYTE  | 0x01, for this format
-			 *  0x09  | Device presence bits | BYTE  | Each of the 8 bits indicates device presence:
-			 *        |                      |       |  - bit 0 indicates the presence of a fingerprint reader
-			 *        |                      |       |  - the rest (7-1) are reserved/unknown
-			 *
-			 * Other OEM struct number+rev combinations have been
-			 * seen in the wild but we don't know how to decode
-			 * them.
-			 */
-
-			if (h->length < 0x0A || data[0x04] != 'T' || data[0x05] != 'P')
-				return 0;
-
-			/* Bail out if not the expected format */
-			if (data[0x06] != 0x07 || data[0x07] != 0x03 || data[0x08] != 0x01)
-				return 0;
-
-			pr_handle_name("ThinkPad Device Presence Detection");
-			pr_attr("Fingerprint Reader", "%s",
-				data[0x09] & 0x01 ? "Present" : "No");
-			break;
+	dmi_hp_240_attr(QWORD(data + 0x13), QWORD(data + 0x1B));
 
-		case 140:
-			/*
-			 * Vendor Specific: ThinkPad Embedded Controller Program
-			 *
-			 * Source: some guesswork, and publicly available information;
-			 *         Lenovo's BIOS update READMEs often contain the ECP IDs
-			 *         which match the first string in this type.
-			 *
-			 * Offset |  Name                | Width  | Description
-			 * ----------------------------------------------------
-			 *  0x00  | Type                 | BYTE   | 0x8C
-			 *  0x01  | Length               | BYTE   |
-			 *  0x02  | Handle               | WORD   | Varies
-			 *  0x04  | Signature            | BYTEx6 | ASCII for "LENOVO"
-			 *  0x0A  | OEM struct offset    | BYTE   | 0x0B
-			 *  0x0B  | OEM struct number    | BYTE   | 0x07, for this structure
-			 *  0x0C  | OEM struct revision  | BYTE   | 0x01, for this format
-			 *  0x0D  | ECP version ID       | STRING |
-			 *  0x0E  | ECP release date     | STRING |
-			 */
-
-			if (h->length < 0x0F || memcmp(data + 4, "LENOVO", 6) != 0)
-				return 0;
-
-			/* Bail out if not the expected format */
-			if (data[0x0A] != 0x0B || data[0x0B] != 0x07 || data[0x0C] != 0x01)
-				return 0;
-
-			pr_handle_name("ThinkPad Embedded Controller Program");
-			pr_attr("Version ID", "%s", dmi_string(h, 1));
-			pr_attr("Release Date", "%s", dmi_string(h, 2));
-			break;
+	if (DWORD(data + 0x23))
+		pr_attr("Lowest Supported Version", "0x%08X", DWORD(data + 0x23));
+	else
+		pr_attr("Lowest Supported Version", "Not Available");
+	return 1;
+}
 
-		default:
-			return 0;
-	}
+static const struct dmi_oem_decoder dmi_hp_decoder[] = {
+	{ 203,	dmi_decode_hp_203 },
+	{ 204,	dmi_decode_hp_204 },
+	{ 209,	dmi_decode_hp_209 },
+	{ 221,	dmi_decode_hp_209 },
+	{ 212,	dmi_decode_hp_212 },
+	{ 219,	dmi_decode_hp_219 },
+	{ 233,	dmi_decode_hp_233 },
+	{ 236,	dmi_decode_hp_236 },
+	{ 240,	dmi_decode_hp_240 },
+	{ 0, NULL }
+};
+
+/* Only ProLiant and the like are decoded, according to their generation */
+static int dmi_hp_init(struct dmi_context *ctx)
+{
+	ctx->oem_gen = dmi_hpegen(ctx->product, G6);
+	return ctx->oem_gen < 0 ? -1 : 0;
+}
+
+static int dmi_hpe_init(struct dmi_context *ctx)
+{
+	ctx->oem_gen = dmi_hpegen(ctx->product, G10P);
+	return ctx->oem_gen < 0 ? -1 : 0;
+}
+
+static const char * const dmi_hp_match[] = { "HP", "Hewlett-Packard", NULL };
+static const char * const dmi_hpe_match[] = {
+	"HPE", "Hewlett Packard Enterprise", NULL
+};
+
+/* NIC records without an id are numbered in table order */
+static const struct dmi_oem_vendor dmi_oem_hp = {
+	"HP", dmi_hp_match, dmi_hp_decoder, dmi_hp_init, 1
+};
+
+static const struct dmi_oem_vendor dmi_oem_hpe = {
+	"HPE", dmi_hpe_match, dmi_hp_decoder, dmi_hpe_init, 1
+};
+#endif
+
+#if !defined CONFIG_OEM || defined CONFIG_OEM_LENOVO
+/*
+ * IBM and Lenovo-specific data structures are decoded here.
+ */
+
+static int dmi_decode_lenovo_131(MAYBE_UNUSED struct dmi_context *ctx,
+				  const struct dmi_header *h)
+{
+	u8 *data = h->data;
+
+	/*
+	 * Vendor Specific: ThinkVantage Technologies feature bits
+	 *
+	 * Source: Compal hel81 Service Manual Software Specification,
+	 *         documented under "System Management BIOS(SM BIOS)
+	 *         version 2.4 or greater"
+	 *
+	 * Offset |  Name         | Width   | Description
+	 * ----------------------------------------------
+	 *  0x00  | Type          | BYTE    | 0x83
+	 *  0x01  | Length        | BYTE    | 0x16
+	 *  0x02  | Handle        | WORD    | Varies
+	 *  0x04  | Version       | BYTE    | 0x01
+	 *  0x05  | TVT Structure | BYTEx16 | Each of the 128 bits represents a TVT feature:
+	 *        |               |         |  - bit 127 means diagnostics (PC Doctor) is available
+	 *        |               |         |    (http://www.pc-doctor.com/company/pr-articles/45-lenovo-introduces-thinkvantage-toolbox)
+	 *        |               |         |  - the rest (126-0) are reserved/unknown
+	 *
+	 * It must also be followed by a string containing
+	 * "TVT-Enablement". There exist other type 131 records
+	 * with different length and a different string, for
+	 * other purposes.
+	 */
+
+	if (h->length != 0x16
+	 || strcmp(dmi_string(h, 1), "TVT-Enablement") != 0)
+		return 0;
+
+	pr_handle_name("ThinkVantage Technologies");
+	pr_attr("Version", "%u", data[0x04]);
+	pr_attr("Diagnostics", "%s",
+		data[0x14] & 0x80 ? "Available" : "No");
+	return 1;
+}
+
+static int dmi_decode_lenovo_135(MAYBE_UNUSED struct dmi_context *ctx,
+				  const struct dmi_header *h)
+{
+	u8 *data = h->data;
+
+	/*
+	 * Vendor Specific: Device Presence Detection bits
+	 *
+	 * Source: Compal hel81 Service Manual Software Specification,
+	 *         documented as "SMBIOS Type 135: Bulk for Lenovo
+	 *         Mobile PC Unique OEM Data" under appendix D.
+	 *
+	 * Offset |  Name                | Width | Description
+	 * ---------------------------------------------------
+	 *  0x00  | Type                 | BYTE  | 0x87
+	 *  0x01  | Length               | BYTE  | 0x0A
+	 *  0x02  | Handle               | WORD  | Varies
+	 *  0x04  | Signature            | WORD  | 0x5054 (ASCII for "TP")
+	 *  0x06  | OEM struct offset    | BYTE  | 0x07
+	 *  0x07  | OEM struct number    | BYTE  | 0x03, for this structure
+	 *  0x08  | OEM struct revision  | BYTE  | 0x01, for this format
+	 *  0x09  | Device presence bits | BYTE  | Each of the 8 bits indicates device presence:
+	 *        |                      |       |  - bit 0 indicates the presence of a fingerprint reader
+	 *        |                      |       |  - the rest (7-1) are reserved/unknown
+	 *
+	 * Other OEM struct number+rev combinations have been
+	 * seen in the wild but we don't know how to decode
+	 * them.
+	 */
+
+	if (h->length < 0x0A || data[0x04] != 'T' || data[0x05] != 'P')
+		return 0;
+
+	/* Bail out if not the expected format */
+	if (data[0x06] != 0x07 || data[0x07] != 0x03 || data[0x08] != 0x01)
+		return 0;
+
+	pr_handle_name("ThinkPad Device Presence Detection");
+	pr_attr("Fingerprint Reader", "%s",
+		data[0x09] & 0x01 ? "Present" : "No");
+	return 1;
+}
+
+static int dmi_decode_lenovo_140(MAYBE_UNUSED struct dmi_context *ctx,
+				  const struct dmi_header *h)
+{
+	u8 *data = h->data;
+
+	/*
+	 * Vendor Specific: ThinkPad Embedded Controller Program
+	 *
+	 * Source: some guesswork, and publicly available information;
+	 *         Lenovo's BIOS update READMEs often contain the ECP IDs
+	 *         which match the first string in this type.
+	 *
+	 * Offset |  Name                | Width  | Description
+	 * ----------------------------------------------------
+	 *  0x00  | Type                 | BYTE   | 0x8C
+	 *  0x01  | Length               | BYTE   |
+	 *  0x02  | Handle               | WORD   | Varies
+	 *  0x04  | Signature            | BYTEx6 | ASCII for "LENOVO"
+	 *  0x0A  | OEM struct offset    | BYTE   | 0x0B
+	 *  0x0B  | OEM struct number    | BYTE   | 0x07, for this structure
+	 *  0x0C  | OEM struct revision  | BYTE   | 0x01, for this format
+	 *  0x0D  | ECP version ID       | STRING |
+	 *  0x0E  | ECP release date     | STRING |
+	 */
+
+	if (h->length < 0x0F || memcmp(data + 4, "LENOVO", 6) != 0)
+		return 0;
+
+	/* Bail out if not the expected format */
+	if (data[0x0A] != 0x0B || data[0x0B] != 0x07 || data[0x0C] != 0x01)
+		return 0;
+
+	pr_handle_name("ThinkPad Embedded Controller Program");
+	pr_attr("Version ID", "%s", dmi_string(h, 1));
+	pr_attr("Release Date", "%s", dmi_string(h, 2));
 	return 1;
 }
 
+static const struct dmi_oem_decoder dmi_lenovo_decoder[] = {
+	{ 131,	dmi_decode_lenovo_131 },
+	{ 135,	dmi_decode_lenovo_135 },
+	{ 140,	dmi_decode_lenovo_140 },
+	{ 0, NULL }
+};
+
+static const char * const dmi_lenovo_match[] = { "IBM", "LENOVO", NULL };
+
+static const struct dmi_oem_vendor dmi_oem_lenovo = {
+	"Lenovo", dmi_lenovo_match, dmi_lenovo_decoder, NULL, 0
+};
+#endif
+
+/*
+ * Vendor modules, in the order their manufacturer names are tried, those
+ * left out of minimal builds excepted (see config.h)
+ */
+static const struct dmi_oem_vendor * const dmi_oem_vendors[] = {
+#if !defined CONFIG_OEM || defined CONFIG_OEM_ACER
+	&dmi_oem_acer,
+#endif
+#if !defined CONFIG_OEM || defined CONFIG_OEM_HP
+	&dmi_oem_hp,
+	&dmi_oem_hpe,
+#endif
+#if !defined CONFIG_OEM || defined CONFIG_OEM_LENOVO
+	&dmi_oem_lenovo,
+#endif
+	NULL
+};
+
+/* Return 1 if the first len characters of s are exactly name */
+static int dmi_oem_match(const char *name, const char *s, size_t len)
+{
+	return strncmp(s, name, len) == 0 && name[len] == '\0';
+}
+
 /*
- * Dispatch vendor-specific entries decoding
- * Return 1 if decoding was successful, 0 otherwise
+ * Remember the system vendor for later use. We only actually store the
+ * value if we know how to decode at least one specific entry type for
+ * that vendor. Must be called before decoding each table, with NULL
+ * strings if the table has no System Information structure.
  */
-int dmi_decode_oem(const struct dmi_header *h)
+void dmi_set_vendor(struct dmi_context *ctx, const char *v, const char *p)
 {
-	switch (dmi_vendor)
+	const struct dmi_oem_vendor *vendor = NULL;
+	const struct dmi_oem_decoder *d;
+	unsigned int i, j;
+	size_t len;
+
+	ctx->oem = NULL;
+	memset(ctx->oem_decode, 0, sizeof(ctx->oem_decode));
+	ctx->oem_gen = 0;
+	ctx->nic_ctr = 0;
+	ctx->product = p;
+
+	/*
+	 * Often DMI strings have trailing spaces. Ignore these
+	 * when checking for known vendor names.
+	 */
+	len = v ? strlen(v) : 0;
+	while (len && v[len - 1] == ' ')
+		len--;
+	if (len == 0)
+		return;
+
+	for (i = 0; dmi_oem_vendors[i] != NULL && vendor == NULL; i++)
+		for (j = 0; dmi_oem_vendors[i]->match[j] != NULL; j++)
+			if (dmi_oem_match(dmi_oem_vendors[i]->match[j], v, len))
+			{
+				vendor = dmi_oem_vendors[i];
+				break;
+			}
+	if (vendor == NULL)
+		return;
+
+	ctx->oem = vendor;
+	if (vendor->init != NULL && vendor->init(ctx) < 0)
 	{
-		case VENDOR_HP:
-		case VENDOR_HPE:
-			return dmi_decode_hp(h);
-		case VENDOR_ACER:
-			return dmi_decode_acer(h);
-		case VENDOR_IBM:
-		case VENDOR_LENOVO:
-			return dmi_decode_ibm_lenovo(h);
-		default:
-			return 0;
+		ctx->oem = NULL;
+		return;
 	}
+	for (d = vendor->decoder; d->type; d++)
+		ctx->oem_decode[d->type - 128] = d->decode;
+}
+
+/*
+ * Dispatch vendor-specific entries decoding
+ * Return 1 if decoding was successful, 0 otherwise
+ */
+int dmi_decode_oem(struct dmi_context *ctx, const struct dmi_header *h)
+{
+	if (h->type < 128 || ctx->oem_decode[h->type - 128] == NULL)
+		return 0;
+	return ctx->oem_decode[h->type - 128](ctx, h);
+}
+
+/*
+ * Return 1 if the vendor-specific entries depend on the previous ones, so
+ * that the table must be decoded in order
+ */
+int dmi_oem_ordered(const struct dmi_context *ctx)
+{
+	return ctx->oem != NULL && ctx->oem->ordered;
 }
@@ -20,6 +20,8 @@
  */
 
 struct dmi_header;
+struct dmi_context;
 
-void dmi_set_vendor(const char *s, const char *p);
-int dmi_decode_oem(const struct dmi_header *h);
+void dmi_set_vendor(struct dmi_context *ctx, const char *s, const char *p);
+int dmi_decode_oem(struct dmi_context *ctx, const struct dmi_header *h);
+int dmi_oem_ordered(const struct dmi_context *ctx);
@@ -30,10 +30,7 @@
 #include "util.h"
 #include "dmidecode.h"
 #include "dmiopt.h"
-
-
-/* Options are global */
-struct opt opt;
+#include "dmioutput.h"
 
 
 /*
@@ -79,21 +76,11 @@ static void print_opt_type_list(void)
 	}
 }
 
+/* Adds the types of arg to p, the 256 entries of opt.type_map */
 static u8 *parse_opt_type(u8 *p, const char *arg)
 {
 	unsigned int i;
 
-	/* Allocate memory on first call only */
-	if (p == NULL)
-	{
-		p = (u8 *)calloc(256, sizeof(u8));
-		if (p == NULL)
-		{
-			perror(u"calloc");
-			return NULL;
-		}
-	}
-
 	/* First try as a keyword */
 	for (i = 0; i < ARRAY_SIZE(opt_type_keyword); i++)
 	{
@@ -117,12 +104,12 @@ static u8 *parse_opt_type(u8 *p, const char *arg)
 		{
 			printf(u"Invalid type keyword: %s\n", arg);
 			print_opt_type_list();
-			goto exit_free;
+			return NULL;
 		}
 		if (val > 0xff)
 		{
 			printf(u"Invalid type number: %lu\n", val);
-			goto exit_free;
+			return NULL;
 		}
 
 		p[val] = 1;
@@ -133,10 +120,6 @@ static u8 *parse_opt_type(u8 *p, const char *arg)
 
 found:
 	return p;
-
-exit_free:
-	free(p);
-	return NULL;
 }
 
 
@@ -177,7 +160,7 @@ static const struct string_keyword opt_string_keyword[] = {
 };
 
 /* This is a template, 3rd field is set at runtime. */
-static struct string_keyword opt_oem_string_keyword =
+static const struct string_keyword opt_oem_string_keyword =
 	{ NULL, 11, 0x00 };
 
 static void print_opt_string_list(void)
@@ -191,23 +174,31 @@ static void print_opt_string_list(void)
 	}
 }
 
-static int parse_opt_string(const char *arg)
+/* Queue a string query, they are answered in command line order */
+static int add_opt_string(struct opt *opt, const struct string_keyword *ks)
 {
-	unsigned int i;
+	struct string_keyword *p;
 
-	if (opt.string)
+	p = realloc(opt->string, (opt->string_count + 1) * sizeof(*p));
+	if (p == NULL)
 	{
-		printf(u"Only one string can be specified\n");
+		perror(u"realloc");
 		return -1;
 	}
 
+	p[opt->string_count++] = *ks;
+	opt->string = p;
+	return 0;
+}
+
+static int parse_opt_string(struct opt *opt, const char *arg)
+{
+	unsigned int i;
+
 	for (i = 0; i < ARRAY_SIZE(opt_string_keyword); i++)
 	{
 		if (!strcasecmp(arg, opt_string_keyword[i].keyword))
-		{
-			opt.string = &opt_string_keyword[i];
-			return 0;
-		}
+			return add_opt_string(opt, &opt_string_keyword[i]);
 	}
 
 	printf(u"Invalid string keyword: %s\n", arg);
@@ -215,20 +206,18 @@ static int parse_opt_string(const char *arg)
 	return -1;
 }
 
-static int parse_opt_oem_string(const char *arg)
+static int parse_opt_oem_string(struct opt *opt, const char *arg)
 {
+	struct string_keyword ks = opt_oem_string_keyword;
 	unsigned long val;
 	char *next;
 
-	if (opt.string)
-	{
-		printf(u"Only one string can be specified\n");
-		return -1;
-	}
-
 	/* Return the number of OEM strings */
 	if (strcmp(arg, u"count") == 0)
+	{
+		ks.offset = 0;
 		goto done;
+	}
 
 	val = strtoul(arg, &next, 10);
 	if (next == arg  || *next != '\0' || val == 0x00 || val > 0xff)
@@ -237,9 +226,41 @@ static int parse_opt_oem_string(const char *arg)
 		return -1;
 	}
 
-	opt_oem_string_keyword.offset = val;
+	ks.offset = val;
 done:
-	opt.string = &opt_oem_string_keyword;
+	return add_opt_string(opt, &ks);
+}
+
+/*
+ * Select an attribute of a structure type, as TYPE:NAME. The structures of
+ * this type are displayed, with only their selected attributes.
+ */
+static int parse_opt_field(struct opt *opt, const char *arg)
+{
+	struct field_keyword *p;
+	unsigned long val;
+	char *next;
+
+	val = strtoul(arg, &next, 0);
+	if (next == arg || *next != ':' || next[1] == '\0' || val > 0xff)
+	{
+		printf(u"Invalid field: %s\n", arg);
+		printf(u"Fields are given as TYPE:NAME, for example 17:\"Part Number\"\n");
+		return -1;
+	}
+
+	opt->type = opt->type_map;
+	opt->type[val] = 1;
+
+	p = realloc(opt->field, (opt->field_count + 1) * sizeof(*p));
+	if (p == NULL)
+	{
+		perror(u"realloc");
+		return -1;
+	}
+	p[opt->field_count].type = val;
+	p[opt->field_count++].name = next + 1;
+	opt->field = p;
 	return 0;
 }
 
@@ -257,12 +278,177 @@ static u32 parse_opt_handle(const char *arg)
 	return val;
 }
 
+static int parse_opt_chunk_size(struct opt *opt, const char *arg)
+{
+	unsigned long val;
+	char *next;
+
+	val = strtoul(arg, &next, 0);
+	if (next == arg || *next != '\0')
+	{
+		printf(u"Invalid chunk size: %s\n", arg);
+		return -1;
+	}
+
+	opt->chunk_size = val;
+	return 0;
+}
+
+static int parse_opt_format(struct opt *opt, const char *arg)
+{
+	static const struct {
+		const char *name;
+		int format;
+	} formats[] = {
+		{ u"text", OUTPUT_TEXT },
+#if !defined CONFIG_FORMATS || defined CONFIG_FORMAT_JSON
+		{ u"json", OUTPUT_JSON },
+#endif
+#if !defined CONFIG_FORMATS || defined CONFIG_FORMAT_KEYVALUE
+		{ u"keyvalue", OUTPUT_KEYVALUE },
+#endif
+	};
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(formats); i++)
+		if (!strcasecmp(arg, formats[i].name))
+		{
+			opt->format = formats[i].format;
+			return 0;
+		}
+
+	printf(u"Invalid output format: %s\n", arg);
+	printf(u"Valid output formats are:\n");
+	for (i = 0; i < ARRAY_SIZE(formats); i++)
+		printf(u"  %s\n", formats[i].name);
+	return -1;
+}
+
+static int parse_opt_jobs(struct opt *opt, const char *arg)
+{
+	unsigned long val;
+	char *next;
+
+	val = strtoul(arg, &next, 0);
+	if (next == arg || *next != '\0' || val == 0 || val > 1024)
+	{
+		printf(u"Invalid number of jobs: %s\n", arg);
+		return -1;
+	}
+
+	opt->jobs = val;
+	return 0;
+}
+
+static int parse_opt_watch(struct opt *opt, const char *arg)
+{
+	unsigned long val;
+	char *next;
+
+#ifndef USE_WATCH
+	printf(u"Option --watch isn't supported on this platform\n");
+	return -1;
+#endif
+	val = strtoul(arg, &next, 0);
+	if (next == arg || *next != '\0' || val == 0 || val > 86400)
+	{
+		printf(u"Invalid watch interval: %s\n", arg);
+		return -1;
+	}
+
+	opt->watch = val;
+	return 0;
+}
+
+/*
+ * Handling of batch mode dump files
+ */
+
+/* Queue a dump file, outputs are written in the same order */
+static int add_opt_batch_file(struct opt *opt, const char *name)
+{
+	size_t len = strlen(name) + 1;
+	char **p;
+
+	p = realloc(opt->batch_file, (opt->batch_count + 1) * sizeof(*p));
+	if (p == NULL)
+	{
+		perror(u"realloc");
+		return -1;
+	}
+	opt->batch_file = p;
+
+	if ((p[opt->batch_count] = malloc(len)) == NULL)
+	{
+		perror(u"malloc");
+		return -1;
+	}
+	memcpy(p[opt->batch_count++], name, len);
+	return 0;
+}
+
+/* Read dump file names from a manifest, one per line ("-": stdin) */
+static int parse_opt_manifest(struct opt *opt, const char *arg)
+{
+	char line[4096];
+	size_t len;
+	FILE *f;
+	int ret = 0;
+
+	if (strcmp(arg, u"-") == 0)
+		f = stdin;
+	else if ((f = fopen(arg, u"r")) == NULL)
+	{
+		perror(arg);
+		return -1;
+	}
+
+	while (ret == 0 && fgets(line, sizeof(line), f) != NULL)
+	{
+		len = strlen(line);
+		while (len && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+			line[--len] = '\0';
+
+		/* Skip empty lines and comments */
+		if (len == 0 || line[0] == '#')
+			continue;
+		ret = add_opt_batch_file(opt, line);
+	}
+
+	if (f != stdin)
+		fclose(f);
+	return ret;
+}
+
 /*
  * Command line options handling
  */
 
+/* Set default option values */
+void opt_init(struct opt *opt)
+{
+	memset(opt, 0, sizeof(*opt));
+	opt->devmem = DEFAULT_MEM_DEV;
+	opt->handle = ~0U;
+	opt->chunk_size = DEFAULT_CHUNK_SIZE;
+	opt->format = OUTPUT_TEXT;
+}
+
+/* Release what parse_command_line() allocated, and reset to defaults */
+void opt_free(struct opt *opt)
+{
+	unsigned int i;
+
+	free(opt->string);
+	free(opt->field);
+	for (i = 0; i < opt->batch_count; i++)
+		free(opt->batch_file[i]);
+	free(opt->batch_file);
+	opt_init(opt);
+}
+
 /* Return -1 on error, 0 on success */
-int parse_command_line(int argc, char * const argv[])
+int parse_command_line(struct opt *opt, int argc, char * const argv[])
 {
 	int option;
 	const char *optstring = u"d:hqs:t:uH:V";
@@ -272,64 +458,139 @@ int parse_command_line(int argc, char * const argv[])
 		{ u"quiet", no_argument, NULL, 'q' },
 		{ u"string", required_argument, NULL, 's' },
 		{ u"type", required_argument, NULL, 't' },
+		{ u"field", required_argument, NULL, 'L' },
 		{ u"dump", no_argument, NULL, 'u' },
+		{ u"compact", no_argument, NULL, 'X' },
 		{ u"dump-bin", required_argument, NULL, 'B' },
 		{ u"from-dump", required_argument, NULL, 'F' },
+		{ u"baseline", required_argument, NULL, 'A' },
+		{ u"diff", required_argument, NULL, 'D' },
+		{ u"snapshot", required_argument, NULL, 'P' },
+		{ u"cache", required_argument, NULL, 'K' },
+		{ u"batch", no_argument, NULL, 'b' },
+		{ u"manifest", required_argument, NULL, 'M' },
+		{ u"jobs", required_argument, NULL, 'j' },
 		{ u"handle", required_argument, NULL, 'H' },
 		{ u"oem-string", required_argument, NULL, 'O' },
 		{ u"no-sysfs", no_argument, NULL, 'S' },
+		{ u"chunk-size", required_argument, NULL, 'C' },
+		{ u"format", required_argument, NULL, 'f' },
+		{ u"stats", no_argument, NULL, 'T' },
+		{ u"memory", no_argument, NULL, 'Y' },
+		{ u"watch", required_argument, NULL, 'W' },
 		{ u"version", no_argument, NULL, 'V' },
 		{ NULL, 0, NULL, 0 }
 	};
 
+	/* Library contexts may parse several command lines, start over */
+#ifdef __GLIBC__
+	optind = 0;
+#else
+	optind = 1;
+#if defined __FreeBSD__ || defined __APPLE__
+	optreset = 1;
+#endif
+#endif
+
 	while ((option = getopt_long(argc, argv, optstring, longopts, NULL)) != -1)
 		switch (option)
 		{
 			case 'B':
-				opt.flags |= FLAG_DUMP_BIN;
-				opt.dumpfile = optarg;
+				opt->flags |= FLAG_DUMP_BIN;
+				opt->dumpfile = optarg;
+				break;
+			case 'P':
+				opt->flags |= FLAG_DUMP_BIN | FLAG_SNAPSHOT;
+				opt->dumpfile = optarg;
+				break;
+			case 'K':
+				opt->cache_file = optarg;
+				break;
+			case 'b':
+				opt->flags |= FLAG_BATCH;
+				break;
+			case 'M':
+				if (parse_opt_manifest(opt, optarg) < 0)
+					return -1;
+				opt->flags |= FLAG_BATCH;
+				break;
+			case 'j':
+				if (parse_opt_jobs(opt, optarg) < 0)
+					return -1;
 				break;
 			case 'F':
-				opt.flags |= FLAG_FROM_DUMP;
-				opt.dumpfile = optarg;
+				opt->flags |= FLAG_FROM_DUMP;
+				opt->dumpfile = optarg;
+				break;
+			case 'A':
+				opt->baseline = optarg;
+				break;
+			case 'D':
+				opt->flags |= FLAG_DIFF;
+				opt->baseline = optarg;
 				break;
 			case 'd':
-				opt.devmem = optarg;
+				opt->devmem = optarg;
 				break;
 			case 'h':
-				opt.flags |= FLAG_HELP;
+				opt->flags |= FLAG_HELP;
 				break;
 			case 'q':
-				opt.flags |= FLAG_QUIET;
+				opt->flags |= FLAG_QUIET;
 				break;
 			case 's':
-				if (parse_opt_string(optarg) < 0)
+				if (parse_opt_string(opt, optarg) < 0)
 					return -1;
-				opt.flags |= FLAG_QUIET;
+				opt->flags |= FLAG_QUIET;
 				break;
 			case 'O':
-				if (parse_opt_oem_string(optarg) < 0)
+				if (parse_opt_oem_string(opt, optarg) < 0)
 					return -1;
-				opt.flags |= FLAG_QUIET;
+				opt->flags |= FLAG_QUIET;
 				break;
 			case 't':
-				opt.type = parse_opt_type(opt.type, optarg);
-				if (opt.type == NULL)
+				opt->type = parse_opt_type(opt->type_map, optarg);
+				if (opt->type == NULL)
+					return -1;
+				break;
+			case 'L':
+				if (parse_opt_field(opt, optarg) < 0)
 					return -1;
 				break;
 			case 'H':
-				opt.handle = parse_opt_handle(optarg);
-				if (opt.handle  == ~0U)
+				opt->handle = parse_opt_handle(optarg);
+				if (opt->handle  == ~0U)
 					return -1;
 				break;
 			case 'u':
-				opt.flags |= FLAG_DUMP;
+				opt->flags |= FLAG_DUMP;
+				break;
+			case 'X':
+				opt->flags |= FLAG_DUMP | FLAG_COMPACT;
 				break;
 			case 'S':
-				opt.flags |= FLAG_NO_SYSFS;
+				opt->flags |= FLAG_NO_SYSFS;
+				break;
+			case 'C':
+				if (parse_opt_chunk_size(opt, optarg) < 0)
+					return -1;
+				break;
+			case 'f':
+				if (parse_opt_format(opt, optarg) < 0)
+					return -1;
+				break;
+			case 'T':
+				opt->flags |= FLAG_STATS;
+				break;
+			case 'Y':
+				opt->flags |= FLAG_MEMORY;
+				break;
+			case 'W':
+				if (parse_opt_watch(opt, optarg) < 0)
+					return -1;
 				break;
 			case 'V':
-				opt.flags |= FLAG_VERSION;
+				opt->flags |= FLAG_VERSION;
 				break;
 			case '?':
 				switch (optopt)
@@ -347,19 +608,84 @@ int parse_command_line(int argc, char * const argv[])
 		}
 
 	/* Check for mutually exclusive output format options */
-	if ((opt.string != NULL) + (opt.type != NULL)
-	  + !!(opt.flags & FLAG_DUMP_BIN) + (opt.handle != ~0U) > 1)
+	if ((opt->string != NULL) + (opt->type != NULL)
+	  + !!(opt->flags & FLAG_DUMP_BIN) + (opt->handle != ~0U)
+	  + !!(opt->flags & FLAG_MEMORY) > 1)
+	{
+		printf(u"Options --string, --type/--field, --handle, --memory, --dump-bin and --snapshot are mutually exclusive\n");
+		return -1;
+	}
+
+	if ((opt->flags & FLAG_FROM_DUMP) && (opt->flags & FLAG_DUMP_BIN))
+	{
+		printf(u"Options --from-dump, --dump-bin and --snapshot are mutually exclusive\n");
+		return -1;
+	}
+
+	if (opt->baseline != NULL && (opt->flags & (FLAG_DUMP_BIN | FLAG_BATCH)))
+	{
+		printf(u"Options --baseline and --diff can't be used with --dump-bin, --snapshot or batch mode\n");
+		return -1;
+	}
+
+	/*
+	 * The files to compare with the reference follow, more than one is
+	 * a batch
+	 */
+	if (opt->flags & FLAG_DIFF)
+	{
+		if (opt->flags & FLAG_FROM_DUMP)
+		{
+			printf(u"Options --diff and --from-dump are mutually exclusive\n");
+			return -1;
+		}
+		if (optind == argc)
+		{
+			printf(u"Option --diff needs a dump file to compare\n");
+			return -1;
+		}
+		if (argc - optind == 1)
+		{
+			opt->flags |= FLAG_FROM_DUMP;
+			opt->dumpfile = argv[optind++];
+		}
+		else
+			opt->flags |= FLAG_BATCH;
+	}
+
+	if (opt->cache_file != NULL
+	 && (opt->flags & (FLAG_FROM_DUMP | FLAG_DUMP_BIN | FLAG_BATCH)))
 	{
-		printf(u"Options --string, --type, --handle and --dump-bin are mutually exclusive\n");
+		printf(u"Option --cache can't be used with --from-dump, --dump-bin, --snapshot or batch mode\n");
 		return -1;
 	}
 
-	if ((opt.flags & FLAG_FROM_DUMP) && (opt.flags & FLAG_DUMP_BIN))
+	/* Each poll is compared with the previous one, from the same source */
+	if (opt->watch
+	 && ((opt->flags & (FLAG_FROM_DUMP | FLAG_DUMP_BIN | FLAG_BATCH
+			    | FLAG_MEMORY))
+	  || opt->baseline != NULL || opt->cache_file != NULL
+	  || opt->string != NULL))
 	{
-		printf(u"Options --from-dump and --dump-bin are mutually exclusive\n");
+		printf(u"Option --watch can't be used with --from-dump, --dump-bin, --snapshot, --baseline, --diff, --cache, --string, --oem-string, --memory or batch mode\n");
 		return -1;
 	}
 
+	if (opt->flags & FLAG_BATCH)
+	{
+		if (opt->flags & (FLAG_FROM_DUMP | FLAG_DUMP_BIN | FLAG_STATS))
+		{
+			printf(u"Batch mode can't be used with --from-dump, --dump-bin, --snapshot or --stats\n");
+			return -1;
+		}
+
+		/* Remaining arguments are dump files too */
+		for (; optind < argc; optind++)
+			if (add_opt_batch_file(opt, argv[optind]) < 0)
+				return -1;
+		opt->flags |= FLAG_FROM_DUMP;
+	}
+
 	return 0;
 }
 
@@ -372,13 +698,39 @@ void print_help(void)
 		u" -h, --help             Display this help text and exit\n"
 		u" -q, --quiet            Less verbose output\n"
 		u" -s, --string KEYWORD   Only display the value of the given DMI string\n"
+		u"                        (may be repeated)\n"
 		u" -t, --type TYPE        Only display the entries of given type\n"
+		u"     --field TYPE:NAME  Only display the given attribute of entries of\n"
+		u"                        given type (may be repeated)\n"
 		u" -H, --handle HANDLE    Only display the entry of given handle\n"
 		u" -u, --dump             Do not decode the entries\n"
+		u"     --compact          Dump every entry as a single line of hex (implies -u)\n"
 		u"     --dump-bin FILE    Dump the DMI data to a binary file\n"
-		u"     --from-dump FILE   Read the DMI data from a binary file\n"
+		u"     --snapshot FILE    Dump the DMI data and its index to a snapshot file\n"
+		u"     --from-dump FILE   Read the DMI data from a binary or snapshot file\n"
+		u"     --cache FILE       Keep a snapshot of the DMI data in FILE, and decode\n"
+		u"                        it instead while the entry point is unchanged\n"
+		u"     --baseline FILE    Only decode the entries which changed since a\n"
+		u"                        --dump-bin or --snapshot FILE, exit with status 3\n"
+		u"                        if nothing did\n"
+		u"     --diff FILE DUMP...\n"
+		u"                        Only decode the entries of the DUMP files which\n"
+		u"                        differ from those of FILE, exit with status 3 if\n"
+		u"                        none does\n"
+		u"     --batch            Decode all the dump files given as arguments\n"
+		u"     --manifest FILE    Decode all the dump files listed in FILE (- for stdin)\n"
+		u"     --jobs N           Number of dump files decoded in parallel, or of\n"
+		u"                        threads decoding the entries of a single table\n"
 		u"     --no-sysfs         Do not attempt to read DMI data from sysfs files\n"
 		u"     --oem-string N     Only display the value of the given OEM string\n"
+		u"                        (may be repeated)\n"
+		u"     --chunk-size N     Write output in chunks of N bytes (0: per entry)\n"
+		u"     --format FORMAT    Output format: text (default), json or keyvalue\n"
+		u"     --memory           Only display a summary of the memory arrays, devices\n"
+		u"                        and mapped ranges\n"
+		u"     --stats            Print where the time went, per phase and per type\n"
+		u"     --watch N          Read the DMI data again every N seconds (or on\n"
+		u"                        SIGUSR1), only display the entries which changed\n"
 		u" -V, --version          Display the version and exit\n";
 
 	printf(u"%s", help);
@@ -19,6 +19,9 @@
  *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
  */
 
+#ifndef DMIOPT_H
+#define DMIOPT_H
+
 #include "types.h"
 
 struct string_keyword
@@ -28,16 +31,34 @@ struct string_keyword
 	u8 offset;
 };
 
+/* A --field query, attribute name of structures of a given type */
+struct field_keyword
+{
+	u8 type;
+	const char *name;
+};
+
 struct opt
 {
 	const char *devmem;
 	unsigned int flags;
-	u8 *type;
-	const struct string_keyword *string;
+	u8 *type;			/* type_map if any type was given */
+	u8 type_map[256];
+	struct string_keyword *string;	/* Array of string_count queries */
+	unsigned int string_count;
+	struct field_keyword *field;	/* Array of field_count queries */
+	unsigned int field_count;
 	char *dumpfile;
+	const char *baseline;
+	const char *cache_file;
 	u32 handle;
+	unsigned long chunk_size;
+	int format;
+	char **batch_file;		/* Array of batch_count dump files */
+	unsigned int batch_count;
+	unsigned int jobs;		/* Worker threads, 0: one per CPU */
+	unsigned int watch;		/* Seconds between polls, 0: no --watch */
 };
-extern struct opt opt;
 
 #define FLAG_VERSION            (1 << 0)
 #define FLAG_HELP               (1 << 1)
@@ -46,6 +67,16 @@ extern struct opt opt;
 #define FLAG_DUMP_BIN           (1 << 4)
 #define FLAG_FROM_DUMP          (1 << 5)
 #define FLAG_NO_SYSFS           (1 << 6)
+#define FLAG_SNAPSHOT           (1 << 7)
+#define FLAG_BATCH              (1 << 8)
+#define FLAG_STATS              (1 << 9)
+#define FLAG_DIFF               (1 << 10)
+#define FLAG_COMPACT            (1 << 11)
+#define FLAG_MEMORY             (1 << 12)
 
-int parse_command_line(int argc, char * const argv[]);
+void opt_init(struct opt *opt);
+void opt_free(struct opt *opt);
+int parse_command_line(struct opt *opt, int argc, char * const argv[]);
 void print_help(void);
+
+#endif
@@ -21,117 +21,1431 @@
 
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "config.h"
+#include "util.h"
 #include "dmioutput.h"
 
+/*
+ * All output is accumulated in a growable buffer and written out in
+ * large chunks, as each write to the console can be very slow (think
+ * UEFI ConOut redirected to a serial line). The buffer is flushed as
+ * soon as it holds at least chunk_size bytes, or at the end of every
+ * structure if chunk_size is 0. Messages printed outside of a structure
+ * are flushed immediately, so that they are not delayed by a slow table
+ * read and stay in order with error messages printed directly by the
+ * lower layers.
+ */
+static THREAD_LOCAL struct
+{
+	char *buf;
+	size_t len;
+	size_t size;
+	size_t chunk_size;
+	int in_struct;
+	int capture;		/* Keep everything for pr_capture_end() */
+	unsigned int streams;	/* Captured outputs written so far */
+	pr_sink write;		/* NULL: stdout */
+	void *write_arg;
+	int stats;		/* Count the bytes and time the writes */
+	unsigned long long written;
+	unsigned long long write_ns;
+	int pooled;		/* buf comes from the run arena */
+} out = { NULL, 0, 0, DEFAULT_CHUNK_SIZE, 0, 0, 0, NULL, NULL, 0, 0, 0, 0 };
+
+/*
+ * While a run arena is set, the buffers of the output layer grow from it
+ * rather than from the heap, and they are dropped along with it. Captured
+ * outputs outlive the run, so they stay on the heap.
+ */
+static THREAD_LOCAL struct arena *run_arena;
+
+/* Resize buf to size bytes, keeping its first len bytes */
+static char *buf_resize(char *buf, int *pooled, size_t len, size_t size,
+			struct arena *a)
+{
+	char *p;
+
+	if (*pooled || a == NULL)
+		return arena_realloc(a, buf, len, size);
+
+	/* First growth since the arena was set, move out of the heap */
+	if ((p = arena_alloc(a, size)) == NULL)
+		return NULL;
+	if (len)
+		memcpy(p, buf, len);
+	free(buf);
+	*pooled = 1;
+	return p;
+}
+
+void pr_set_chunk_size(size_t size)
+{
+	out.chunk_size = size;
+}
+
+void pr_set_sink(pr_sink write, void *arg)
+{
+	out.write = write;
+	out.write_arg = arg;
+}
+
+void pr_set_stats(int on)
+{
+	out.stats = on;
+	out.written = 0;
+	out.write_ns = 0;
+}
+
+/* Bytes of output produced so far, written or not */
+unsigned long long pr_output_bytes(void)
+{
+	return out.written + out.len;
+}
+
+/* Time spent so far in writing the output out */
+unsigned long long pr_write_time(void)
+{
+	return out.write_ns;
+}
+
+/* Write len bytes out, to the sink if any */
+static void out_emit(const char *buf, size_t len)
+{
+	unsigned long long start = 0;
+
+	if (out.stats)
+	{
+		start = monotonic_ns();
+		out.written += len;
+	}
+
+	if (out.write != NULL)
+	{
+		if (len)
+			out.write(out.write_arg, buf, len);
+	}
+	else
+	{
+		if (len)
+			fwrite(buf, 1, len, stdout);
+		fflush(stdout);
+	}
+
+	if (out.stats)
+		out.write_ns += monotonic_ns() - start;
+}
+
+void pr_flush(void)
+{
+	if (out.capture)
+		return;
+
+	out_emit(out.buf, out.len);
+	out.len = 0;
+}
+
+/* Make room for at least len more bytes, return 0 on success */
+static int out_reserve(size_t len)
+{
+	size_t size;
+	char *p;
+
+	if (out.len + len < out.size)
+		return 0;
+
+	size = out.size ? out.size : 4096;
+	while (out.len + len >= size)
+		size <<= 1;
+
+	p = buf_resize(out.buf, &out.pooled, out.len, size,
+		       out.capture ? NULL : run_arena);
+	if (p == NULL)
+		return -1;
+	out.buf = p;
+	out.size = size;
+
+	return 0;
+}
+
+static void out_vprintf(const char *format, va_list args)
+{
+	va_list copy;
+	int len;
+
+	va_copy(copy, args);
+	len = vsnprintf(out.buf + out.len, out.size - out.len, format, copy);
+	va_end(copy);
+	if (len < 0)
+		return;
+
+	if (out.len + len >= out.size)
+	{
+		if (out_reserve(len) != 0)
+		{
+			/* Out of memory, write unbuffered */
+			pr_flush();
+			vprintf(format, args);
+			return;
+		}
+		vsnprintf(out.buf + out.len, out.size - out.len, format, args);
+	}
+	out.len += len;
+}
+
+static void out_printf(const char *format, ...)
+{
+	va_list args;
+
+	va_start(args, format);
+	out_vprintf(format, args);
+	va_end(args);
+}
+
+static void out_check_flush(void)
+{
+	if (!out.in_struct || (out.chunk_size && out.len >= out.chunk_size))
+		pr_flush();
+}
+
+/* Called at the end of each line */
+static void out_eol(void)
+{
+	out_printf(u"\n");
+	out_check_flush();
+}
+
+/*
+ * Hex dumps (-u) are encoded with a table, straight into the output
+ * buffer, as formatting them one byte at a time with printf would
+ * dominate the time of the whole run.
+ */
+static const char hex_digit[] = "0123456789ABCDEF";
+
+/* Encode len bytes at p, separated by spaces if sep, return the end */
+static char *hex_encode(char *p, const u8 *data, size_t len, int sep)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+	{
+		if (sep && i)
+			*p++ = ' ';
+		*p++ = hex_digit[data[i] >> 4];
+		*p++ = hex_digit[data[i] & 0x0F];
+	}
+
+	return p;
+}
+
+/* Write len bytes in hex, without separators */
+static void out_hex(const u8 *data, size_t len)
+{
+	size_t i;
+
+	if (out_reserve(2 * len) == 0)
+	{
+		out.len = hex_encode(out.buf + out.len, data, len, 0) - out.buf;
+		return;
+	}
+
+	/* Out of memory, write unbuffered */
+	for (i = 0; i < len; i++)
+		out_printf(u"%02X", data[i]);
+}
+
+/* One list item per 16 bytes, for the formats without a faster way */
+static void hex_list_items(void (*item)(const char *s), const u8 *data,
+			   size_t len)
+{
+	char row[48];
+	size_t off, n;
+
+	for (off = 0; off < len; off += 16)
+	{
+		n = len - off < 16 ? len - off : 16;
+		*hex_encode(row, data + off, n, 1) = '\0';
+		item(row);
+	}
+}
+
+/* End of structure, flush as pr_sep() says */
+static void out_struct_end(void)
+{
+	if (!out.in_struct || out.len >= out.chunk_size)
+		pr_flush();
+	out.in_struct = 0;
+}
+
+/*
+ * The pr_* functions format their value once into a scratch buffer and
+ * hand it over to the selected output format, which only has to lay out
+ * the name/value pairs it receives.
+ */
+static THREAD_LOCAL struct
+{
+	char *buf;
+	size_t size;
+	int pooled;
+} val = { NULL, 0, 0 };
+
+static const char *val_vformat(const char *format, va_list args)
+{
+	va_list copy;
+	size_t size;
+	char *p;
+	int len;
+
+	if (format == NULL)
+		return u"";
+
+	va_copy(copy, args);
+	len = vsnprintf(val.buf, val.size, format, copy);
+	va_end(copy);
+	if (len < 0)
+		return u"";
+
+	if ((size_t)len >= val.size)
+	{
+		size = val.size ? val.size : 256;
+		while ((size_t)len >= size)
+			size <<= 1;
+
+		p = buf_resize(val.buf, &val.pooled, 0, size, run_arena);
+		if (p == NULL)
+			return u"";
+		val.buf = p;
+		val.size = size;
+		vsnprintf(val.buf, val.size, format, args);
+	}
+
+	return val.buf;
+}
+
+struct output_format
+{
+	void (*comment)(const char *s);
+	void (*info)(const char *s);
+	void (*handle)(const struct dmi_header *h);
+	void (*handle_name)(const char *s);
+	void (*attr)(const char *name, const char *s);
+	void (*subattr)(const char *name, const char *s);
+	void (*list_start)(const char *name, const char *s);	/* s may be NULL */
+	void (*list_item)(const char *s);
+	void (*list_end)(void);
+	void (*list_hex)(const u8 *data, size_t len);
+	void (*compact)(const struct dmi_header *h, const u8 *data, size_t len);
+	void (*value)(const char *name, const char *s);	/* name may be NULL */
+	void (*sep)(void);
+	void (*struct_err)(const char *s);
+	void (*end)(void);
+	/* Framing of captured outputs, see pr_stream_write() */
+	void (*stream_start)(const char *label, int first);
+	void (*stream_end)(void);
+	void (*batch_end)(void);
+};
+
+/*
+ * Plain text output, the historical dmidecode format
+ */
+
+static void text_comment(const char *s)
+{
+	out_printf(u"# %s", s);
+	out_eol();
+}
+
+static void text_info(const char *s)
+{
+	out_printf(u"%s", s);
+	out_eol();
+}
+
+static void text_handle(const struct dmi_header *h)
+{
+	out_printf(u"Handle 0x%04X, DMI type %d, %d bytes\n",
+	       h->handle, h->type, h->length);
+}
+
+static void text_attr(const char *name, const char *s)
+{
+	out_printf(u"\t%s: %s", name, s);
+	out_eol();
+}
+
+static void text_subattr(const char *name, const char *s)
+{
+	out_printf(u"\t\t%s: %s", name, s);
+	out_eol();
+}
+
+static void text_list_start(const char *name, const char *s)
+{
+	/* value is optional, skip it if not provided */
+	if (s)
+		out_printf(u"\t%s: %s", name, s);
+	else
+		out_printf(u"\t%s:", name);
+	out_eol();
+}
+
+static void text_list_item(const char *s)
+{
+	out_printf(u"\t\t%s", s);
+	out_eol();
+}
+
+static void text_nop(void)
+{
+}
+
+static void text_value(const char *name, const char *s)
+{
+	if (name)
+		out_printf(u"%s: %s", name, s);
+	else
+		out_printf(u"%s", s);
+	out_eol();
+}
+
+/* Rows of "\t\t" and 16 bytes, written at once */
+static void text_list_hex(const u8 *data, size_t len)
+{
+	size_t off, n;
+	char *p;
+
+	if (out_reserve((len + 15) / 16 * 50) != 0)
+	{
+		hex_list_items(text_list_item, data, len);
+		return;
+	}
+
+	p = out.buf + out.len;
+	for (off = 0; off < len; off += 16)
+	{
+		n = len - off < 16 ? len - off : 16;
+		*p++ = '\t';
+		*p++ = '\t';
+		p = hex_encode(p, data + off, n, 1);
+		*p++ = '\n';
+	}
+	out.len = p - out.buf;
+	out_check_flush();
+}
+
+static void text_compact(const struct dmi_header *h, const u8 *data,
+			 size_t len)
+{
+	out_printf(u"0x%04X %d %d ", h->handle, h->type, h->length);
+	out_hex(data, len);
+	out_eol();
+}
+
+static void text_sep(void)
+{
+	out_printf(u"\n");
+}
+
+static void text_struct_err(const char *s)
+{
+	out_printf(u"\t%s", s);
+	out_eol();
+}
+
+static void text_stream_start(const char *label, MAYBE_UNUSED int first)
+{
+	out_printf(u"# File %s\n", label);
+}
+
+static const struct output_format output_text = {
+	text_comment,
+	text_info,
+	text_handle,
+	text_info,		/* handle_name */
+	text_attr,
+	text_subattr,
+	text_list_start,
+	text_list_item,
+	text_nop,		/* list_end */
+	text_list_hex,
+	text_compact,
+	text_value,
+	text_sep,
+	text_struct_err,
+	text_nop,		/* end */
+	text_stream_start,
+	text_nop,		/* stream_end */
+	text_nop,		/* batch_end */
+};
+
+/*
+ * JSON output: an array with one object per structure (or per section
+ * of a structure, for types 10 and 40 which describe several devices),
+ * plus one small object per message printed outside of a structure.
+ * Attributes which have subattributes become objects, with the
+ * attribute value itself under "value"; lists become arrays. All
+ * values are strings, as produced by the decoders.
+ *
+ * Lists are only closed when the next attribute starts, as some
+ * decoders (e.g. BIOS characteristics) add items after pr_list_end().
+ */
+static THREAD_LOCAL struct
+{
+	int elements;		/* Top-level elements written so far */
+	int in_obj;		/* Structure object is open */
+	int members;		/* Members written to the structure object */
+	int named;		/* Section name was written */
+	int attrs;		/* Members written to "attributes", -1 if closed */
+	int items;		/* Items written to the current list, -1 if none */
+	int list_value;		/* Current list was opened with a value */
+	int has_handle;
+	struct dmi_header h;
+	/* Last attribute, held back until we know if it has subattributes */
+	int pending;		/* 1: held back, 2: written as an object */
+	char *pend;		/* name, NUL, value, NUL */
+	size_t pend_size;
+	int pend_pooled;
+} json = { 0, 0, 0, 0, -1, -1, 0, 0, { 0 }, 0, NULL, 0, 0 };
+
+#if !defined CONFIG_FORMATS || defined CONFIG_FORMAT_JSON
+/*
+ * Strings are escaped straight into the output buffer, and the runs of
+ * characters which need no escaping are copied at once, as formatting
+ * them one character at a time would dominate the time of the whole run.
+ */
+static void json_str(const char *s)
+{
+	static const char digit[] = "0123456789abcdef";
+	const unsigned char *p = (const unsigned char *)s, *run;
+	size_t len = strlen(s);
+	char *q;
+
+	if (out_reserve(len * 6 + 2) != 0)
+	{
+		/* Out of memory, write unbuffered */
+		out_printf(u"\"");
+		for (; *p; p++)
+		{
+			if (*p == '"' || *p == '\\')
+				out_printf(u"\\%c", *p);
+			else if (*p < 0x20)
+				out_printf(u"\\u%04x", *p);
+			else
+				out_printf(u"%c", *p);
+		}
+		out_printf(u"\"");
+		return;
+	}
+
+	q = out.buf + out.len;
+	*q++ = '"';
+	while (*p)
+	{
+		for (run = p; *p >= 0x20 && *p != '"' && *p != '\\'; p++)
+			;
+		memcpy(q, run, p - run);
+		q += p - run;
+		if (*p == '\0')
+			break;
+
+		*q++ = '\\';
+		if (*p < 0x20)
+		{
+			memcpy(q, "u00", 3);
+			q[3] = digit[*p >> 4];
+			q[4] = digit[*p & 0x0F];
+			q += 5;
+		}
+		else
+			*q++ = *p;
+		p++;
+	}
+	*q++ = '"';
+	out.len = q - out.buf;
+}
+
+/* Write the separator and key of the next member of an object */
+static void json_key(int *count, const char *name)
+{
+	if ((*count)++)
+		out_printf(u", ");
+	json_str(name);
+	out_printf(u": ");
+}
+
+static void json_element_start(void)
+{
+	out_printf(json.elements++ ? u",\n" : u"[\n");
+}
+
+/* Stand-alone message, outside of any structure */
+static void json_element(const char *name, const char *s)
+{
+	int count = 0;
+
+	json_element_start();
+	out_printf(u"{");
+	json_key(&count, name);
+	json_str(s);
+	out_printf(u"}");
+	out_check_flush();
+}
+
+static void json_open_obj(void)
+{
+	if (json.in_obj)
+		return;
+
+	json_element_start();
+	out_printf(u"{");
+	json.in_obj = 1;
+	json.members = 0;
+	json.named = 0;
+
+	if (json.has_handle)
+	{
+		json_key(&json.members, u"handle");
+		out_printf(u"\"0x%04X\"", json.h.handle);
+		json_key(&json.members, u"type");
+		out_printf(u"%d", json.h.type);
+		json_key(&json.members, u"length");
+		out_printf(u"%d", json.h.length);
+	}
+}
+
+static void json_open_attrs(void)
+{
+	json_open_obj();
+	if (json.attrs >= 0)
+		return;
+
+	json_key(&json.members, u"attributes");
+	out_printf(u"{");
+	json.attrs = 0;
+}
+
+static void json_flush_pending(void)
+{
+	const char *name = json.pend;
+
+	if (json.pending == 1)
+	{
+		json_key(&json.attrs, name);
+		json_str(name + strlen(name) + 1);
+	}
+	else if (json.pending == 2)
+		out_printf(u"}");
+	json.pending = 0;
+}
+
+static void json_close_list(void)
+{
+	if (json.items < 0)
+		return;
+
+	out_printf(json.list_value ? u"]}" : u"]");
+	json.items = -1;
+}
+
+/* Close everything opened since the last member of "attributes" */
+static void json_close_attr(void)
+{
+	json_flush_pending();
+	json_close_list();
+}
+
+static void json_close_obj(void)
+{
+	if (!json.in_obj)
+		return;
+
+	json_close_attr();
+	if (json.attrs >= 0)
+		out_printf(u"}");
+	out_printf(u"}");
+	json.in_obj = 0;
+	json.attrs = -1;
+	out_check_flush();
+}
+
+/* Write a member of "attributes" which can't have children */
+static void json_attr_value(const char *name, const char *s)
+{
+	json_close_attr();
+	json_open_attrs();
+	json_key(&json.attrs, name);
+	json_str(s);
+}
+
+static void json_comment(const char *s)
+{
+	if (json.in_obj)
+		json_attr_value(u"comment", s);
+	else
+		json_element(u"comment", s);
+}
+
+static void json_info(const char *s)
+{
+	if (json.in_obj)
+		json_attr_value(u"info", s);
+	else
+		json_element(u"info", s);
+}
+
+static void json_handle(const struct dmi_header *h)
+{
+	json_close_obj();
+	json.h = *h;
+	json.has_handle = 1;
+	json_open_obj();
+}
+
+static void json_handle_name(const char *s)
+{
+	/* Start a new object for each section of the structure */
+	if (json.named || json.attrs >= 0)
+		json_close_obj();
+	json_open_obj();
+
+	json_key(&json.members, u"name");
+	json_str(s);
+	json.named = 1;
+}
+
+static void json_attr(const char *name, const char *s)
+{
+	size_t len, name_len = strlen(name) + 1;
+	char *p;
+
+	json_close_attr();
+	json_open_attrs();
+
+	len = name_len + strlen(s) + 1;
+	if (len > json.pend_size)
+	{
+		p = buf_resize(json.pend, &json.pend_pooled, 0, len,
+			       run_arena);
+		if (p == NULL)
+		{
+			/* Out of memory, can't have subattributes then */
+			json_key(&json.attrs, name);
+			json_str(s);
+			return;
+		}
+		json.pend = p;
+		json.pend_size = len;
+	}
+	memcpy(json.pend, name, name_len);
+	memcpy(json.pend + name_len, s, len - name_len);
+	json.pending = 1;
+}
+
+static void json_subattr(const char *name, const char *s)
+{
+	int count = 1;
+	const char *parent = json.pend;
+
+	if (json.pending == 0)
+	{
+		json_attr_value(name, s);
+		return;
+	}
+
+	if (json.pending == 1)
+	{
+		json_key(&json.attrs, parent);
+		out_printf(u"{\"value\": ");
+		json_str(parent + strlen(parent) + 1);
+		json.pending = 2;
+	}
+
+	json_key(&count, name);
+	json_str(s);
+}
+
+static void json_list_start(const char *name, const char *s)
+{
+	json_close_attr();
+	json_open_attrs();
+	json_key(&json.attrs, name);
+
+	json.list_value = (s != NULL);
+	if (s)
+	{
+		out_printf(u"{\"value\": ");
+		json_str(s);
+		out_printf(u", \"items\": [");
+	}
+	else
+		out_printf(u"[");
+	json.items = 0;
+}
+
+static void json_list_item(const char *s)
+{
+	if (json.items < 0)
+		json_list_start(u"items", NULL);
+
+	if (json.items++)
+		out_printf(u", ");
+	json_str(s);
+}
+
+static void json_list_hex(const u8 *data, size_t len)
+{
+	hex_list_items(json_list_item, data, len);
+}
+
+static void json_compact(const struct dmi_header *h, const u8 *data,
+			 size_t len)
+{
+	int count = 0;
+
+	json_close_obj();
+	json_element_start();
+	out_printf(u"{");
+	json_key(&count, u"handle");
+	out_printf(u"\"0x%04X\"", h->handle);
+	json_key(&count, u"type");
+	out_printf(u"%d", h->type);
+	json_key(&count, u"length");
+	out_printf(u"%d", h->length);
+	json_key(&count, u"raw");
+	out_printf(u"\"");
+	out_hex(data, len);
+	out_printf(u"\"}");
+	out_check_flush();
+}
+
+static void json_value(const char *name, const char *s)
+{
+	int count = 0;
+
+	json_close_obj();
+	json_element_start();
+	out_printf(u"{");
+	if (name)
+	{
+		json_key(&count, u"string");
+		json_str(name);
+	}
+	json_key(&count, u"value");
+	json_str(s);
+	out_printf(u"}");
+	out_check_flush();
+}
+
+static void json_sep(void)
+{
+	json_close_obj();
+	json.has_handle = 0;
+}
+
+static void json_struct_err(const char *s)
+{
+	if (json.in_obj || json.has_handle)
+		json_attr_value(u"error", s);
+	else
+		json_element(u"error", s);
+}
+
+static void json_end(void)
+{
+	json_close_obj();
+	out_printf(json.elements ? u"\n]\n" : u"[]\n");
+	json.elements = 0;
+}
+
+/* Captured outputs become {"file": label, "output": [...]} objects */
+static void json_stream_start(const char *label, int first)
+{
+	out_printf(first ? u"[\n{\"file\": " : u",\n{\"file\": ");
+	json_str(label);
+	out_printf(u", \"output\": ");
+}
+
+static void json_stream_end(void)
+{
+	out_printf(u"}");
+}
+
+static void json_batch_end(void)
+{
+	out_printf(u"\n]\n");
+}
+
+static const struct output_format output_json = {
+	json_comment,
+	json_info,
+	json_handle,
+	json_handle_name,
+	json_attr,
+	json_subattr,
+	json_list_start,
+	json_list_item,
+	text_nop,		/* list_end, see below */
+	json_list_hex,
+	json_compact,
+	json_value,
+	json_sep,
+	json_struct_err,
+	json_end,
+	json_stream_start,
+	json_stream_end,
+	json_batch_end,
+};
+#endif
+
+/*
+ * Flat key=value output, one value per line, for grep and shell scripts.
+ * Keys are made of the structure handle (or of its rank in quiet mode,
+ * where handles aren't printed) and the attribute name, followed by the
+ * subattribute name or the list item number if any, separated by dots:
+ *   0x0004.type=4
+ *   0x0004.Socket Designation=CPU0
+ *   0x0004.Flags.0=FPU (Floating-point unit on-chip)
+ * Sections after the first one in a structure get a /N suffix.
+ */
+static THREAD_LOCAL struct
+{
+	char prefix[32];	/* Empty between structures */
+	unsigned int count;	/* Structures seen so far */
+	unsigned int sections;
+	char parent[128];	/* Last attribute or list name */
+	unsigned int items;
+} kv = { "", 0, 0, "", 0 };
+
+#if !defined CONFIG_FORMATS || defined CONFIG_FORMAT_KEYVALUE
+static const char *kv_prefix(void)
+{
+	if (kv.prefix[0] == '\0')
+		snprintf(kv.prefix, sizeof(kv.prefix), u"entry%u", ++kv.count);
+	return kv.prefix;
+}
+
+static void kv_comment(const char *s)
+{
+	out_printf(u"comment=%s", s);
+	out_eol();
+}
+
+static void kv_info(const char *s)
+{
+	if (out.in_struct)
+		out_printf(u"%s.info=%s", kv_prefix(), s);
+	else
+		out_printf(u"info=%s", s);
+	out_eol();
+}
+
+static void kv_handle(const struct dmi_header *h)
+{
+	snprintf(kv.prefix, sizeof(kv.prefix), u"0x%04X", h->handle);
+	kv.count++;
+	kv.sections = 0;
+	out_printf(u"%s.type=%d", kv.prefix, h->type);
+	out_eol();
+	out_printf(u"%s.length=%d", kv.prefix, h->length);
+	out_eol();
+}
+
+static void kv_handle_name(const char *s)
+{
+	size_t len;
+
+	kv_prefix();
+	if (kv.sections++)
+	{
+		len = strcspn(kv.prefix, u"/");
+		snprintf(kv.prefix + len, sizeof(kv.prefix) - len,
+			 u"/%u", kv.sections);
+	}
+	out_printf(u"%s.name=%s", kv.prefix, s);
+	out_eol();
+}
+
+static void kv_attr(const char *name, const char *s)
+{
+	snprintf(kv.parent, sizeof(kv.parent), u"%s", name);
+	out_printf(u"%s.%s=%s", kv_prefix(), name, s);
+	out_eol();
+}
+
+static void kv_subattr(const char *name, const char *s)
+{
+	out_printf(u"%s.%s.%s=%s", kv_prefix(), kv.parent, name, s);
+	out_eol();
+}
+
+static void kv_list_start(const char *name, const char *s)
+{
+	snprintf(kv.parent, sizeof(kv.parent), u"%s", name);
+	kv.items = 0;
+	if (s)
+	{
+		out_printf(u"%s.%s=%s", kv_prefix(), name, s);
+		out_eol();
+	}
+}
+
+static void kv_list_item(const char *s)
+{
+	out_printf(u"%s.%s.%u=%s", kv_prefix(), kv.parent, kv.items++, s);
+	out_eol();
+}
+
+static void kv_list_hex(const u8 *data, size_t len)
+{
+	hex_list_items(kv_list_item, data, len);
+}
+
+static void kv_compact(const struct dmi_header *h, const u8 *data,
+		       size_t len)
+{
+	kv.count++;
+	out_printf(u"0x%04X.raw=", h->handle);
+	out_hex(data, len);
+	out_eol();
+}
+
+static void kv_value(const char *name, const char *s)
+{
+	if (name != NULL)
+		out_printf(u"%s=%s", name, s);
+	else
+		out_printf(u"value=%s", s);
+	out_eol();
+}
+
+static void kv_sep(void)
+{
+	kv.prefix[0] = '\0';
+	kv.sections = 0;
+}
+
+static void kv_struct_err(const char *s)
+{
+	if (out.in_struct)
+		out_printf(u"%s.error=%s", kv_prefix(), s);
+	else
+		out_printf(u"error=%s", s);
+	out_eol();
+}
+
+static void kv_end(void)
+{
+	kv.count = 0;
+}
+
+static void kv_stream_start(const char *label, MAYBE_UNUSED int first)
+{
+	out_printf(u"file=%s\n", label);
+}
+
+static const struct output_format output_kv = {
+	kv_comment,
+	kv_info,
+	kv_handle,
+	kv_handle_name,
+	kv_attr,
+	kv_subattr,
+	kv_list_start,
+	kv_list_item,
+	text_nop,		/* list_end */
+	kv_list_hex,
+	kv_compact,
+	kv_value,
+	kv_sep,
+	kv_struct_err,
+	kv_end,
+	kv_stream_start,
+	text_nop,		/* stream_end */
+	text_nop,		/* batch_end */
+};
+#endif
+
+static THREAD_LOCAL const struct output_format *output = &output_text;
+
+void pr_set_format(int fmt)
+{
+	switch (fmt)
+	{
+#if !defined CONFIG_FORMATS || defined CONFIG_FORMAT_JSON
+		case OUTPUT_JSON:
+			output = &output_json;
+			break;
+#endif
+#if !defined CONFIG_FORMATS || defined CONFIG_FORMAT_KEYVALUE
+		case OUTPUT_KEYVALUE:
+			output = &output_kv;
+			break;
+#endif
+		default:
+			output = &output_text;
+	}
+}
+
+/*
+ * Set the arena of the run, or NULL at its end, once everything was
+ * written out. The buffers allocated from the arena are forgotten then.
+ */
+void pr_set_arena(struct arena *a)
+{
+	if (a == NULL)
+	{
+		if (out.pooled)
+		{
+			out.buf = NULL;
+			out.len = 0;
+			out.size = 0;
+			out.pooled = 0;
+		}
+		if (val.pooled)
+		{
+			val.buf = NULL;
+			val.size = 0;
+			val.pooled = 0;
+		}
+		if (json.pend_pooled)
+		{
+			json.pend = NULL;
+			json.pend_size = 0;
+			json.pend_pooled = 0;
+		}
+	}
+	run_arena = a;
+}
+
+/* Terminate the output document, call once at the end of each run */
+void pr_end(void)
+{
+	if (out.streams)
+		output->batch_end();
+	else
+		output->end();
+	out.streams = 0;
+	pr_flush();
+}
+
+/*
+ * Field selection (--field): in the structures of a type which has
+ * selected fields, the other attributes and lists are dropped before
+ * their value is even formatted, along with their subattributes and
+ * items.
+ */
+static THREAD_LOCAL struct
+{
+	const struct field_keyword *field;
+	unsigned int count;
+	u8 selected[256];	/* Types with selected fields */
+	int active;		/* Current structure has selected fields */
+	u8 type;
+	int skip;		/* Dropping the current attribute or list */
+} sel;
+
+void pr_set_fields(const struct field_keyword *field, unsigned int count)
+{
+	unsigned int i;
+
+	memset(&sel, 0, sizeof(sel));
+	sel.field = field;
+	sel.count = count;
+	for (i = 0; i < count; i++)
+		sel.selected[field[i].type] = 1;
+}
+
+/*
+ * Returns 0 if the named attribute or list of the current structure is
+ * dropped, so that decoders can skip expensive work.
+ */
+int pr_field_wanted(const char *name)
+{
+	unsigned int i;
+
+	if (!sel.active)
+		return 1;
+
+	for (i = 0; i < sel.count; i++)
+		if (sel.field[i].type == sel.type
+		 && strcasecmp(sel.field[i].name, name) == 0)
+			return 1;
+	return 0;
+}
+
+/* The following attributes are those of a structure of this type */
+void pr_select_type(u8 type)
+{
+	sel.active = sel.selected[type];
+	sel.type = type;
+	sel.skip = 0;
+}
+
+static int sel_skip(const char *name)
+{
+	sel.skip = !pr_field_wanted(name);
+	return sel.skip;
+}
+
+/*
+ * Keep all the output of the calling thread from now on, instead of
+ * writing it out, until pr_capture_end() hands it over.
+ */
+void pr_capture_start(void)
+{
+	pr_flush();
+	if (out.pooled)
+	{
+		out.buf = NULL;
+		out.size = 0;
+		out.pooled = 0;
+	}
+	out.capture = 1;
+}
+
+/* Terminate the captured document and pass its ownership to c */
+void pr_capture_end(struct pr_capture *c)
+{
+	output->end();
+
+	c->buf = out.buf;
+	c->len = out.len;
+	c->elements = 0;
+	c->entries = 0;
+	out.buf = NULL;
+	out.len = 0;
+	out.size = 0;
+	out.in_struct = 0;
+	out.capture = 0;
+}
+
+/*
+ * Write a captured output, labelled according to the output format.
+ * The batch is terminated by pr_end().
+ */
+void pr_stream_write(const char *label, const struct pr_capture *c)
+{
+	output->stream_start(label, out.streams++ == 0);
+	pr_flush();
+	if (c->len)
+		out_emit(c->buf, c->len);
+	output->stream_end();
+	pr_flush();
+}
+
+/*
+ * Parallel decoding: the output of a range of structures is captured by
+ * the worker thread decoding it, as a part of the document of the calling
+ * thread, which writes the parts in table order. A part starts and ends
+ * between two structures, where the only state of the formats is the
+ * count of JSON elements (for the separator of the first one) and the
+ * count of keyvalue structures. As a part doesn't know where the latter
+ * starts, keyvalue output in quiet mode, where keys are made of it, must
+ * not be decoded in parts.
+ */
+void pr_part_start(void)
+{
+	pr_capture_start();
+	json.elements = 1;
+	kv.count = 0;
+}
+
+void pr_part_end(struct pr_capture *c)
+{
+	c->buf = out.buf;
+	c->len = out.len;
+	c->elements = json.elements - 1;
+	c->entries = kv.count;
+	out.buf = NULL;
+	out.len = 0;
+	out.size = 0;
+	out.in_struct = 0;
+	out.capture = 0;
+	json.elements = 0;
+	kv.count = 0;
+}
+
+void pr_part_write(const struct pr_capture *c)
+{
+	const char *buf = c->buf;
+	size_t len = c->len;
+
+	/* The part was written as if an element came before it */
+	if (c->elements && json.elements == 0 && len >= 2)
+	{
+		out_printf(u"[\n");
+		buf += 2;
+		len -= 2;
+	}
+	json.elements += c->elements;
+	kv.count += c->entries;
+
+	if (out.capture)
+	{
+		if (len && out_reserve(len) == 0)
+		{
+			memcpy(out.buf + out.len, buf, len);
+			out.len += len;
+		}
+		return;
+	}
+	pr_flush();
+	out_emit(buf, len);
+}
+
 void pr_comment(const char *format, ...)
 {
 	va_list args;
+	const char *s;
 
-	printf(u"# ");
 	va_start(args, format);
-	vprintf(format, args);
+	s = val_vformat(format, args);
 	va_end(args);
-	printf(u"\n");
+	output->comment(s);
 }
 
 void pr_info(const char *format, ...)
 {
 	va_list args;
+	const char *s;
 
 	va_start(args, format);
-	vprintf(format, args);
+	s = val_vformat(format, args);
 	va_end(args);
-	printf(u"\n");
+	output->info(s);
 }
 
 void pr_handle(const struct dmi_header *h)
 {
-	printf(u"Handle 0x%04X, DMI type %d, %d bytes\n",
-	       h->handle, h->type, h->length);
+	out.in_struct = 1;
+	output->handle(h);
 }
 
 void pr_handle_name(const char *format, ...)
 {
 	va_list args;
+	const char *s;
 
+	out.in_struct = 1;
 	va_start(args, format);
-	vprintf(format, args);
+	s = val_vformat(format, args);
 	va_end(args);
-	printf(u"\n");
+	output->handle_name(s);
 }
 
 void pr_attr(const char *name, const char *format, ...)
 {
 	va_list args;
+	const char *s;
 
-	printf(u"\t%s: ", name);
+	if (sel_skip(name))
+		return;
 
 	va_start(args, format);
-	vprintf(format, args);
+	s = val_vformat(format, args);
 	va_end(args);
-	printf(u"\n");
+	output->attr(name, s);
 }
 
 void pr_subattr(const char *name, const char *format, ...)
 {
 	va_list args;
+	const char *s;
 
-	printf(u"\t\t%s: ", name);
+	if (sel.skip)
+		return;
 
 	va_start(args, format);
-	vprintf(format, args);
+	s = val_vformat(format, args);
 	va_end(args);
-	printf(u"\n");
+	output->subattr(name, s);
 }
 
 void pr_list_start(const char *name, const char *format, ...)
 {
 	va_list args;
+	const char *s = NULL;
 
-	printf(u"\t%s:", name);
+	if (sel_skip(name))
+		return;
 
 	/* format is optional, skip value if not provided */
 	if (format)
 	{
-		printf(u" ");
 		va_start(args, format);
-		vprintf(format, args);
+		s = val_vformat(format, args);
 		va_end(args);
 	}
-	printf(u"\n");
-
+	output->list_start(name, s);
 }
 
 void pr_list_item(const char *format, ...)
 {
 	va_list args;
+	const char *s;
 
-	printf(u"\t\t");
+	if (sel.skip)
+		return;
 
 	va_start(args, format);
-	vprintf(format, args);
+	s = val_vformat(format, args);
 	va_end(args);
-	printf(u"\n");
+	output->list_item(s);
 }
 
 void pr_list_end(void)
 {
-	/* a no-op for text output */
+	if (sel.skip)
+		return;
+	output->list_end();
+}
+
+/* List items of 16 bytes of data each, in hex */
+void pr_list_hex(const u8 *data, size_t len)
+{
+	if (sel.skip)
+		return;
+	output->list_hex(data, len);
+}
+
+/*
+ * A whole structure on a single line, its len bytes in hex (--compact).
+ * Replaces pr_handle() and pr_sep().
+ */
+void pr_compact(const struct dmi_header *h, const u8 *data, size_t len)
+{
+	out.in_struct = 1;
+	output->compact(h, data, len);
+	out_struct_end();
+}
+
+/* Value of a --string query, prefixed with its name if provided */
+void pr_value(const char *name, const char *format, ...)
+{
+	va_list args;
+	const char *s;
+
+	va_start(args, format);
+	s = val_vformat(format, args);
+	va_end(args);
+	output->value(name, s);
 }
 
 void pr_sep(void)
 {
-	printf(u"\n");
+	output->sep();
+	out_struct_end();
 }
 
 void pr_struct_err(const char *format, ...)
 {
 	va_list args;
-
-	printf(u"\t");
+	const char *s;
 
 	va_start(args, format);
-	vprintf(format, args);
+	s = val_vformat(format, args);
 	va_end(args);
-	printf(u"\n");
+	output->struct_err(s);
 }
@@ -19,8 +19,47 @@
  *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
  */
 
+#include <stddef.h>
 #include "dmidecode.h"
 
+#define OUTPUT_TEXT             0
+#define OUTPUT_JSON             1
+#define OUTPUT_KEYVALUE         2
+
+typedef void (*pr_sink)(void *arg, const char *buf, size_t len);
+
+void pr_set_format(int fmt);
+void pr_set_chunk_size(size_t size);
+void pr_set_sink(pr_sink write, void *arg);
+
+struct arena;
+void pr_set_arena(struct arena *a);
+
+struct field_keyword;
+void pr_set_fields(const struct field_keyword *field, unsigned int count);
+void pr_select_type(u8 type);
+int pr_field_wanted(const char *name);
+void pr_flush(void);
+void pr_set_stats(int on);
+unsigned long long pr_output_bytes(void);
+unsigned long long pr_write_time(void);
+void pr_end(void);
+
+struct pr_capture
+{
+	char *buf;		/* Must be freed by the caller */
+	size_t len;
+	unsigned int elements;	/* Of a part, top-level JSON elements */
+	unsigned int entries;	/* Of a part, keyvalue structures */
+};
+
+void pr_capture_start(void);
+void pr_capture_end(struct pr_capture *c);
+void pr_stream_write(const char *label, const struct pr_capture *c);
+void pr_part_start(void);
+void pr_part_end(struct pr_capture *c);
+void pr_part_write(const struct pr_capture *c);
+
 void pr_comment(const char *format, ...);
 void pr_info(const char *format, ...);
 void pr_handle(const struct dmi_header *h);
@@ -30,5 +69,8 @@ void pr_subattr(const char *name, const char *format, ...);
 void pr_list_start(const char *name, const char *format, ...);
 void pr_list_item(const char *format, ...);
 void pr_list_end(void);
+void pr_list_hex(const u8 *data, size_t len);
+void pr_compact(const struct dmi_header *h, const u8 *data, size_t len);
+void pr_value(const char *name, const char *format, ...);
 void pr_sep(void);
 void pr_struct_err(const char *format, ...);
@@ -0,0 +1,68 @@
+/*
+ * Library interface of dmidecode
+ * This file is part of the dmidecode project.
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ */
+
+#ifndef LIBDMIDECODE_H
+#define LIBDMIDECODE_H
+
+#include <stddef.h>
+
+/*
+ * A context decodes the table the way one dmidecode command line would,
+ * without running the program. The table it reads is kept until the
+ * context is freed, later queries on the same context only read the
+ * entry point again. Contexts are independent, different threads may
+ * decode at the same time as long as each uses its own context.
+ */
+struct dmi_context;
+
+struct dmi_context *dmi_context_new(void);
+void dmi_context_free(struct dmi_context *ctx);
+
+/*
+ * Set the options of the following queries, as dmidecode's command line
+ * (argv[0] is ignored). Option arguments are not copied, argv must stay
+ * valid while the context uses them. Uses getopt, so it must not be called
+ * by several threads at once. Returns 0 on success, -1 on invalid options.
+ */
+int dmi_context_set_options(struct dmi_context *ctx, int argc,
+			    char * const argv[]);
+
+/* Send the output to write() instead of stdout, NULL restores stdout */
+void dmi_context_set_output(struct dmi_context *ctx,
+			    void (*write)(void *arg, const char *buf,
+					  size_t len),
+			    void *arg);
+
+/*
+ * Decode the SMBIOS or SMBIOS3 entry point at ep instead of looking for
+ * one, e.g. the one a UEFI application finds in the configuration table
+ * under SMBIOS_TABLE_GUID or SMBIOS3_TABLE_GUID. The table is read at
+ * the address the entry point announces, which must be mapped at that
+ * address, as it is in UEFI boot services. ep must stay valid while the
+ * context uses it, NULL restores the usual sources. --from-dump still
+ * takes precedence. The table isn't kept by the context, nor saved by
+ * --cache. This source is for library callers only, the dmidecode
+ * command has no way to use it.
+ */
+void dmi_context_set_entry_point(struct dmi_context *ctx, const void *ep);
+
+/* Run a query, returns dmidecode's exit status */
+int dmi_context_decode(struct dmi_context *ctx);
+
+#endif
@@ -43,6 +43,7 @@
 #include <string.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <time.h>
 
 #include "types.h"
 #include "util.h"
@@ -76,26 +77,211 @@ static int myread(int fd, u8 *buf, size_t count, const char *prefix)
 	return 0;
 }
 
+/*
+ * Add the bytes 4 at a time. Two 16-bit lanes accumulate the even and
+ * odd bytes of each word, and are folded before they can overflow.
+ */
 int checksum(const u8 *buf, size_t len)
 {
+	u32 lanes = 0, word;
 	u8 sum = 0;
 	size_t a;
 
-	for (a = 0; a < len; a++)
+	for (a = 0; a + 4 <= len; a += 4)
+	{
+		word = DWORD(buf + a);
+		lanes += (word & 0x00FF00FF) + ((word >> 8) & 0x00FF00FF);
+		if ((a & 0x1FC) == 0x1FC)
+		{
+			sum += (lanes & 0xFFFF) + (lanes >> 16);
+			lanes = 0;
+		}
+	}
+	sum += (lanes & 0xFFFF) + (lanes >> 16);
+
+	for (; a < len; a++)
 		sum += buf[a];
 	return (sum == 0);
 }
 
+/*
+ * Per-run arena: memory is carved out of a few large blocks, and only
+ * returned all at once by arena_release(). Each new block is larger than
+ * all the previous ones together, so the number of blocks only grows
+ * with the logarithm of the memory used. The most recent
+ * allocation can be grown or given back in place.
+ */
+struct arena_block
+{
+	struct arena_block *next;
+	size_t size;			/* Usable bytes after the header */
+	size_t used;
+};
+
+#define ARENA_ALIGN(n) (((n) + 15) & ~(size_t)15)
+#define ARENA_HEADER ARENA_ALIGN(sizeof(struct arena_block))
+#define ARENA_DATA(b) ((u8 *)(b) + ARENA_HEADER)
+
+/*
+ * Under AddressSanitizer, the part of a block which isn't allocated is
+ * poisoned, alignment padding included, so that reading past the end of
+ * an allocation is caught as it would be with malloc() (see dmifuzz.c).
+ */
+#if defined __SANITIZE_ADDRESS__
+#define USE_ASAN
+#elif defined __has_feature
+#if __has_feature(address_sanitizer)
+#define USE_ASAN
+#endif
+#endif
+
+#ifdef USE_ASAN
+#include <sanitizer/asan_interface.h>
+#define ARENA_POISON(p, len) ASAN_POISON_MEMORY_REGION(p, len)
+#define ARENA_UNPOISON(p, len) ASAN_UNPOISON_MEMORY_REGION(p, len)
+#else
+#define ARENA_POISON(p, len) ((void)0)
+#define ARENA_UNPOISON(p, len) ((void)0)
+#endif
+
+void arena_init(struct arena *a)
+{
+	a->head = NULL;
+	a->total = 0;
+	a->last = NULL;
+	a->blocks = 0;
+}
+
+static struct arena_block *arena_grow(struct arena *a, size_t size)
+{
+	struct arena_block *b;
+
+	/* Leave room for what usually follows a large allocation */
+	if (size < ARENA_BLOCK_SIZE)
+		size = ARENA_BLOCK_SIZE;
+	size = ARENA_ALIGN(size + a->total);
+
+	if ((b = malloc(ARENA_HEADER + size)) == NULL)
+		return NULL;
+	b->next = a->head;
+	b->size = size;
+	b->used = 0;
+	ARENA_POISON(ARENA_DATA(b), size);
+	a->head = b;
+	a->total += size;
+	a->blocks++;
+
+	return b;
+}
+
+/*
+ * Allocate len bytes, from the heap if a is NULL. Like malloc(), the
+ * memory is not initialized.
+ */
+void *arena_alloc(struct arena *a, size_t len)
+{
+	struct arena_block *b;
+	size_t len0 = len ? len : 1;
+
+	if (a == NULL)
+		return malloc(len);
+
+	len = ARENA_ALIGN(len0);
+	b = a->head;
+	if (b == NULL || b->size - b->used < len)
+	{
+		if ((b = arena_grow(a, len)) == NULL)
+			return NULL;
+	}
+	a->last = ARENA_DATA(b) + b->used;
+	ARENA_UNPOISON(a->last, len0);
+	b->used += len;
+
+	return a->last;
+}
+
+void *arena_calloc(struct arena *a, size_t nmemb, size_t size)
+{
+	void *p;
+
+	if (size && nmemb > (size_t)-1 / size)
+		return NULL;
+	if ((p = arena_alloc(a, nmemb * size)) != NULL)
+		memset(p, 0, nmemb * size);
+	return p;
+}
+
+/*
+ * Resize p, of which the first len bytes are kept, to size bytes. The
+ * most recent allocation grows in place if its block has room.
+ */
+void *arena_realloc(struct arena *a, void *p, size_t len, size_t size)
+{
+	struct arena_block *b;
+	void *q;
+
+	if (a == NULL)
+		return realloc(p, size);
+
+	b = a->head;
+	if (p != NULL && p == a->last
+	 && (size_t)((u8 *)p - ARENA_DATA(b)) + ARENA_ALIGN(size) <= b->size)
+	{
+		ARENA_POISON(p, b->size - ((u8 *)p - ARENA_DATA(b)));
+		ARENA_UNPOISON(p, size ? size : 1);
+		b->used = (u8 *)p - ARENA_DATA(b) + ARENA_ALIGN(size);
+		return p;
+	}
+
+	if ((q = arena_alloc(a, size)) == NULL)
+		return NULL;
+	if (p != NULL)
+		memcpy(q, p, len < size ? len : size);
+	return q;
+}
+
+/*
+ * Give p back. Arena memory is only reused if p is the most recent
+ * allocation, otherwise it waits for arena_release().
+ */
+void arena_free(struct arena *a, void *p)
+{
+	if (a == NULL)
+	{
+		free(p);
+		return;
+	}
+	if (p != NULL && p == a->last)
+	{
+		a->head->used = (u8 *)p - ARENA_DATA(a->head);
+		ARENA_POISON(p, a->head->size - a->head->used);
+		a->last = NULL;
+	}
+}
+
+void arena_release(struct arena *a)
+{
+	struct arena_block *b;
+
+	while ((b = a->head) != NULL)
+	{
+		a->head = b->next;
+		free(b);
+	}
+	arena_init(a);
+}
+
 /*
  * Reads all of file from given offset, up to max_len bytes.
- * A buffer of at most max_len bytes is allocated by this function, and
- * needs to be freed by the caller.
+ * A buffer of at most max_len bytes is allocated from arena a by this
+ * function, and needs to be freed by the caller with arena_free().
  * This provides a similar usage model to mem_chunk()
  *
  * Returns a pointer to the allocated buffer, or NULL on error, and
  * sets max_len to the length actually read.
  */
-void *read_file(off_t base, size_t *max_len, const char *filename)
+void *read_file(off_t base, size_t *max_len, const char *filename,
+		struct arena *a)
 {
 	struct stat statbuf;
 	int fd;
@@ -128,7 +314,7 @@ void *read_file(off_t base, size_t *max_len, const char *filename)
 			*max_len = statbuf.st_size - base;
 	}
 
-	if ((p = malloc(*max_len)) == NULL)
+	if ((p = arena_alloc(a, *max_len)) == NULL)
 	{
 		perror(u"malloc");
 		goto out;
@@ -145,7 +331,7 @@ void *read_file(off_t base, size_t *max_len, const char *filename)
 		goto out;
 
 err_free:
-	free(p);
+	arena_free(a, p);
 	p = NULL;
 
 out:
@@ -169,9 +355,9 @@ static void safe_memcpy(void *dest, const void *src, size_t n)
 
 /*
  * Copy a physical memory chunk into a memory buffer.
- * This function allocates memory.
+ * This function allocates memory, from arena a.
  */
-void *mem_chunk(off_t base, size_t len, const char *devmem)
+void *mem_chunk(off_t base, size_t len, const char *devmem, struct arena *a)
 {
 	void *p;
 	int fd;
@@ -187,7 +373,7 @@ void *mem_chunk(off_t base, size_t len, const char *devmem)
 		return NULL;
 	}
 
-	if ((p = malloc(len)) == NULL)
+	if ((p = arena_alloc(a, len)) == NULL)
 	{
 		perror(u"malloc");
 		goto out;
@@ -249,7 +435,7 @@ try_read:
 		goto out;
 
 err_free:
-	free(p);
+	arena_free(a, p);
 	p = NULL;
 
 out:
@@ -259,6 +445,236 @@ out:
 	return p;
 }
 
+/*
+ * Get a view of a physical memory chunk or of a file, without copying it
+ * if possible. The view is a private, copy-on-write mapping, so the
+ * caller may modify the data without affecting the underlying memory or
+ * file. If mapping isn't possible, or not safe (device memory on
+ * architectures which can't do unaligned accesses to it), the data is
+ * copied into a buffer allocated from arena a instead, as mem_chunk()
+ * and read_file() do.
+ *
+ * For regular files, len is truncated to what is available, as
+ * read_file() does. Returns 0 on success, -1 on error.
+ * The view must be released with mem_view_release().
+ */
+int mem_view(struct mem_view *v, off_t base, size_t *len, const char *devmem,
+	     struct arena *a)
+{
+	struct stat statbuf;
+	int is_reg;
+#ifdef USE_MMAP
+	off_t mmoffset;
+	void *mmp;
+	int fd;
+#endif
+
+	v->data = NULL;
+	v->map = NULL;
+	v->map_len = 0;
+	v->arena = a;
+
+	if (stat(devmem, &statbuf) == -1)
+	{
+		perror(devmem);
+		return -1;
+	}
+	is_reg = S_ISREG(statbuf.st_mode);
+
+#ifdef USE_MMAP
+	if (is_reg)
+	{
+		if (base >= statbuf.st_size)
+			goto copy;
+		if (*len > (size_t)statbuf.st_size - base)
+			*len = statbuf.st_size - base;
+	}
+#ifdef USE_SLOW_MEMCPY
+	else
+		goto copy;
+#endif
+	if (*len == 0)
+		goto copy;
+
+	if ((fd = open(devmem, O_RDONLY)) == -1)
+	{
+		perror(devmem);
+		return -1;
+	}
+
+#ifdef _SC_PAGESIZE
+	mmoffset = base % sysconf(_SC_PAGESIZE);
+#else
+	mmoffset = base % getpagesize();
+#endif /* _SC_PAGESIZE */
+	mmp = mmap(NULL, mmoffset + *len, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+		   fd, base - mmoffset);
+
+	if (close(fd) == -1)
+		perror(devmem);
+
+	if (mmp != MAP_FAILED)
+	{
+		v->map = mmp;
+		v->map_len = mmoffset + *len;
+		v->data = (u8 *)mmp + mmoffset;
+		return 0;
+	}
+
+copy:
+#endif /* USE_MMAP */
+	if (is_reg)
+		v->data = read_file(base, len, devmem, a);
+	else
+		v->data = mem_chunk(base, *len, devmem, a);
+
+	return v->data == NULL ? -1 : 0;
+}
+
+void mem_view_release(struct mem_view *v)
+{
+#ifdef USE_MMAP
+	if (v->map)
+	{
+		if (munmap(v->map, v->map_len) == -1)
+			perror(u"munmap");
+		v->map = NULL;
+		v->data = NULL;
+		return;
+	}
+#endif
+	arena_free(v->arena, v->data);
+	v->data = NULL;
+}
+
+/*
+ * Read a whole file ahead of its use, e.g. the sysfs DMI table while its
+ * entry point is being checked: on busy hosts, each system call served by
+ * the firmware handlers can take long. The file is opened and sized right
+ * away, then read by a helper thread if one can be started, or else by
+ * file_prefetch_wait(). Nothing is printed, so that the caller can fall
+ * back to reading the file as usual, with the usual error messages.
+ * Returns 0 on success, -1 if the file can't be read ahead.
+ */
+static void file_prefetch_read(struct file_prefetch *p)
+{
+	size_t done = 0;
+	ssize_t r;
+
+	while (done < p->len)
+	{
+		r = read(p->fd, p->data + done, p->len - done);
+		if (r == -1)
+		{
+			if (errno == EINTR)
+				continue;
+			p->err = errno;
+			break;
+		}
+		if (r == 0)
+			break;
+		done += r;
+	}
+	p->len = done;
+}
+
+#ifdef USE_PTHREAD
+static void *file_prefetch_thread(void *arg)
+{
+	file_prefetch_read(arg);
+	return NULL;
+}
+#endif
+
+int file_prefetch_start(struct file_prefetch *p, const char *filename,
+			struct arena *a)
+{
+	struct stat statbuf;
+
+	p->filename = filename;
+	p->data = NULL;
+	p->len = 0;
+	p->err = 0;
+	p->waited = 0;
+#ifdef USE_PTHREAD
+	p->started = 0;
+#endif
+
+	if ((p->fd = open(filename, O_RDONLY)) == -1)
+		return -1;
+	if (fstat(p->fd, &statbuf) == -1 || statbuf.st_size <= 0
+	 || (p->data = arena_alloc(a, statbuf.st_size)) == NULL)
+	{
+		close(p->fd);
+		p->fd = -1;
+		return -1;
+	}
+	p->len = statbuf.st_size;
+
+#ifdef USE_PTHREAD
+	p->started = pthread_create(&p->thread, NULL, file_prefetch_thread,
+				    p) == 0;
+#endif
+	return 0;
+}
+
+/* Returns the data and sets len to how much was read, NULL on error */
+u8 *file_prefetch_wait(struct file_prefetch *p, size_t *len)
+{
+	if (!p->waited)
+	{
+#ifdef USE_PTHREAD
+		if (p->started)
+			pthread_join(p->thread, NULL);
+		else
+#endif
+			file_prefetch_read(p);
+		p->waited = 1;
+	}
+
+	if (p->err)
+		return NULL;
+	*len = p->len;
+	return p->data;
+}
+
+void file_prefetch_release(struct file_prefetch *p, struct arena *a)
+{
+#ifdef USE_PTHREAD
+	if (p->started && !p->waited)
+		pthread_join(p->thread, NULL);
+#endif
+	if (close(p->fd) == -1)
+		perror(p->filename);
+	arena_free(a, p->data);
+	p->data = NULL;
+}
+
+/*
+ * Copy a chunk of physical memory or of a file into a caller-provided
+ * buffer, for tables read piece by piece. For regular files, len is
+ * truncated to what is available, possibly 0. Returns 0 on success, -1
+ * on error.
+ */
+int mem_read(off_t base, void *buf, size_t *len, const char *devmem)
+{
+	struct mem_view v;
+	struct stat statbuf;
+
+	if (stat(devmem, &statbuf) == 0 && S_ISREG(statbuf.st_mode)
+	 && base >= statbuf.st_size)
+	{
+		*len = 0;
+		return 0;
+	}
+	if (mem_view(&v, base, len, devmem, NULL) != 0)
+		return -1;
+	memcpy(buf, v.data, *len);
+	mem_view_release(&v);
+
+	return 0;
+}
+
 int write_dump(size_t base, size_t len, const void *data, const char *dumpfile, int add)
 {
 	FILE *f;
@@ -314,3 +730,18 @@ u64 u64_range(u64 start, u64 end)
 
 	return res;
 }
+
+/*
+ * Monotonic time in nanoseconds, used to time the phases of a run (see
+ * --stats). Only differences between two calls are meaningful.
+ */
+unsigned long long monotonic_ns(void)
+{
+#ifdef CLOCK_MONOTONIC
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+		return (unsigned long long)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+	return (unsigned long long)clock() * (1000000000 / CLOCKS_PER_SEC);
+}
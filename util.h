@@ -20,12 +20,68 @@
 
 #include <sys/types.h>
 
+#include "config.h"
 #include "types.h"
 
+#ifdef USE_PTHREAD
+#include <pthread.h>
+#endif
+
 #define ARRAY_SIZE(x) (sizeof(x)/sizeof((x)[0]))
 
+/* Memory released all at once at the end of a run, see arena_alloc() */
+struct arena_block;
+struct arena
+{
+	struct arena_block *head;	/* Block allocations are made from */
+	size_t total;			/* Size of all the blocks */
+	void *last;			/* Most recent allocation */
+	unsigned int blocks;
+};
+
+/* Memory or file data, either mapped or copied, see mem_view() */
+struct mem_view
+{
+	u8 *data;
+	void *map;
+	size_t map_len;
+	struct arena *arena;		/* data was copied there */
+};
+
+/* A whole file, read ahead of its use, see file_prefetch_start() */
+struct file_prefetch
+{
+	const char *filename;
+	int fd;
+	u8 *data;
+	size_t len;			/* Size of the file, then bytes read */
+	int err;			/* errno of the failed read, 0 if none */
+	int waited;
+#ifdef USE_PTHREAD
+	pthread_t thread;
+	int started;
+#endif
+};
+
+void arena_init(struct arena *a);
+void *arena_alloc(struct arena *a, size_t len);
+void *arena_calloc(struct arena *a, size_t nmemb, size_t size);
+void *arena_realloc(struct arena *a, void *p, size_t len, size_t size);
+void arena_free(struct arena *a, void *p);
+void arena_release(struct arena *a);
+
 int checksum(const u8 *buf, size_t len);
-void *read_file(off_t base, size_t *len, const char *filename);
-void *mem_chunk(off_t base, size_t len, const char *devmem);
+void *read_file(off_t base, size_t *len, const char *filename,
+		struct arena *a);
+void *mem_chunk(off_t base, size_t len, const char *devmem, struct arena *a);
+int mem_view(struct mem_view *v, off_t base, size_t *len, const char *devmem,
+	     struct arena *a);
+void mem_view_release(struct mem_view *v);
+int file_prefetch_start(struct file_prefetch *p, const char *filename,
+			struct arena *a);
+u8 *file_prefetch_wait(struct file_prefetch *p, size_t *len);
+void file_prefetch_release(struct file_prefetch *p, struct arena *a);
+int mem_read(off_t base, void *buf, size_t *len, const char *devmem);
 int write_dump(size_t base, size_t len, const void *data, const char *dumpfile, int add);
 u64 u64_range(u64 start, u64 end);
+unsigned long long monotonic_ns(void);